@@ -0,0 +1,1235 @@
+/* bench.c
+   Benchmark and correctness harness for every program in the repository.
+   Generates synthetic inputs (integer and string streams, a listings CSV, a
+   directory tree, a command file and a large binary file), runs each program
+   on them for several trials with perf_event_open counters attached, checks
+   every trial's output and writes one JSON object per benchmark, so results
+   from two commits can be compared with bench -C.
+   Built and run by "make bench" in this directory; see the Makefile.
+
+   Usage: bench -d bindir [-w workdir] [-s scale] [-n trials] [-W warmups]
+                [-b name,...] [-c label] [-u] [-o results.json]
+          bench -C base.json new.json [-T percent]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/utsname.h>
+#include <linux/perf_event.h>
+
+#define MAX_ARGS 16
+#define MAX_TRIALS 100
+#define DEFAULT_TRIALS 5
+#define DEFAULT_THRESHOLD 10.0   /* percent slower that counts as a regression */
+#define INPUT_VERSION 2          /* bump when the generators change */
+
+/* Input sizes at scale 1 */
+#define N_INTS 1000000
+#define N_STRINGS 300000
+#define N_LISTINGS 1000          /* lab6 reads at most 1000 records */
+#define SRC_BYTES (64 << 20)
+#define N_COMMANDS 200
+#define TREE_FANOUT 8
+#define TREE_DEPTH 3
+#define N_TREE_FILES 20000
+#define TREE_DUP_EVERY 25        /* every 25th file copies the one made before it */
+#define N_PRIME_QUERIES 100000
+#define PRIME_LIMIT 200000000ULL
+#define SUM_ELEMENTS 20000000
+#define HW4_PER_PRODUCER 50000
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                              */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    const char *bindir;
+    const char *workdir;
+    double scale;
+    int trials;
+    int warmups;
+    const char *only;     /* -b: comma-separated benchmark names */
+    const char *label;    /* -c: commit or other label stored in the results */
+    int user_only;        /* -u: count user-space events only */
+    const char *out;
+} config_t;
+
+static config_t cfg = { NULL, "bench_work", 1.0, DEFAULT_TRIALS, 1, NULL, "unknown", 0,
+                        "bench_results.json" };
+
+/* Sizes after scaling, and facts about the generated inputs the checks need */
+typedef struct {
+    long ints;
+    long strings;
+    long src_bytes;
+    long commands;
+    long tree_files;
+    long tree_entries;    /* files and directories below tree/ */
+    long tree_dups;       /* files that are copies of another */
+    long prime_queries;
+    unsigned long long prime_limit;
+    long long prime_count; /* pi(prime_limit) */
+    long sum_elements;
+    long hw4_per_producer;
+} inputs_t;
+
+static inputs_t in;
+
+static long scaled(long base) {
+    long v = (long)(base * cfg.scale);
+    return v > 0 ? v : 1;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* splitmix64: every generator is seeded, so inputs are identical across runs */
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rng_below(uint64_t n) {
+    return rng_next() % n;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Input generation                                                           */
+/* ------------------------------------------------------------------------- */
+
+static FILE *create_file(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "bench: cannot create %s/%s: %s\n", cfg.workdir, path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    return fp;
+}
+
+static void close_file(FILE *fp, const char *path) {
+    if (ferror(fp) | fclose(fp)) {
+        fprintf(stderr, "bench: error writing %s/%s\n", cfg.workdir, path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* insertion: a count, then that many ints */
+static void gen_ints(void) {
+    FILE *fp = create_file("ints.txt");
+    fprintf(fp, "%ld\n", in.ints);
+    for (long i = 0; i < in.ints; i++)
+        fprintf(fp, "%d%c", (int)rng_below(2000000001ULL) - 1000000000, i % 16 == 15 ? '\n' : ' ');
+    fputc('\n', fp);
+    close_file(fp, "ints.txt");
+}
+
+/* The word for vocabulary entry idx: 3 to 12 letters derived from idx */
+static void make_word(uint64_t idx, char *w) {
+    uint64_t h = idx * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL;
+    int len = 3 + (int)(h % 10);
+    for (int i = 0; i < len; i++) {
+        h = h * 6364136223846793005ULL + 1442695040888963407ULL;
+        w[i] = (char)('a' + (h >> 33) % 26);
+    }
+    w[len] = '\0';
+}
+
+/* hwins: a count, then words from a vocabulary a tenth that size, skewed
+   so some words repeat often (u^2 favours low indexes) */
+static void gen_strings(void) {
+    FILE *fp = create_file("strings.txt");
+    uint64_t vocab = (uint64_t)in.strings / 10 + 1;
+    char w[16];
+    fprintf(fp, "%ld\n", in.strings);
+    for (long i = 0; i < in.strings; i++) {
+        double u = (double)(rng_next() >> 11) / 9007199254740992.0;
+        make_word((uint64_t)(u * u * vocab), w);
+        fprintf(fp, "%s\n", w);
+    }
+    close_file(fp, "strings.txt");
+}
+
+/* lab6: Airbnb-style listings in the column order getfields() expects */
+static void gen_listings(void) {
+    static const char *groups[] = { "Brooklyn", "Manhattan", "Queens", "Bronx", "Staten Island" };
+    static const char *rooms[] = { "Entire home/apt", "Private room", "Shared room" };
+    FILE *fp = create_file("listings.csv");
+    char host[16], hood[16];
+    fprintf(fp, "id,host_id,host_name,neighbourhood_group,neighbourhood,latitude,longitude,"
+                "room_type,price,minimum_nights,number_of_reviews,"
+                "calculated_host_listings_count,availability_365\n");
+    for (int i = 0; i < N_LISTINGS; i++) {
+        make_word(rng_below(400), host);
+        host[0] = (char)(host[0] - 'a' + 'A');
+        make_word(1000 + rng_below(50), hood);
+        fprintf(fp, "%d,%llu,%s,%s,%s,%.5f,%.5f,%s,%llu,%llu,%llu,%llu,%llu\n",
+                2000 + i, (unsigned long long)(1000 + rng_below(100000)), host,
+                groups[rng_below(5)], hood, 40.5 + rng_below(40000) / 1e5,
+                -74.2 + rng_below(50000) / 1e5, rooms[rng_below(3)],
+                (unsigned long long)(20 + rng_below(980)), (unsigned long long)(1 + rng_below(30)),
+                (unsigned long long)rng_below(500), (unsigned long long)(1 + rng_below(10)),
+                (unsigned long long)rng_below(366));
+    }
+    close_file(fp, "listings.csv");
+}
+
+/* lab4: a large file of random bytes */
+static void gen_source(void) {
+    FILE *fp = create_file("src.bin");
+    uint64_t buf[8192];
+    for (long done = 0; done < in.src_bytes; done += (long)sizeof(buf)) {
+        for (size_t i = 0; i < 8192; i++) buf[i] = rng_next();
+        long n = in.src_bytes - done < (long)sizeof(buf) ? in.src_bytes - done : (long)sizeof(buf);
+        fwrite(buf, 1, (size_t)n, fp);
+    }
+    close_file(fp, "src.bin");
+}
+
+/* lab7: short commands, with the comments and blank lines it must skip */
+static void gen_commands(void) {
+    static const char *cmds[] = { "true", "/bin/echo bench", "ls -d .", "uname -s" };
+    FILE *fp = create_file("commands.txt");
+    for (long i = 0; i < in.commands; i++) {
+        if (i % 50 == 0) fprintf(fp, "# batch %ld\n\n", i / 50);
+        fprintf(fp, "%s\n", cmds[i % 4]);
+    }
+    close_file(fp, "commands.txt");
+}
+
+/* oaadigun_HW02: TREE_FANOUT^TREE_DEPTH leaf directories holding the files,
+   64 bytes to 1 KB of random data each, with planted duplicates. With
+   create == 0 only the entry and duplicate counts are worked out. */
+static void gen_tree_dir(const char *dir, int depth, long *files_left, long leaves_left, int create) {
+    char path[PATH_MAX];
+    if (create && mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "bench: mkdir %s: %s\n", dir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (depth > 0) in.tree_entries++;
+    if (depth == TREE_DEPTH) {
+        static char data[1024];
+        static size_t len;
+        static long made;
+        long n = *files_left / leaves_left;
+        for (long i = 0; i < n; i++) {
+            int dup = made++ % TREE_DUP_EVERY == TREE_DUP_EVERY - 1;
+            in.tree_dups += dup;
+            if (!create) continue;
+            snprintf(path, sizeof(path), "%s/f%ld.dat", dir, i);
+            FILE *fp = create_file(path);
+            if (!dup) {
+                len = 64 + (size_t)rng_below(sizeof(data) - 64);
+                for (size_t j = 0; j < len; j++) data[j] = (char)rng_next();
+            }
+            fwrite(data, 1, len, fp);
+            close_file(fp, path);
+        }
+        *files_left -= n;
+        in.tree_entries += n;
+        return;
+    }
+    long leaves_below = 1;
+    for (int d = depth + 1; d < TREE_DEPTH; d++) leaves_below *= TREE_FANOUT;
+    for (int i = 0; i < TREE_FANOUT; i++) {
+        snprintf(path, sizeof(path), "%s/d%d", dir, i);
+        gen_tree_dir(path, depth + 1, files_left, leaves_left - (long)i * leaves_below, create);
+    }
+}
+
+/* prime -b: one unsigned 64-bit query per line */
+static void gen_primes(void) {
+    FILE *fp = create_file("nums.txt");
+    for (long i = 0; i < in.prime_queries; i++)
+        fprintf(fp, "%llu\n", (unsigned long long)(rng_next() >> (rng_below(4) * 16)));
+    close_file(fp, "nums.txt");
+}
+
+/* pi(limit) by a plain odd-only bit sieve, the reference for prime -r */
+static long long count_primes(unsigned long long limit) {
+    if (limit < 2) return 0;
+    size_t nbits = (size_t)(limit / 2 + 1);
+    uint8_t *composite = calloc(nbits / 8 + 1, 1);
+    if (!composite) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned long long p = 3; p * p <= limit; p += 2) {
+        if (composite[p / 2 / 8] & (1 << (p / 2 % 8))) continue;
+        for (unsigned long long m = p * p; m <= limit; m += 2 * p)
+            composite[m / 2 / 8] |= (uint8_t)(1 << (m / 2 % 8));
+    }
+    long long count = 1;  /* 2 */
+    for (unsigned long long i = 1; i <= (limit - 1) / 2; i++)
+        if (!(composite[i / 8] & (1 << (i % 8)))) count++;
+    free(composite);
+    return count;
+}
+
+/* Generate everything into the work directory, reusing inputs left by an
+   earlier run at the same scale (the stamp file records it). */
+static void generate_inputs(void) {
+    in.ints = scaled(N_INTS);
+    in.strings = scaled(N_STRINGS);
+    in.src_bytes = scaled(SRC_BYTES);
+    in.commands = scaled(N_COMMANDS);
+    in.tree_files = scaled(N_TREE_FILES);
+    in.prime_queries = scaled(N_PRIME_QUERIES);
+    in.prime_limit = (unsigned long long)scaled(PRIME_LIMIT);
+    in.sum_elements = scaled(SUM_ELEMENTS);
+    in.hw4_per_producer = scaled(HW4_PER_PRODUCER);
+
+    if (mkdir(cfg.workdir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "bench: mkdir %s: %s\n", cfg.workdir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (chdir(cfg.workdir) != 0) {
+        fprintf(stderr, "bench: chdir %s: %s\n", cfg.workdir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    char want[128], have[128] = "";
+    snprintf(want, sizeof(want), "version %d scale %g\n", INPUT_VERSION, cfg.scale);
+    FILE *fp = fopen("inputs.stamp", "r");
+    if (fp) {
+        if (!fgets(have, sizeof(have), fp)) have[0] = '\0';
+        fclose(fp);
+    }
+    int reuse = strcmp(want, have) == 0;
+
+    double t0 = now_sec();
+    if (!reuse) {
+        fprintf(stderr, "bench: generating inputs in %s (scale %g)\n", cfg.workdir, cfg.scale);
+        unlink("inputs.stamp");
+        if (system("rm -rf tree") != 0) {
+            fprintf(stderr, "bench: cannot remove old tree\n");
+            exit(EXIT_FAILURE);
+        }
+        gen_ints();
+        gen_strings();
+        gen_listings();
+        gen_source();
+        gen_commands();
+        gen_primes();
+    }
+    /* counting the tree without creating it gives the same totals on reuse */
+    long files_left = in.tree_files, leaves = 1;
+    for (int d = 0; d < TREE_DEPTH; d++) leaves *= TREE_FANOUT;
+    gen_tree_dir("tree", 0, &files_left, leaves, !reuse);
+    in.prime_count = count_primes(in.prime_limit);
+
+    if (!reuse) {
+        fp = create_file("inputs.stamp");
+        fputs(want, fp);
+        close_file(fp, "inputs.stamp");
+        fprintf(stderr, "bench: inputs ready in %.1f s\n", now_sec() - t0);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Output checks                                                              */
+/* ------------------------------------------------------------------------- */
+
+/* A check reads the program's stdout (out[0, len), NUL terminated) and the
+   files it left in the work directory. It returns 0, or -1 with a reason. */
+typedef int (*check_fn)(const char *out, size_t len, char *why, size_t whylen);
+
+static char *read_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    char *buf = malloc((size_t)st.st_size + 1);
+    size_t got = 0;
+    while (buf && got < (size_t)st.st_size) {
+        ssize_t r = read(fd, buf + got, (size_t)st.st_size - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    close(fd);
+    if (!buf) return NULL;
+    buf[got] = '\0';
+    *len = got;
+    return buf;
+}
+
+static long count_lines(const char *s, size_t len) {
+    long n = 0;
+    for (const char *p = s; (p = memchr(p, '\n', len - (size_t)(p - s))) != NULL; p++) n++;
+    return n;
+}
+
+static int check_insertion(const char *out, size_t len, char *why, size_t whylen) {
+    (void)len;
+    const char *p = strstr(out, "Sorted array:");
+    if (!p) {
+        snprintf(why, whylen, "no \"Sorted array:\" line");
+        return -1;
+    }
+    p += strlen("Sorted array:");
+    long n = 0, prev = LONG_MIN;
+    char *end;
+    for (;;) {
+        long v = strtol(p, &end, 10);
+        if (end == p) break;
+        if (v < prev) {
+            snprintf(why, whylen, "value %ld after %ld at position %ld", v, prev, n);
+            return -1;
+        }
+        prev = v;
+        p = end;
+        n++;
+    }
+    if (n != in.ints) {
+        snprintf(why, whylen, "%ld values printed, expected %ld", n, in.ints);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_hwins_sorted(const char *out, size_t len, char *why, size_t whylen) {
+    long n = count_lines(out, len);
+    if (n != in.strings) {
+        snprintf(why, whylen, "%ld lines printed, expected %ld", n, in.strings);
+        return -1;
+    }
+    const char *prev = out, *p = memchr(out, '\n', len);
+    while (p && p + 1 < out + len) {
+        const char *next = memchr(p + 1, '\n', len - (size_t)(p + 1 - out));
+        if (!next) break;
+        size_t a = (size_t)(p - prev), b = (size_t)(next - p - 1);
+        int c = memcmp(prev, p + 1, a < b ? a : b);
+        if (c > 0 || (c == 0 && a > b)) {
+            snprintf(why, whylen, "strings out of order at line %ld", count_lines(out, (size_t)(p - out)) + 2);
+            return -1;
+        }
+        prev = p + 1;
+        p = next;
+    }
+    return 0;
+}
+
+/* -c counts every token, the leading count included */
+static int check_hwins_count(const char *out, size_t len, char *why, size_t whylen) {
+    (void)len;
+    long total = -1;
+    const char *p = strstr(out, "Total strings:");
+    if (p) total = atol(p + strlen("Total strings:"));
+    if (total != in.strings + 1) {
+        snprintf(why, whylen, "total %ld, expected %ld", total, in.strings + 1);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_prime_range(const char *out, size_t len, char *why, size_t whylen) {
+    (void)len;
+    long long count = -1;
+    if (sscanf(out, "%lld primes", &count) != 1 || count != in.prime_count) {
+        snprintf(why, whylen, "counted %lld primes, expected %lld", count, in.prime_count);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_prime_batch(const char *out, size_t len, char *why, size_t whylen) {
+    long n = count_lines(out, len);
+    if (n != in.prime_queries) {
+        snprintf(why, whylen, "%ld answers, expected %ld", n, in.prime_queries);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_scan(const char *out, size_t len, char *why, size_t whylen) {
+    (void)len;
+    if (!strstr(out, "All scans match the serial reference")) {
+        snprintf(why, whylen, "scan results differ from the serial reference");
+        return -1;
+    }
+    return 0;
+}
+
+static int check_sum(const char *out, size_t len, char *why, size_t whylen) {
+    (void)len;
+    char got[64], want[64];
+    const char *p = strstr(out, "The total is ");
+    if (!p || sscanf(p, "The total is %63[^,], it should be equal to %63s", got, want) != 2) {
+        snprintf(why, whylen, "no total line");
+        return -1;
+    }
+    if (strcmp(got, want) != 0) {
+        snprintf(why, whylen, "total %s, expected %s", got, want);
+        return -1;
+    }
+    return 0;
+}
+
+/* One "child finished with status" line per consumer process; all must be 0 */
+static int check_hw4(const char *out, size_t len, char *why, size_t whylen) {
+    (void)len;
+    static const char tag[] = "child finished with status ";
+    int children = 0;
+    for (const char *p = strstr(out, tag); p; p = strstr(p, tag)) {
+        p += sizeof(tag) - 1;
+        if (*p != '0' || (p[1] >= '0' && p[1] <= '9')) {
+            snprintf(why, whylen, "consumer process did not finish cleanly");
+            return -1;
+        }
+        children++;
+    }
+    if (children == 0) {
+        snprintf(why, whylen, "no consumer process reported");
+        return -1;
+    }
+    return 0;
+}
+
+static int check_lab6(const char *out, size_t len, char *why, size_t whylen) {
+    (void)len;
+    char expect[64];
+    snprintf(expect, sizeof(expect), "Read %d records", N_LISTINGS);
+    if (!strstr(out, expect)) {
+        snprintf(why, whylen, "expected \"%s\"", expect);
+        return -1;
+    }
+    size_t flen;
+    char *csv = read_file("sorted_by_price.csv", &flen);
+    if (!csv) {
+        snprintf(why, whylen, "no sorted_by_price.csv");
+        return -1;
+    }
+    long rows = 0;
+    double prev = -1;
+    int rc = 0;
+    for (char *line = strtok(csv, "\n"); line; line = strtok(NULL, "\n")) {
+        /* price is the 9th field */
+        char *f = line;
+        for (int i = 0; i < 8 && f; i++) {
+            f = strchr(f, ',');
+            if (f) f++;
+        }
+        double price = f ? atof(f) : -1;
+        if (price < prev) {
+            snprintf(why, whylen, "price %.2f after %.2f in sorted_by_price.csv", price, prev);
+            rc = -1;
+            break;
+        }
+        prev = price;
+        rows++;
+    }
+    free(csv);
+    if (rc == 0 && rows != N_LISTINGS) {
+        snprintf(why, whylen, "%ld rows in sorted_by_price.csv, expected %d", rows, N_LISTINGS);
+        rc = -1;
+    }
+    return rc;
+}
+
+static int check_lab4(const char *out, size_t len, char *why, size_t whylen) {
+    (void)out;
+    (void)len;
+    struct stat st;
+    if (stat("dest.bin", &st) != 0 || st.st_size != in.src_bytes) {
+        snprintf(why, whylen, "dest.bin is not a copy of src.bin");
+        return -1;
+    }
+    return 0;
+}
+
+static int check_lab7(const char *out, size_t len, char *why, size_t whylen) {
+    (void)out;
+    (void)len;
+    size_t llen;
+    char *log = read_file("output.log", &llen);
+    long n = log ? count_lines(log, llen) : -1;
+    free(log);
+    if (n != in.commands) {
+        snprintf(why, whylen, "%ld lines in output.log, expected %ld", n, in.commands);
+        return -1;
+    }
+    return 0;
+}
+
+/* the start directory itself, then one line per entry */
+static int check_hw02(const char *out, size_t len, char *why, size_t whylen) {
+    long n = count_lines(out, len);
+    if (n != in.tree_entries + 1) {
+        snprintf(why, whylen, "%ld lines, expected %ld", n, in.tree_entries + 1);
+        return -1;
+    }
+    return 0;
+}
+
+/* -u: the rollup ends with the start directory, holding every file */
+static int check_hw02_du(const char *out, size_t len, char *why, size_t whylen) {
+    const char *last = out;
+    for (size_t i = 0; i + 1 < len; i++)
+        if (out[i] == '\n') last = out + i + 1;
+    long long bytes, alloc;
+    long files;
+    if (sscanf(last, "%lld %lld %ld", &bytes, &alloc, &files) != 3 || files != in.tree_files) {
+        snprintf(why, whylen, "last line does not count %ld files", in.tree_files);
+        return -1;
+    }
+    return 0;
+}
+
+/* -D: every planted copy is found, and nothing else */
+static int check_hw02_dups(const char *out, size_t len, char *why, size_t whylen) {
+    const char *p = out, *end = out + len;
+    size_t groups, copies;
+    while (p < end) {
+        if (sscanf(p, "%zu duplicate groups, %zu redundant files", &groups, &copies) == 2) {
+            if ((long)copies == in.tree_dups) return 0;
+            snprintf(why, whylen, "%zu redundant files, expected %ld", copies, in.tree_dups);
+            return -1;
+        }
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) break;
+        p = nl + 1;
+    }
+    snprintf(why, whylen, "no summary line");
+    return -1;
+}
+
+/* -g: every reported offset really holds the search string, and there is
+   one line per matching line of each file under tree/, counted here the
+   way HW02 prints them (a file with a NUL in its first 4096 bytes is binary
+   and gets a single line however often it matches) */
+#define HW02_GREP_TEXT "Qz"
+#define HW02_BINARY_PROBE 4096
+static long count_grep_lines(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    long lines = 0;
+    struct dirent *e;
+    while (lines >= 0 && (e = readdir(d))) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        char path[PATH_MAX];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        if (lstat(path, &st) != 0) {
+            lines = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            long sub = count_grep_lines(path);
+            lines = sub < 0 ? -1 : lines + sub;
+        } else if (S_ISREG(st.st_mode)) {
+            size_t len;
+            char *buf = read_file(path, &len);
+            if (!buf) {
+                lines = -1;
+                continue;
+            }
+            int binary = memchr(buf, '\0', len < HW02_BINARY_PROBE ? len : HW02_BINARY_PROBE) != NULL;
+            const char *p = buf, *end = buf + len, *hit;
+            while ((hit = memmem(p, (size_t)(end - p), HW02_GREP_TEXT, sizeof(HW02_GREP_TEXT) - 1))) {
+                lines++;
+                if (binary) break;
+                const char *nl = memchr(hit, '\n', (size_t)(end - hit));
+                if (!nl) break;
+                p = nl + 1;
+            }
+            free(buf);
+        }
+    }
+    closedir(d);
+    return lines;
+}
+
+static int check_hw02_grep(const char *out, size_t len, char *why, size_t whylen) {
+    const char *p = out, *end = out + len;
+    long found = 0;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t llen = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        char line[PATH_MAX + 64], path[sizeof("tree/") + sizeof(line)], got[sizeof(HW02_GREP_TEXT)];
+        long long off;
+        int n = -1;
+        snprintf(line, sizeof(line), "%.*s", (int)llen, p);
+        char *colon = strchr(line, ':');
+        if (colon) {
+            *colon = '\0';
+            snprintf(path, sizeof(path), "tree/%s", line);
+            if (sscanf(colon + 1, "%lld:", &off) == 1) {
+                int fd = open(path, O_RDONLY);
+                if (fd >= 0) {
+                    n = (int)pread(fd, got, sizeof(got) - 1, off);
+                    close(fd);
+                }
+            }
+        }
+        if (n != (int)sizeof(got) - 1 || memcmp(got, HW02_GREP_TEXT, sizeof(got) - 1) != 0) {
+            snprintf(why, whylen, "no match at line %ld", found + 1);
+            return -1;
+        }
+        found++;
+        p = nl ? nl + 1 : end;
+    }
+    if (found == 0) {
+        snprintf(why, whylen, "no matches");
+        return -1;
+    }
+    long want = count_grep_lines("tree");
+    if (want < 0) {
+        snprintf(why, whylen, "cannot read tree: %s", strerror(errno));
+        return -1;
+    }
+    if (found != want) {
+        snprintf(why, whylen, "%ld matching lines, expected %ld", found, want);
+        return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Benchmarks                                                                 */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    const char *name;
+    const char *prog;           /* binary in cfg.bindir */
+    char *args[MAX_ARGS];       /* argv[1..], NULL terminated */
+    const char *stdin_path;     /* in the work directory, NULL for /dev/null */
+    const char *reset[3];       /* files removed before every trial */
+    check_fn check;
+    int deterministic;          /* stdout is identical on every run */
+    long long input_bytes;
+} bench_t;
+
+static char *fmt(const char *f, ...) __attribute__((format(printf, 1, 2)));
+static char *fmt(const char *f, ...) {
+    va_list ap;
+    char *s;
+    va_start(ap, f);
+    if (vasprintf(&s, f, ap) < 0) s = NULL;
+    va_end(ap);
+    if (!s) {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return s;
+}
+
+static long long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : 0;
+}
+
+#define NUM_BENCHES 17
+static bench_t benches[NUM_BENCHES];
+
+static void setup_benches(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+    bench_t b[NUM_BENCHES] = {
+        { "lab6", "lab6", { NULL }, NULL, { "sorted_by_host.csv", "sorted_by_price.csv" }, check_lab6, 1, file_size("listings.csv") },
+        { "lab4", "lab4", { "dest.bin", "src.bin", NULL }, NULL, { "dest.bin" }, check_lab4, 1, in.src_bytes },
+        { "lab7", "lab7", { "commands.txt", NULL }, NULL, { "output.log" }, check_lab7, 0, file_size("commands.txt") },
+        { "hw4_pipe", "hw4", { "-q", "-t", "pipe", "-p", "4", "-c", "8", "-n", fmt("%ld", in.hw4_per_producer),
+                               "-r", fmt("%ld", in.hw4_per_producer * 20), NULL },
+          NULL, { NULL }, check_hw4, 0, in.hw4_per_producer * 4 * (long long)sizeof(int) },
+        { "hw4_shm", "hw4", { "-q", "-t", "shm", "-p", "4", "-c", "8", "-n", fmt("%ld", in.hw4_per_producer),
+                              "-r", fmt("%ld", in.hw4_per_producer * 20), NULL },
+          NULL, { NULL }, check_hw4, 0, in.hw4_per_producer * 4 * (long long)sizeof(int) },
+        { "hw4_shards", "hw4", { "-q", "-t", "pipe", "-s", "4", "-p", "4", "-c", "8", "-n", fmt("%ld", in.hw4_per_producer),
+                                 "-r", fmt("%ld", in.hw4_per_producer * 20), NULL },
+          NULL, { NULL }, check_hw4, 0, in.hw4_per_producer * 4 * (long long)sizeof(int) },
+        { "pthread_sum_struct", "pthread_sum_struct", { fmt("%ld", in.sum_elements), fmt("%ld", cpus), NULL },
+          NULL, { NULL }, check_sum, 1, in.sum_elements * (long long)sizeof(double) },
+        /* four arrays per thread count, so a quarter of the reduction's size */
+        { "pthread_sum_scan", "pthread_sum_struct", { "-S", fmt("%ld", in.sum_elements / 4), fmt("%ld", cpus), NULL },
+          NULL, { NULL }, check_scan, 0, in.sum_elements / 4 * (long long)sizeof(double) },
+        { "oaadigun_HW02", "oaadigun_HW02", { "tree", NULL }, NULL, { NULL }, check_hw02, 1, in.tree_entries },
+        { "hw02_du", "oaadigun_HW02", { "-u", "tree", NULL }, NULL, { NULL }, check_hw02_du, 1, in.tree_entries },
+        { "hw02_dups", "oaadigun_HW02", { "-D", "tree", NULL }, NULL, { NULL }, check_hw02_dups, 1, in.tree_entries },
+        { "hw02_grep", "oaadigun_HW02", { "-g", HW02_GREP_TEXT, "tree", NULL }, NULL, { NULL }, check_hw02_grep, 1, in.tree_entries },
+        { "insertion", "insertion", { NULL }, "ints.txt", { NULL }, check_insertion, 1, file_size("ints.txt") },
+        { "hwins_sort", "hwins", { "-s", NULL }, "strings.txt", { NULL }, check_hwins_sorted, 1, file_size("strings.txt") },
+        { "hwins_count", "hwins", { "-c", NULL }, "strings.txt", { NULL }, check_hwins_count, 1, file_size("strings.txt") },
+        { "prime_range", "prime", { "-r", "0", fmt("%llu", in.prime_limit), NULL }, NULL, { NULL },
+          check_prime_range, 1, (long long)in.prime_limit },
+        { "prime_batch", "prime", { "-b", "nums.txt", NULL }, NULL, { NULL }, check_prime_batch, 1, file_size("nums.txt") },
+    };
+    memcpy(benches, b, sizeof(b));
+}
+
+static int selected(const char *name) {
+    if (!cfg.only) return 1;
+    size_t n = strlen(name);
+    for (const char *p = cfg.only; *p;) {
+        const char *comma = strchr(p, ',');
+        size_t len = comma ? (size_t)(comma - p) : strlen(p);
+        /* "hw4" selects hw4_pipe, hw4_shm and hw4_shards */
+        if (len <= n && strncmp(p, name, len) == 0 && (len == n || name[len] == '_')) return 1;
+        if (!comma) break;
+        p = comma + 1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Counters                                                                   */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} counter_def_t;
+
+static const counter_def_t counter_defs[] = {
+    { "task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "cache_references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { "context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { "cpu_migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+};
+#define NUM_COUNTERS (int)(sizeof(counter_defs) / sizeof(counter_defs[0]))
+
+/* Open every counter on pid (stopped before exec), inherited by the threads
+   and children it creates and enabled by its exec. Unavailable counters get
+   fd -1; if the kernel refuses kernel-mode counting we retry user-only. */
+static void counters_open(pid_t pid, int *fds) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_defs[i].type;
+        attr.config = counter_defs[i].config;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.inherit = 1;
+        attr.exclude_hv = 1;
+        attr.exclude_kernel = (unsigned)cfg.user_only;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds[i] = (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (fds[i] < 0 && (errno == EACCES || errno == EPERM) && !cfg.user_only) {
+            attr.exclude_kernel = 1;
+            fds[i] = (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        }
+    }
+}
+
+/* Read and close the counters; values are scaled up when the kernel had to
+   multiplex them, -1 if unavailable */
+static void counters_read(int *fds, long long *values) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        uint64_t v[3];
+        values[i] = -1;
+        if (fds[i] < 0) continue;
+        if (read(fds[i], v, sizeof(v)) == (ssize_t)sizeof(v) && v[2] > 0)
+            values[i] = (long long)(v[2] < v[1] ? (double)v[0] * v[1] / v[2] : (double)v[0]);
+        close(fds[i]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Running                                                                    */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    double wall_ms;
+    double user_ms;
+    double sys_ms;
+    long max_rss_kb;
+    long long counters[NUM_COUNTERS];
+    uint64_t output_hash;
+} trial_t;
+
+static uint64_t fnv1a(const char *s, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+/* Run b once with stdout in <name>.out and stderr in <name>.err. The child
+   blocks on a pipe until its counters are attached. Returns 0, or -1 with a
+   reason if it could not run, failed or produced wrong output. */
+static int run_trial(const bench_t *b, trial_t *t, char *why, size_t whylen) {
+    char prog[PATH_MAX], outname[128], errname[128];
+    snprintf(prog, sizeof(prog), "%s/%s", cfg.bindir, b->prog);
+    snprintf(outname, sizeof(outname), "%s.out", b->name);
+    snprintf(errname, sizeof(errname), "%s.err", b->name);
+    char *argv[MAX_ARGS + 1] = { prog };
+    for (int i = 0; b->args[i]; i++) argv[i + 1] = b->args[i];
+
+    /* unlink rather than truncate: ext4 flushes a file truncated and
+       rewritten in place when it is closed, which the trial would pay for */
+    unlink(outname);
+    unlink(errname);
+    for (int i = 0; i < 3 && b->reset[i]; i++) unlink(b->reset[i]);
+    int sync[2];
+    if (pipe2(sync, O_CLOEXEC) != 0) {
+        snprintf(why, whylen, "pipe: %s", strerror(errno));
+        return -1;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        snprintf(why, whylen, "fork: %s", strerror(errno));
+        close(sync[0]);
+        close(sync[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(sync[1]);
+        int fin = open(b->stdin_path ? b->stdin_path : "/dev/null", O_RDONLY);
+        int fout = open(outname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int ferr = open(errname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fin < 0 || fout < 0 || ferr < 0) _exit(126);
+        dup2(fin, STDIN_FILENO);
+        dup2(fout, STDOUT_FILENO);
+        dup2(ferr, STDERR_FILENO);
+        char go;
+        if (read(sync[0], &go, 1) != 1) _exit(126);
+        execv(prog, argv);
+        fprintf(stderr, "bench: exec %s: %s\n", prog, strerror(errno));
+        _exit(127);
+    }
+
+    close(sync[0]);
+    int fds[NUM_COUNTERS];
+    counters_open(pid, fds);
+    double t0 = now_sec();
+    ssize_t go = write(sync[1], "g", 1);  /* if this fails the child sees EOF and exits */
+    (void)go;
+    close(sync[1]);
+    int status;
+    struct rusage ru;
+    while (wait4(pid, &status, 0, &ru) < 0 && errno == EINTR) {}
+    t->wall_ms = (now_sec() - t0) * 1e3;
+    counters_read(fds, t->counters);
+    t->user_ms = ru.ru_utime.tv_sec * 1e3 + ru.ru_utime.tv_usec / 1e3;
+    t->sys_ms = ru.ru_stime.tv_sec * 1e3 + ru.ru_stime.tv_usec / 1e3;
+    t->max_rss_kb = ru.ru_maxrss;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (WIFSIGNALED(status)) snprintf(why, whylen, "killed by signal %d", WTERMSIG(status));
+        else snprintf(why, whylen, "exit status %d (see %s/%s)", WEXITSTATUS(status), cfg.workdir, errname);
+        return -1;
+    }
+    size_t len;
+    char *out = read_file(outname, &len);
+    if (!out) {
+        snprintf(why, whylen, "cannot read %s", outname);
+        return -1;
+    }
+    t->output_hash = fnv1a(out, len);
+    int rc = b->check(out, len, why, whylen);
+    free(out);
+    return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Results                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, int n) {
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static void json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(fp, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(fp, "\\u%04x", *s);
+        else fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/* One benchmark as a single-line JSON object: bench -C relies on that */
+static void write_result(FILE *fp, const bench_t *b, trial_t *t, int n, const char *error, int last) {
+    double v[MAX_TRIALS], sum = 0;
+    char args[512] = "";
+    for (int i = 0; b->args[i]; i++) {
+        size_t used = strlen(args);
+        snprintf(args + used, sizeof(args) - used, "%s%s", i ? " " : "", b->args[i]);
+    }
+
+    fprintf(fp, "    {\"name\": ");
+    json_string(fp, b->name);
+    fprintf(fp, ", \"program\": ");
+    json_string(fp, b->prog);
+    fprintf(fp, ", \"args\": ");
+    json_string(fp, args);
+    fprintf(fp, ", \"stdin\": ");
+    if (b->stdin_path) json_string(fp, b->stdin_path);
+    else fprintf(fp, "null");
+    fprintf(fp, ", \"input_bytes\": %lld, \"trials\": %d, \"ok\": %s, \"error\": ", b->input_bytes, n,
+            error ? "false" : "true");
+    if (error) json_string(fp, error);
+    else fprintf(fp, "null");
+
+    if (n > 0) {
+        for (int i = 0; i < n; i++) {
+            v[i] = t[i].wall_ms;
+            sum += v[i];
+        }
+        double med = median(v, n);
+        fprintf(fp, ", \"wall_ms\": {\"median\": %.3f, \"min\": %.3f, \"mean\": %.3f, \"max\": %.3f}",
+                med, v[0], sum / n, v[n - 1]);
+        for (int i = 0; i < n; i++) v[i] = t[i].user_ms;
+        fprintf(fp, ", \"user_ms\": %.3f", median(v, n));
+        for (int i = 0; i < n; i++) v[i] = t[i].sys_ms;
+        fprintf(fp, ", \"sys_ms\": %.3f", median(v, n));
+        long rss = 0;
+        for (int i = 0; i < n; i++)
+            if (t[i].max_rss_kb > rss) rss = t[i].max_rss_kb;
+        fprintf(fp, ", \"max_rss_kb\": %ld, \"counters\": {", rss);
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            int have = 1;
+            for (int i = 0; i < n; i++) {
+                if (t[i].counters[c] < 0) have = 0;
+                v[i] = (double)t[i].counters[c];
+            }
+            fprintf(fp, "%s\"%s\": ", c ? ", " : "", counter_defs[c].name);
+            if (have) fprintf(fp, "%.0f", median(v, n));
+            else fprintf(fp, "null");
+        }
+        fprintf(fp, "}");
+        if (b->deterministic) {
+            int stable = 1;
+            for (int i = 1; i < n; i++)
+                if (t[i].output_hash != t[0].output_hash) stable = 0;
+            fprintf(fp, ", \"output_hash\": \"%016llx\", \"output_stable\": %s",
+                    (unsigned long long)t[0].output_hash, stable ? "true" : "false");
+        }
+    }
+    fprintf(fp, "}%s\n", last ? "" : ",");
+}
+
+static int run_all(void) {
+    FILE *fp = strcmp(cfg.out, "-") == 0 ? stdout : fopen(cfg.out, "w");
+    if (!fp) {
+        fprintf(stderr, "bench: cannot create %s: %s\n", cfg.out, strerror(errno));
+        return 1;
+    }
+
+    struct utsname un;
+    uname(&un);
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(fp, "{\n  \"schema\": 1,\n  \"label\": ");
+    json_string(fp, cfg.label);
+    fprintf(fp, ",\n  \"date\": \"%s\",\n  \"host\": {\"name\": ", date);
+    json_string(fp, un.nodename);
+    fprintf(fp, ", \"kernel\": ");
+    json_string(fp, un.release);
+    fprintf(fp, ", \"machine\": ");
+    json_string(fp, un.machine);
+    fprintf(fp, ", \"cpus\": %ld},\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(fp, "  \"scale\": %g,\n  \"warmups\": %d,\n  \"benchmarks\": [\n", cfg.scale, cfg.warmups);
+
+    int nsel = 0, done = 0, failed = 0;
+    for (int i = 0; i < NUM_BENCHES; i++) nsel += selected(benches[i].name);
+
+    for (int i = 0; i < NUM_BENCHES; i++) {
+        const bench_t *b = &benches[i];
+        if (!selected(b->name)) continue;
+        trial_t trials[MAX_TRIALS];
+        char why[256] = "";
+        int n = 0, bad = 0;
+
+        fprintf(stderr, "%-20s", b->name);
+        for (int w = 0; w < cfg.warmups && !bad; w++) {
+            trial_t t;
+            bad = run_trial(b, &t, why, sizeof(why)) != 0;
+        }
+        while (!bad && n < cfg.trials) {
+            if (run_trial(b, &trials[n], why, sizeof(why)) != 0) bad = 1;
+            else n++;
+        }
+        if (bad) {
+            failed++;
+            fprintf(stderr, " FAILED: %s\n", why);
+        } else {
+            double v[MAX_TRIALS];
+            for (int k = 0; k < n; k++) v[k] = trials[k].wall_ms;
+            fprintf(stderr, " %10.2f ms median of %d\n", median(v, n), n);
+        }
+        write_result(fp, b, trials, n, bad ? why : NULL, ++done == nsel);
+    }
+    fprintf(fp, "  ]\n}\n");
+    if (fp != stdout && fclose(fp) != 0) {
+        fprintf(stderr, "bench: error writing %s\n", cfg.out);
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Comparing two result files                                                 */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    char name[64];
+    double wall;          /* median ms, -1 if the benchmark failed */
+    double instructions;  /* -1 if not counted */
+} summary_t;
+
+/* Pull the per-benchmark lines out of a file written by write_result() */
+static int load_summary(const char *path, summary_t *s, int max) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "bench: cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[4096];
+    int n = 0;
+    while (n < max && fgets(line, sizeof(line), fp)) {
+        const char *p;
+        if (sscanf(line, "    {\"name\": \"%63[^\"]", s[n].name) != 1) continue;
+        s[n].wall = -1;
+        s[n].instructions = -1;
+        if ((p = strstr(line, "\"wall_ms\": {\"median\": ")) != NULL)
+            s[n].wall = atof(p + strlen("\"wall_ms\": {\"median\": "));
+        if ((p = strstr(line, "\"instructions\": ")) != NULL && strncmp(p + 16, "null", 4) != 0)
+            s[n].instructions = atof(p + 16);
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+static int compare(const char *base_path, const char *new_path, double threshold) {
+    summary_t base[64], cur[64];
+    int nb = load_summary(base_path, base, 64), nc = load_summary(new_path, cur, 64);
+    if (nb < 0 || nc < 0) return 2;
+
+    int regressions = 0;
+    printf("%-20s %12s %12s %9s %9s\n", "benchmark", "base ms", "new ms", "wall", "instr");
+    for (int i = 0; i < nc; i++) {
+        const summary_t *o = NULL;
+        for (int j = 0; j < nb; j++)
+            if (strcmp(base[j].name, cur[i].name) == 0) o = &base[j];
+        printf("%-20s", cur[i].name);
+        if (!o || o->wall < 0 || cur[i].wall < 0) {
+            printf(" %12s %12s\n", o && o->wall >= 0 ? "" : "-", cur[i].wall >= 0 ? "" : "FAILED");
+            if (cur[i].wall < 0) regressions++;
+            continue;
+        }
+        double dw = (cur[i].wall / o->wall - 1) * 100;
+        printf(" %12.2f %12.2f %+8.1f%%", o->wall, cur[i].wall, dw);
+        if (o->instructions > 0 && cur[i].instructions > 0)
+            printf(" %+8.1f%%", (cur[i].instructions / o->instructions - 1) * 100);
+        else
+            printf(" %9s", "-");
+        if (dw > threshold) {
+            printf("  REGRESSION");
+            regressions++;
+        }
+        printf("\n");
+    }
+    if (regressions) printf("%d benchmark(s) slower than %s by more than %.0f%% or failing\n",
+                            regressions, base_path, threshold);
+    return regressions ? 1 : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s -d bindir [-w workdir] [-s scale] [-n trials] [-W warmups]\n"
+                    "          [-b name,...] [-c label] [-u] [-o results.json]\n"
+                    "       %s -C base.json new.json [-T percent]\n"
+                    "  -u  count user-space events only\n"
+                    "  -C  compare median wall times; exit 1 on a regression above -T (default %.0f%%)\n",
+            prog, prog, DEFAULT_THRESHOLD);
+}
+
+int main(int argc, char *argv[]) {
+    const char *compare_base = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:w:s:n:W:b:c:uo:C:T:")) != -1) {
+        switch (opt) {
+        case 'd': cfg.bindir = optarg; break;
+        case 'w': cfg.workdir = optarg; break;
+        case 's': cfg.scale = atof(optarg); break;
+        case 'n': cfg.trials = atoi(optarg); break;
+        case 'W': cfg.warmups = atoi(optarg); break;
+        case 'b': cfg.only = optarg; break;
+        case 'c': cfg.label = optarg; break;
+        case 'u': cfg.user_only = 1; break;
+        case 'o': cfg.out = optarg; break;
+        case 'C': compare_base = optarg; break;
+        case 'T': threshold = atof(optarg); break;
+        default: usage(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+    if (compare_base) {
+        if (optind + 1 != argc) {
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        return compare(compare_base, argv[optind], threshold);
+    }
+    if (!cfg.bindir || optind != argc || cfg.scale <= 0 || cfg.trials < 1 || cfg.trials > MAX_TRIALS ||
+        cfg.warmups < 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* the programs run inside the work directory */
+    char bindir[PATH_MAX], out[PATH_MAX];
+    if (!realpath(cfg.bindir, bindir)) {
+        fprintf(stderr, "bench: %s: %s\n", cfg.bindir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    cfg.bindir = bindir;
+    if (strcmp(cfg.out, "-") != 0 && cfg.out[0] != '/') {
+        if (strlen(cfg.out) + 2 >= sizeof(out)) {
+            fprintf(stderr, "bench: -o %s: path too long\n", cfg.out);
+            exit(EXIT_FAILURE);
+        }
+        if (!getcwd(out, sizeof(out) - strlen(cfg.out) - 2)) {
+            perror("getcwd");
+            exit(EXIT_FAILURE);
+        }
+        strcat(out, "/");
+        strcat(out, cfg.out);
+        cfg.out = out;
+    }
+
+    generate_inputs();
+    setup_benches();
+    return run_all();
+}
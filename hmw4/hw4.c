@@ -10,26 +10,85 @@
 #include <time.h>
 #include <stdint.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
 
-/* Parameters */
+#include "../trace.h"
+
+/* Default parameters; each can be overridden on the command line */
 #define NUM_PRODUCERS 10
 #define NUM_CONSUMERS 20
 #define PER_PRODUCER 500
-#define PER_CONSUMER 250
 #define RAND_MAX_VAL 1000
+#define REPORT_MS 200
 
-/* check at compile/run time */
-#if NUM_PRODUCERS * PER_PRODUCER != NUM_CONSUMERS * PER_CONSUMER
-#error "Total numbers produced must equal total numbers consumed"
-#endif
+/* Run configuration, filled in by main() before fork so both processes see it */
+typedef struct {
+    int producers;        /* -p */
+    int consumers;        /* -c */
+    int per_producer;     /* -n: unique values each producer sends */
+    int max_val;          /* -r: values are drawn from [0, max_val] */
+    int pin;              /* -a: pin threads to cores */
+    int numa;             /* -N: spread threads across NUMA nodes */
+    int quiet;            /* -q: no progress reports or per-thread lines */
+    const char *gen;      /* -g: random generator name */
+    int report_ms;        /* -i: reporter sampling interval */
+    int shards;           /* -s: consumer processes, each with its own transport */
+    int route;            /* -R: how producers pick a shard for each batch */
+} config_t;
+
+#define ROUTE_RR 0        /* batches go to shards in turn */
+#define ROUTE_HASH 1      /* each value goes to the shard its hash picks */
+
+static config_t cfg = { NUM_PRODUCERS, NUM_CONSUMERS, PER_PRODUCER, RAND_MAX_VAL, 0, 0, 0, "xoshiro", REPORT_MS,
+                        1, ROUTE_RR };
 
-/* Globals for pipe and synchronization (in parent) */
-int pipefd[2]; /* pipefd[1] = write end, pipefd[0] = read end */
+/* Items move through the transport in batches. A pipe batch must stay within
+   PIPE_BUF so that one write() lands atomically and readers never see half an item. */
+#define BATCH_ITEMS 64
+#define RING_SLOTS (1u << 16)   /* must be a power of two */
+#define CACHE_LINE 64
+#define SPIN_MIN 64
+#define SPIN_MAX 16384
+#define LAT_BUCKETS 64
+
+/* One value on the wire. The first item of every batch carries the producer's
+   CLOCK_MONOTONIC timestamp so the consumer can sample end-to-end latency. */
+typedef struct {
+    int32_t value;
+    uint32_t flags;
+    uint64_t stamp_ns;
+} item_t;
+
+#define ITEM_STAMPED 1u
+
+#if BATCH_ITEMS * 16 > 4096
+#error "BATCH_ITEMS * sizeof(item_t) must not exceed PIPE_BUF"
+#endif
 
-/* Mutexes for writing and printing */
-pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Mutex for printing */
 pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
 /* Utility: write exactly n bytes */
 ssize_t write_full(int fd, const void *buf, size_t count) {
     size_t left = count;
@@ -63,77 +122,897 @@ ssize_t read_full(int fd, void *buf, size_t count) {
     return (ssize_t)count;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Shared-memory ring                                                         */
+/* ------------------------------------------------------------------------- */
+
+/* Bounded MPMC ring in a MAP_SHARED mapping created before fork(), so the
+   parent's producers and the child's consumers see the same pages.
+   Each cell carries a sequence number (Vyukov style): a cell at position pos
+   is free when seq == pos and full when seq == pos + 1. Both sides claim whole
+   runs of cells with one CAS on their index, which keeps the per-item cost to
+   a copy and a release store. Indices and futex words live on separate cache
+   lines so producers and consumers do not false-share. */
+typedef struct {
+    _Atomic uint64_t seq;
+    item_t item;
+} ring_cell_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t tail;     /* next position to fill */
+    _Alignas(CACHE_LINE) _Atomic uint64_t head;     /* next position to drain */
+    _Alignas(CACHE_LINE) _Atomic uint32_t data_futex;  /* bumped when items are published */
+    _Atomic uint32_t cons_waiters;
+    _Atomic uint32_t cons_spin;                      /* adaptive spin budget */
+    _Alignas(CACHE_LINE) _Atomic uint32_t space_futex; /* bumped when cells are freed */
+    _Atomic uint32_t prod_waiters;
+    _Atomic uint32_t prod_spin;
+    _Alignas(CACHE_LINE) _Atomic uint32_t closed;
+    _Alignas(CACHE_LINE) ring_cell_t cells[RING_SLOTS];
+} shm_ring_t;
+
+static long futex_wait(_Atomic uint32_t *addr, uint32_t val) {
+    /* not FUTEX_PRIVATE: the word is shared between parent and child */
+    return syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+static long futex_wake(_Atomic uint32_t *addr, int n) {
+    return syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, n, NULL, NULL, 0);
+}
+
+static shm_ring_t *ring_create(void) {
+    shm_ring_t *r = mmap(NULL, sizeof(shm_ring_t), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (r == MAP_FAILED) return NULL;
+    /* anonymous mappings are zero-filled; only the cell sequences need setting */
+    for (uint64_t i = 0; i < RING_SLOTS; ++i)
+        atomic_store_explicit(&r->cells[i].seq, i, memory_order_relaxed);
+    atomic_store(&r->cons_spin, SPIN_MIN);
+    atomic_store(&r->prod_spin, SPIN_MIN);
+    return r;
+}
+
+/* Claim up to max consecutive cells in the state given by `want_off`
+   (0 = free for producers, 1 = full for consumers). Returns the number claimed
+   and the first position in *start, or 0 when nothing is ready. */
+static size_t ring_claim(shm_ring_t *r, _Atomic uint64_t *index, uint64_t want_off,
+                         size_t max, uint64_t *start) {
+    uint64_t pos = atomic_load_explicit(index, memory_order_relaxed);
+    for (;;) {
+        size_t n = 0;
+        while (n < max) {
+            ring_cell_t *c = &r->cells[(pos + n) & (RING_SLOTS - 1)];
+            uint64_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+            if (seq != pos + n + want_off) break;
+            ++n;
+        }
+        if (n == 0) {
+            uint64_t cur = atomic_load_explicit(index, memory_order_relaxed);
+            if (cur == pos) return 0;
+            pos = cur;
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(index, &pos, pos + n,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            *start = pos;
+            return n;
+        }
+        /* pos was reloaded by the failed CAS */
+    }
+}
+
+/* Spin for a while, then sleep on the futex until `ready` holds.
+   The spin budget grows when spinning pays off and shrinks when it doesn't. */
+static void ring_wait(shm_ring_t *r, _Atomic uint32_t *futex, _Atomic uint32_t *waiters,
+                      _Atomic uint32_t *spin, int (*ready)(shm_ring_t *)) {
+    uint32_t budget = atomic_load_explicit(spin, memory_order_relaxed);
+    for (uint32_t i = 0; i < budget; ++i) {
+        if (ready(r)) {
+            if (budget < SPIN_MAX) atomic_store_explicit(spin, budget * 2, memory_order_relaxed);
+            return;
+        }
+        cpu_relax();
+    }
+    if (budget > SPIN_MIN) atomic_store_explicit(spin, budget / 2, memory_order_relaxed);
+
+    uint32_t val = atomic_load(futex);
+    atomic_fetch_add(waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst); /* pairs with the fence in ring_notify */
+    if (!ready(r)) {
+        TRACE_BEGIN("futex wait");
+        futex_wait(futex, val);
+        TRACE_END("futex wait");
+    }
+    atomic_fetch_sub(waiters, 1);
+}
+
+static void ring_notify(_Atomic uint32_t *futex, _Atomic uint32_t *waiters, int n) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(waiters) > 0) {
+        atomic_fetch_add(futex, 1);
+        futex_wake(futex, n);
+    }
+}
+
+static int ring_has_data(shm_ring_t *r) {
+    uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    ring_cell_t *c = &r->cells[h & (RING_SLOTS - 1)];
+    return atomic_load_explicit(&c->seq, memory_order_acquire) == h + 1 ||
+           atomic_load(&r->closed);
+}
+
+static int ring_has_space(shm_ring_t *r) {
+    uint64_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    ring_cell_t *c = &r->cells[t & (RING_SLOTS - 1)];
+    return atomic_load_explicit(&c->seq, memory_order_acquire) == t;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Transports                                                                 */
+/* ------------------------------------------------------------------------- */
+
+/* A transport moves batches of items from the parent's producers to one
+   consumer process. send() returns 0 or -1; recv() returns the number of
+   items read, 0 on EOF, -1 on error. */
+typedef struct transport {
+    const char *name;
+    int (*send)(struct transport *t, const item_t *items, size_t n);
+    ssize_t (*recv)(struct transport *t, item_t *items, size_t max);
+    void (*producer_side)(struct transport *t);  /* called in the parent after fork */
+    void (*consumer_side)(struct transport *t);  /* called in the child after fork */
+    void (*close_write)(struct transport *t);    /* all producers done */
+    long long (*depth)(struct transport *t);     /* items queued, -1 if unknown */
+    shm_ring_t *ring;
+    int fd[2];                       /* pipe: fd[1] = write end, fd[0] = read end, -1 once closed */
+    pthread_mutex_t write_mutex;
+} transport_t;
+
+static void close_fd(int *fd) {
+    if (*fd >= 0) close(*fd);
+    *fd = -1;
+}
+
+static int pipe_send(transport_t *t, const item_t *items, size_t n) {
+    /* lock write so our batches go out whole and in one piece */
+    TRACE_BEGIN("write_mutex wait");
+    pthread_mutex_lock(&t->write_mutex);
+    TRACE_END("write_mutex wait");
+    TRACE_BEGIN("pipe write");
+    ssize_t w = write_full(t->fd[1], items, n * sizeof(item_t));
+    TRACE_END("pipe write");
+    pthread_mutex_unlock(&t->write_mutex);
+    return w == (ssize_t)(n * sizeof(item_t)) ? 0 : -1;
+}
+
+/* Every write is a whole number of items no larger than PIPE_BUF and every read
+   asks for a whole number of items, so concurrent readers each get whole items.
+   read_full() only runs if that ever stops holding. */
+static ssize_t pipe_recv(transport_t *t, item_t *items, size_t max) {
+    ssize_t r;
+    TRACE_BEGIN("pipe read");
+    do {
+        r = read(t->fd[0], items, max * sizeof(item_t));
+    } while (r < 0 && errno == EINTR);
+    TRACE_END("pipe read");
+    if (r <= 0) return r;
+    size_t rem = (size_t)r % sizeof(item_t);
+    if (rem) {
+        ssize_t more = read_full(t->fd[0], (uint8_t*)items + r, sizeof(item_t) - rem);
+        if (more != (ssize_t)(sizeof(item_t) - rem)) return -1;
+        r += more;
+    }
+    return r / (ssize_t)sizeof(item_t);
+}
+
+static void pipe_producer_side(transport_t *t) { close_fd(&t->fd[0]); }
+static void pipe_consumer_side(transport_t *t) { close_fd(&t->fd[1]); }
+static void pipe_close_write(transport_t *t) { close_fd(&t->fd[1]); }
+
+/* Items waiting in the pipe. FIONREAD works on either end, and each process
+   only keeps one of them open. */
+static long long pipe_depth(transport_t *t) {
+    int bytes;
+    if (ioctl(t->fd[0], FIONREAD, &bytes) < 0 && ioctl(t->fd[1], FIONREAD, &bytes) < 0) return -1;
+    return bytes / (long long)sizeof(item_t);
+}
+
+static int shm_send(transport_t *t, const item_t *items, size_t n) {
+    shm_ring_t *r = t->ring;
+    while (n > 0) {
+        uint64_t start;
+        size_t got = ring_claim(r, &r->tail, 0, n, &start);
+        if (got == 0) {
+            ring_wait(r, &r->space_futex, &r->prod_waiters, &r->prod_spin, ring_has_space);
+            continue;
+        }
+        for (size_t i = 0; i < got; ++i) {
+            ring_cell_t *c = &r->cells[(start + i) & (RING_SLOTS - 1)];
+            c->item = items[i];
+            atomic_store_explicit(&c->seq, start + i + 1, memory_order_release);
+        }
+        ring_notify(&r->data_futex, &r->cons_waiters, (int)got);
+        items += got;
+        n -= got;
+    }
+    return 0;
+}
+
+static ssize_t shm_recv(transport_t *t, item_t *items, size_t max) {
+    shm_ring_t *r = t->ring;
+    for (;;) {
+        /* read the flag before claiming: every item was published before it was set,
+           so a failed claim after seeing it means the ring is drained */
+        int closed = (int)atomic_load(&r->closed);
+        uint64_t start;
+        size_t got = ring_claim(r, &r->head, 1, max, &start);
+        if (got > 0) {
+            for (size_t i = 0; i < got; ++i) {
+                ring_cell_t *c = &r->cells[(start + i) & (RING_SLOTS - 1)];
+                items[i] = c->item;
+                atomic_store_explicit(&c->seq, start + i + RING_SLOTS, memory_order_release);
+            }
+            ring_notify(&r->space_futex, &r->prod_waiters, (int)got);
+            return (ssize_t)got;
+        }
+        if (closed) return 0;
+        ring_wait(r, &r->data_futex, &r->cons_waiters, &r->cons_spin, ring_has_data);
+    }
+}
+
+static long long shm_depth(transport_t *t) {
+    uint64_t h = atomic_load_explicit(&t->ring->head, memory_order_relaxed);
+    uint64_t tl = atomic_load_explicit(&t->ring->tail, memory_order_relaxed);
+    return tl > h ? (long long)(tl - h) : 0;
+}
+
+static void shm_side_noop(transport_t *t) { (void)t; }
+
+static void shm_close_write(transport_t *t) {
+    atomic_store(&t->ring->closed, 1);
+    atomic_fetch_add(&t->ring->data_futex, 1);
+    futex_wake(&t->ring->data_futex, INT_MAX);
+}
+
+/* One transport per shard; a consumer process only keeps its own */
+static transport_t *transports;
+
+static int transport_init(transport_t *t, const char *name) {
+    memset(t, 0, sizeof(*t));
+    t->fd[0] = t->fd[1] = -1;
+    if (strcmp(name, "pipe") == 0) {
+        if (pipe(t->fd) < 0) {
+            perror("pipe");
+            return -1;
+        }
+        pthread_mutex_init(&t->write_mutex, NULL);
+        t->name = "pipe";
+        t->send = pipe_send;
+        t->recv = pipe_recv;
+        t->producer_side = pipe_producer_side;
+        t->consumer_side = pipe_consumer_side;
+        t->close_write = pipe_close_write;
+        t->depth = pipe_depth;
+        return 0;
+    }
+    if (strcmp(name, "shm") == 0) {
+        t->ring = ring_create();
+        if (!t->ring) {
+            perror("mmap ring");
+            return -1;
+        }
+        t->name = "shm";
+        t->send = shm_send;
+        t->recv = shm_recv;
+        t->producer_side = shm_side_noop;
+        t->consumer_side = shm_side_noop;
+        t->close_write = shm_close_write;
+        t->depth = shm_depth;
+        return 0;
+    }
+    fprintf(stderr, "Unknown transport '%s' (expected pipe or shm)\n", name);
+    return -1;
+}
+
+/* Drop another shard's transport in a consumer process: close both pipe ends
+   (or its EOF would never come) and unmap its ring. */
+static void transport_release(transport_t *t) {
+    close_fd(&t->fd[0]);
+    close_fd(&t->fd[1]);
+    if (t->ring) munmap(t->ring, sizeof(shm_ring_t));
+    t->ring = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Progress reporting                                                         */
+/* ------------------------------------------------------------------------- */
+
+/* Each worker owns one counter on its own cache line and bumps it with a
+   relaxed store, so the hot path never takes a lock or touches stdout.
+   A reporter thread in each process samples the counters every report_ms
+   and prints the aggregate rate, the spread between threads and the
+   queue depth of the transports the process uses. */
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t items;
+} thread_counter_t;
+
+static inline void counter_add(thread_counter_t *c, uint64_t n) {
+    /* single writer: a plain load/store pair is enough */
+    uint64_t v = atomic_load_explicit(&c->items, memory_order_relaxed);
+    atomic_store_explicit(&c->items, v + n, memory_order_relaxed);
+}
+
+typedef struct {
+    const char *role;          /* "producers" or "consumers" */
+    thread_counter_t *counters;
+    int n;
+    uint64_t *last;            /* per-thread counts at the previous sample */
+    transport_t *shards;       /* transports whose depth is reported */
+    int nshards;
+    uint64_t t_start;
+    int stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+} reporter_t;
+
+static thread_counter_t *counters_alloc(int n) {
+    thread_counter_t *c = aligned_alloc(CACHE_LINE, sizeof(thread_counter_t) * (size_t)n);
+    if (c) memset(c, 0, sizeof(thread_counter_t) * (size_t)n);
+    return c;
+}
+
+/* Print one line for the interval since the previous sample. Skew is the
+   spread of per-thread progress in the interval relative to the mean. */
+static void reporter_sample(reporter_t *rep, uint64_t *prev_ns, const char *tag) {
+    uint64_t t = now_ns();
+    double dt = (double)(t - *prev_ns) / 1e9;
+    *prev_ns = t;
+    uint64_t total = 0, delta = 0, dmin = UINT64_MAX, dmax = 0;
+    for (int i = 0; i < rep->n; ++i) {
+        uint64_t v = atomic_load_explicit(&rep->counters[i].items, memory_order_relaxed);
+        uint64_t d = v - rep->last[i];
+        rep->last[i] = v;
+        total += v;
+        delta += d;
+        if (d < dmin) dmin = d;
+        if (d > dmax) dmax = d;
+    }
+    double mean = (double)delta / rep->n;
+    double skew = mean > 0 ? (double)(dmax - dmin) / mean : 0.0;
+    long long depth = 0;
+    for (int s = 0; s < rep->nshards && depth >= 0; ++s) {
+        long long d = rep->shards[s].depth(&rep->shards[s]);
+        depth = d < 0 ? -1 : depth + d;
+    }
+    TRACE_COUNTER("queue depth", depth);
+
+    pthread_mutex_lock(&print_mutex);
+    printf("[%s %s] t=%.3fs total=%llu rate=%.2f Mitems/s per-thread min=%llu max=%llu skew=%.2f depth=%lld\n",
+           rep->role, tag, (double)(t - rep->t_start) / 1e9, (unsigned long long)total,
+           dt > 0 ? (double)delta / dt / 1e6 : 0.0,
+           (unsigned long long)dmin, (unsigned long long)dmax, skew, depth);
+    fflush(stdout);
+    pthread_mutex_unlock(&print_mutex);
+}
+
+static void *reporter_thread(void *arg) {
+    reporter_t *rep = (reporter_t*)arg;
+    uint64_t prev = rep->t_start;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    pthread_mutex_lock(&rep->mutex);
+    while (!rep->stop) {
+        deadline.tv_nsec += (long)cfg.report_ms * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        while (!rep->stop && pthread_cond_timedwait(&rep->cond, &rep->mutex, &deadline) != ETIMEDOUT)
+            ;
+        if (rep->stop) break;
+        pthread_mutex_unlock(&rep->mutex);
+        reporter_sample(rep, &prev, "progress");
+        pthread_mutex_lock(&rep->mutex);
+    }
+    pthread_mutex_unlock(&rep->mutex);
+    reporter_sample(rep, &prev, "final");
+    return NULL;
+}
+
+/* Start a reporter over n counters and nshards transports; in quiet mode
+   nothing is started */
+static int reporter_start(reporter_t *rep, const char *role, thread_counter_t *counters, int n,
+                          transport_t *shards, int nshards) {
+    memset(rep, 0, sizeof(*rep));
+    rep->role = role;
+    rep->counters = counters;
+    rep->n = n;
+    rep->shards = shards;
+    rep->nshards = nshards;
+    rep->t_start = now_ns();
+    if (cfg.quiet) return 0;
+    rep->last = calloc((size_t)n, sizeof(uint64_t));
+    if (!rep->last) return -1;
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&rep->cond, &ca);
+    pthread_condattr_destroy(&ca);
+    pthread_mutex_init(&rep->mutex, NULL);
+    if (pthread_create(&rep->thread, NULL, reporter_thread, rep) != 0) {
+        free(rep->last);
+        rep->last = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void reporter_stop(reporter_t *rep) {
+    if (!rep->last) return;
+    pthread_mutex_lock(&rep->mutex);
+    rep->stop = 1;
+    pthread_cond_signal(&rep->cond);
+    pthread_mutex_unlock(&rep->mutex);
+    pthread_join(rep->thread, NULL);
+    pthread_cond_destroy(&rep->cond);
+    pthread_mutex_destroy(&rep->mutex);
+    free(rep->last);
+    rep->last = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Random generators and unique sampling                                      */
+/* ------------------------------------------------------------------------- */
+
+/* A generator is a name plus seed/next32 functions over a small state block,
+   picked at run time with -g. rand_r is kept for comparison with the
+   original code; xoshiro128** and pcg32 are much faster and pass BigCrush. */
+typedef struct rng {
+    union {
+        uint64_t s[4];
+        uint32_t s32[4];     /* xoshiro128** works on 32-bit words */
+    };
+    uint32_t (*next32)(struct rng *g);
+} rng_t;
+
+typedef struct {
+    const char *name;
+    void (*seed)(rng_t *g, uint64_t seed);
+    uint32_t (*next32)(rng_t *g);
+} rng_kind_t;
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t rotl32(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+/* xoshiro128**: state is four 32-bit words in s32, only ever accessed as
+   uint32_t so the compiler can't mistake them for the uint64_t view */
+static void xoshiro_seed(rng_t *g, uint64_t seed) {
+    for (int i = 0; i < 4; i += 2) {
+        uint64_t z = splitmix64(&seed);
+        g->s32[i] = (uint32_t)z;
+        g->s32[i + 1] = (uint32_t)(z >> 32);
+    }
+}
+
+static uint32_t xoshiro_next32(rng_t *g) {
+    uint32_t *q = g->s32;
+    uint32_t result = rotl32(q[1] * 5, 7) * 9;
+    uint32_t t = q[1] << 9;
+    q[2] ^= q[0];
+    q[3] ^= q[1];
+    q[1] ^= q[2];
+    q[0] ^= q[3];
+    q[2] ^= t;
+    q[3] = rotl32(q[3], 11);
+    return result;
+}
+
+/* pcg32 (XSH-RR): s[0] is the state, s[1] the odd increment */
+static void pcg_seed(rng_t *g, uint64_t seed) {
+    g->s[1] = (splitmix64(&seed) << 1) | 1u;
+    g->s[0] = splitmix64(&seed) + g->s[1];
+}
+
+static uint32_t pcg_next32(rng_t *g) {
+    uint64_t old = g->s[0];
+    g->s[0] = old * 6364136223846793005ull + g->s[1];
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    int rot = (int)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+/* rand_r only yields 31 bits; two calls fill a 32-bit word */
+static void rand_r_seed(rng_t *g, uint64_t seed) { g->s[0] = (unsigned int)seed; }
+
+static uint32_t rand_r_next32(rng_t *g) {
+    unsigned int st = (unsigned int)g->s[0];
+    uint32_t hi = (uint32_t)rand_r(&st);
+    uint32_t lo = (uint32_t)rand_r(&st);
+    g->s[0] = st;
+    return (hi << 16) ^ lo;
+}
+
+static const rng_kind_t rng_kinds[] = {
+    { "xoshiro", xoshiro_seed, xoshiro_next32 },
+    { "pcg",     pcg_seed,     pcg_next32 },
+    { "rand_r",  rand_r_seed,  rand_r_next32 },
+};
+
+static const rng_kind_t *rng_find(const char *name) {
+    for (size_t i = 0; i < sizeof(rng_kinds) / sizeof(rng_kinds[0]); ++i)
+        if (strcmp(rng_kinds[i].name, name) == 0) return &rng_kinds[i];
+    return NULL;
+}
+
+static void rng_init(rng_t *g, const rng_kind_t *kind, uint64_t seed) {
+    memset(g, 0, sizeof(*g));
+    g->next32 = kind->next32;
+    kind->seed(g, seed);
+}
+
+/* Uniform value in [0, bound) without modulo bias (Lemire's multiply-shift) */
+static inline uint32_t rng_below(rng_t *g, uint32_t bound) {
+    uint64_t m = (uint64_t)g->next32(g) * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound) {
+        uint32_t threshold = (0u - bound) % bound;
+        while (low < threshold) {
+            m = (uint64_t)g->next32(g) * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+/* Draws k distinct values from [0, range) in batches. Every draw costs O(1)
+   whatever the density, unlike rejection sampling which degrades toward the
+   coupon collector as k approaches range.
+   Dense requests (k at least range/8) use a partial Fisher-Yates shuffle over
+   an identity array; sparse ones use Floyd's algorithm with a small hash set,
+   so memory stays O(k) even for a huge range. Floyd yields a uniform random
+   set but not a uniformly random order, which doesn't matter here. */
+typedef struct {
+    rng_t *rng;
+    uint32_t range;
+    uint32_t k;
+    uint32_t drawn;
+    uint32_t *perm;       /* dense: perm[drawn..range) are still undrawn */
+    uint32_t *set;        /* sparse: open-addressing set of drawn values + 1 */
+    uint32_t set_mask;
+} unique_sampler_t;
+
+static int sampler_init(unique_sampler_t *u, rng_t *rng, uint32_t range, uint32_t k) {
+    memset(u, 0, sizeof(*u));
+    u->rng = rng;
+    u->range = range;
+    u->k = k;
+    if ((uint64_t)k * 8 >= range) {
+        u->perm = malloc(sizeof(uint32_t) * range);
+        if (!u->perm) return -1;
+        for (uint32_t i = 0; i < range; ++i) u->perm[i] = i;
+    } else {
+        uint32_t cap = 16;
+        while (cap < 2 * k) cap <<= 1;
+        u->set = calloc(cap, sizeof(uint32_t));
+        if (!u->set) return -1;
+        u->set_mask = cap - 1;
+    }
+    return 0;
+}
+
+/* Insert v into the sparse set; returns 0 if it was already there */
+static int sampler_set_insert(unique_sampler_t *u, uint32_t v) {
+    uint32_t h = (v * 0x9e3779b1u) & u->set_mask;
+    while (u->set[h]) {
+        if (u->set[h] == v + 1) return 0;
+        h = (h + 1) & u->set_mask;
+    }
+    u->set[h] = v + 1;
+    return 1;
+}
+
+/* Bulk API: write up to n fresh values to out, returns how many were written
+   (less than n only once all k have been drawn). */
+static size_t sampler_fill(unique_sampler_t *u, int32_t *out, size_t n) {
+    size_t left = u->k - u->drawn;
+    if (n > left) n = left;
+    if (u->perm) {
+        uint32_t *perm = u->perm;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t d = u->drawn + (uint32_t)i;
+            uint32_t j = d + rng_below(u->rng, u->range - d);
+            uint32_t tmp = perm[j];
+            perm[j] = perm[d];
+            perm[d] = tmp;
+            out[i] = (int32_t)tmp;
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            /* Floyd: j runs over range-k .. range-1 */
+            uint32_t j = u->range - u->k + u->drawn + (uint32_t)i;
+            uint32_t t = rng_below(u->rng, j + 1);
+            if (!sampler_set_insert(u, t)) {
+                t = j;
+                sampler_set_insert(u, t);
+            }
+            out[i] = (int32_t)t;
+        }
+    }
+    u->drawn += (uint32_t)n;
+    return n;
+}
+
+static void sampler_free(unique_sampler_t *u) {
+    free(u->perm);
+    free(u->set);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Thread placement                                                           */
+/* ------------------------------------------------------------------------- */
+
+/* CPUs this process may run on, grouped by NUMA node. Without -N (or on a
+   single-node machine) everything sits in node 0. */
+typedef struct {
+    int nnodes;
+    int *node_cpus[CPU_SETSIZE];
+    int node_ncpus[CPU_SETSIZE];
+} cpu_topology_t;
+
+static cpu_topology_t topo;
+
+/* Parse a sysfs cpulist such as "0-3,8,10-11" into set */
+static void parse_cpulist(const char *s, cpu_set_t *set) {
+    while (*s) {
+        char *end;
+        long a = strtol(s, &end, 10), b = a;
+        if (end == s) break;
+        if (*end == '-') b = strtol(end + 1, &end, 10);
+        for (long c = a; c <= b && c < CPU_SETSIZE; ++c) CPU_SET((int)c, set);
+        s = (*end == ',') ? end + 1 : end;
+        if (*s == '\n') break;
+    }
+}
+
+static void topo_add_node(const cpu_set_t *node, const cpu_set_t *allowed) {
+    int n = 0;
+    int *list = malloc(sizeof(int) * CPU_SETSIZE);
+    if (!list) return;
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, node) && CPU_ISSET(c, allowed)) list[n++] = c;
+    if (n == 0) {
+        free(list);
+        return;
+    }
+    topo.node_cpus[topo.nnodes] = list;
+    topo.node_ncpus[topo.nnodes] = n;
+    topo.nnodes++;
+}
+
+static void topo_init(int numa) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        for (int c = 0; c < sysconf(_SC_NPROCESSORS_ONLN) && c < CPU_SETSIZE; ++c) CPU_SET(c, &allowed);
+    }
+
+    if (numa) {
+        DIR *d = opendir("/sys/devices/system/node");
+        struct dirent *e;
+        while (d && (e = readdir(d)) != NULL) {
+            int id;
+            if (sscanf(e->d_name, "node%d", &id) != 1) continue;
+            char path[PATH_MAX], buf[4096];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", e->d_name);
+            FILE *f = fopen(path, "r");
+            if (!f) continue;
+            if (fgets(buf, sizeof(buf), f)) {
+                cpu_set_t node;
+                CPU_ZERO(&node);
+                parse_cpulist(buf, &node);
+                topo_add_node(&node, &allowed);
+            }
+            fclose(f);
+        }
+        if (d) closedir(d);
+    }
+    if (topo.nnodes == 0) topo_add_node(&allowed, &allowed);
+}
+
+static void topo_free(void) {
+    for (int i = 0; i < topo.nnodes; ++i) free(topo.node_cpus[i]);
+    topo.nnodes = 0;
+}
+
+/* Confine a consumer process to its share of the CPUs: the node-ordered CPU
+   list is cut into cfg.shards consecutive slices, so a shard stays on one
+   node where it can. With more shards than CPUs, neighbours share one.
+   Threads started afterwards inherit the mask, and -a placement is redone
+   inside it. */
+static void shard_confine(int shard) {
+    int all[CPU_SETSIZE], n = 0;
+    for (int i = 0; i < topo.nnodes; ++i)
+        for (int j = 0; j < topo.node_ncpus[i]; ++j) all[n++] = topo.node_cpus[i][j];
+    if (n == 0) return;
+    int lo = (int)((long long)shard * n / cfg.shards);
+    int hi = (int)((long long)(shard + 1) * n / cfg.shards);
+    if (hi == lo) hi = lo + 1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = lo; i < hi; ++i) CPU_SET(all[i], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "Shard %d: sched_setaffinity failed: %s\n", shard, strerror(errno));
+        return;
+    }
+    topo_free();
+    topo_init(cfg.numa);
+}
+
+/* Pin the calling thread. Thread `idx` of `count` in its role is placed on node
+   idx * nnodes / count, so each node hosts a proportional share of producers
+   and of consumers and most traffic stays node-local. Within a node, roles
+   start at different offsets so producers and consumers don't stack up. */
+static void pin_self(int idx, int count, int role_offset) {
+    if (!cfg.pin || topo.nnodes == 0) return;
+    int node = (int)((long long)idx * topo.nnodes / count);
+    int *cpus = topo.node_cpus[node];
+    int ncpus = topo.node_ncpus[node];
+    int cpu = cpus[(idx + role_offset) % ncpus];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        pthread_mutex_lock(&print_mutex);
+        fprintf(stderr, "pin to cpu %d failed: %s\n", cpu, strerror(rc));
+        pthread_mutex_unlock(&print_mutex);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Shards                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/* Per-shard totals in a MAP_SHARED array mapped before fork(). Producers add
+   up what they route to each shard; each consumer process fills in the rest
+   of its entry before it exits, and the parent reads them all after
+   waitpid(). */
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic long long sent;
+    long long count;
+    long long sum;
+    int consumers;
+    double elapsed;
+    uint64_t lat_samples;
+    uint64_t lat_total_ns;
+    uint64_t lat_max_ns;
+    uint64_t lat_hist[LAT_BUCKETS];
+} shard_result_t;
+
+static shard_result_t *shard_results;
+
+/* Shard for a value under -R hash: a Fibonacci hash spreads neighbouring
+   values, and the multiply-shift maps it onto [0, shards) without a divide. */
+static inline int shard_of(int32_t value) {
+    uint32_t h = (uint32_t)value * 0x9e3779b1u;
+    return (int)(((uint64_t)h * (uint32_t)cfg.shards) >> 32);
+}
+
+/* Timestamp the first item and send the batch to shard s; returns 0 or -1 */
+static int send_batch(int s, item_t *batch, size_t n) {
+    batch[0].flags = ITEM_STAMPED;
+    batch[0].stamp_ns = now_ns();
+    if (transports[s].send(&transports[s], batch, n) != 0) return -1;
+    atomic_fetch_add_explicit(&shard_results[s].sent, (long long)n, memory_order_relaxed);
+    return 0;
+}
+
 /* Producer thread argument */
 typedef struct {
     int tid;
-    unsigned int seed;
+    uint64_t seed;
+    const rng_kind_t *gen;
+    thread_counter_t *progress;
 } producer_arg_t;
 
 void *producer_thread(void *arg) {
     producer_arg_t *parg = (producer_arg_t*)arg;
     int tid = parg->tid;
-    unsigned int seed = parg->seed;
+    int per_producer = cfg.per_producer;
 
-    /* Generate PER_PRODUCER unique numbers within this thread.
-       We'll use a simple local boolean array of size RAND_MAX_VAL+1 to ensure uniqueness. */
-    int chosen_count = 0;
-    int *values = malloc(sizeof(int) * PER_PRODUCER);
-    if (!values) {
-        pthread_mutex_lock(&print_mutex);
-        fprintf(stderr, "Producer %d: malloc failed\n", tid);
-        pthread_mutex_unlock(&print_mutex);
-        return NULL;
-    }
+    trace_thread_name("producer %d", tid);
+    pin_self(tid, cfg.producers, 0);
 
-    /* If PER_PRODUCER > RAND_MAX_VAL+1 we'd have trouble; here PER_PRODUCER <= 500 and RAND_MAX_VAL=1000 */
-    int available = RAND_MAX_VAL + 1;
-    char *seen = calloc(available, 1);
-    if (!seen) {
+    /* Draw per_producer unique numbers from [0, max_val] a batch at a time.
+       main() rejects per_producer > max_val+1, which could never finish. */
+    rng_t rng;
+    rng_init(&rng, parg->gen, parg->seed);
+    unique_sampler_t sampler;
+    if (sampler_init(&sampler, &rng, (uint32_t)cfg.max_val + 1, (uint32_t)per_producer) < 0) {
         pthread_mutex_lock(&print_mutex);
-        fprintf(stderr, "Producer %d: calloc failed\n", tid);
+        fprintf(stderr, "Producer %d: sampler allocation failed\n", tid);
         pthread_mutex_unlock(&print_mutex);
-        free(values);
+        sampler_free(&sampler);
         return NULL;
     }
 
-    while (chosen_count < PER_PRODUCER) {
-        int r = rand_r(&seed) % (RAND_MAX_VAL + 1);
-        if (!seen[r]) {
-            seen[r] = 1;
-            values[chosen_count++] = r;
-        }
-    }
-
-    /* Write values to the pipe; protect the actual write operation with a mutex to avoid interleaved calls */
-    for (int i = 0; i < PER_PRODUCER; ++i) {
-        int x = values[i];
-        /* lock write to ensure atomicity of our write calls and consistent progress prints */
-        pthread_mutex_lock(&write_mutex);
-        if (write_full(pipefd[1], &x, sizeof(int)) != sizeof(int)) {
+    /* Send values in batches; the first item of each batch is timestamped.
+       Round-robin sends each drawn batch whole to the next shard, starting
+       from a different shard in every producer. Hash routing sorts values
+       into one pending batch per shard and sends a batch when it fills, so
+       a value always lands on the same shard. */
+    int32_t values[BATCH_ITEMS];
+    item_t batch[BATCH_ITEMS];
+    int hashed = cfg.route == ROUTE_HASH && cfg.shards > 1;
+    item_t (*pending)[BATCH_ITEMS] = NULL;
+    size_t *fill = NULL;
+    if (hashed) {
+        pending = malloc(sizeof(*pending) * (size_t)cfg.shards);
+        fill = calloc((size_t)cfg.shards, sizeof(size_t));
+        if (!pending || !fill) {
             pthread_mutex_lock(&print_mutex);
-            fprintf(stderr, "Producer %d: write error: %s\n", tid, strerror(errno));
+            fprintf(stderr, "Producer %d: batch allocation failed\n", tid);
             pthread_mutex_unlock(&print_mutex);
-            pthread_mutex_unlock(&write_mutex);
-            break;
+            free(pending);
+            free(fill);
+            sampler_free(&sampler);
+            return NULL;
         }
-        pthread_mutex_unlock(&write_mutex);
-
-        /* Progress indicator: every 50 writes print a small update (protected by print_mutex) */
-        if ((i + 1) % 50 == 0 || i == PER_PRODUCER - 1) {
-            pthread_mutex_lock(&print_mutex);
-            printf("Producer %d: wrote %d/%d numbers\n", tid, i + 1, PER_PRODUCER);
-            fflush(stdout);
-            pthread_mutex_unlock(&print_mutex);
+    }
+    int next = tid % cfg.shards;
+    int failed = 0;
+    size_t n;
+    TRACE_BEGIN("produce");
+    while (!failed && (n = sampler_fill(&sampler, values, BATCH_ITEMS)) > 0) {
+        if (!hashed) {
+            for (size_t k = 0; k < n; ++k) {
+                batch[k].value = values[k];
+                batch[k].flags = 0;
+                batch[k].stamp_ns = 0;
+            }
+            failed = send_batch(next, batch, n) != 0;
+            next = next + 1 == cfg.shards ? 0 : next + 1;
+        } else {
+            for (size_t k = 0; k < n && !failed; ++k) {
+                int s = shard_of(values[k]);
+                item_t *it = &pending[s][fill[s]++];
+                it->value = values[k];
+                it->flags = 0;
+                it->stamp_ns = 0;
+                if (fill[s] == BATCH_ITEMS) {
+                    failed = send_batch(s, pending[s], BATCH_ITEMS) != 0;
+                    fill[s] = 0;
+                }
+            }
         }
+
+        /* Progress is published for the reporter thread; no locking here */
+        if (!failed) counter_add(parg->progress, n);
     }
+    for (int s = 0; hashed && s < cfg.shards && !failed; ++s)
+        if (fill[s] > 0) failed = send_batch(s, pending[s], fill[s]) != 0;
+    TRACE_END("produce");
+    if (failed) {
+        pthread_mutex_lock(&print_mutex);
+        fprintf(stderr, "Producer %d: write error: %s\n", tid, strerror(errno));
+        pthread_mutex_unlock(&print_mutex);
+    }
+    free(pending);
+    free(fill);
 
-    pthread_mutex_lock(&print_mutex);
-    printf("Producer %d finished (thread id %lu)\n", tid, (unsigned long)pthread_self());
-    fflush(stdout);
-    pthread_mutex_unlock(&print_mutex);
+    if (!cfg.quiet) {
+        pthread_mutex_lock(&print_mutex);
+        printf("Producer %d finished (thread id %lu)\n", tid, (unsigned long)pthread_self());
+        pthread_mutex_unlock(&print_mutex);
+    }
 
-    free(values);
-    free(seen);
+    sampler_free(&sampler);
     return NULL;
 }
 
@@ -141,153 +1020,414 @@ void *producer_thread(void *arg) {
 typedef struct {
     int cid;
     long long sum;
+    long long count;
+    uint64_t lat_samples;
+    uint64_t lat_total_ns;
+    uint64_t lat_max_ns;
+    uint64_t lat_hist[LAT_BUCKETS]; /* bucket b counts latencies in [2^b, 2^(b+1)) ns */
 } consumer_result_t;
 
 typedef struct {
     int cid;
+    int shard;
+    int local, nlocal;    /* index among, and number of, this shard's consumers */
+    thread_counter_t *progress;
 } consumer_arg_t;
 
-/* We need a shared read descriptor in the child; mutex is not strictly necessary because read operations on a pipe are already serialized,
-   but we'll not use additional locks for reads because each read is for sizeof(int) and is atomic in practice; however,
-   to be safe with partial reads across threads we implement read_full. */
+static void record_latency(consumer_result_t *res, uint64_t ns) {
+    int b = ns ? 63 - __builtin_clzll(ns) : 0;
+    res->lat_hist[b]++;
+    res->lat_samples++;
+    res->lat_total_ns += ns;
+    if (ns > res->lat_max_ns) res->lat_max_ns = ns;
+}
+
+/* Returns the upper bound of the histogram bucket holding quantile q. */
+static uint64_t latency_quantile(const uint64_t *hist, uint64_t samples, double q) {
+    uint64_t target = (uint64_t)(q * (double)samples);
+    uint64_t seen = 0;
+    for (int b = 0; b < LAT_BUCKETS; ++b) {
+        seen += hist[b];
+        if (seen > target) return b >= 63 ? UINT64_MAX : (2ull << b);
+    }
+    return 0;
+}
+
+/* Consumers drain their shard's transport until EOF. Whoever is free takes
+   the next batch, so faster consumers naturally take a larger share of the work.
+   Reads go through the transport; the pipe version relies on whole-item reads
+   (see pipe_recv) so no extra lock is needed between consumers. */
 void *consumer_thread(void *arg) {
     consumer_arg_t *carg = (consumer_arg_t*)arg;
     int cid = carg->cid;
-    long long local_sum = 0;
 
-    for (int i = 0; i < PER_CONSUMER; ++i) {
-        int x;
-        ssize_t r = read_full(pipefd[0], &x, sizeof(int));
-        if (r != sizeof(int)) {
-            pthread_mutex_lock(&print_mutex);
-            fprintf(stderr, "Consumer %d: read error or premature EOF (r=%zd)\n", cid, r);
-            pthread_mutex_unlock(&print_mutex);
-            pthread_exit((void*)NULL);
-        }
-        local_sum += x;
+    consumer_result_t *cres = calloc(1, sizeof(consumer_result_t));
+    if (!cres) pthread_exit((void*)NULL);
+    cres->cid = cid;
+
+    trace_thread_name("consumer %d", cid);
+    pin_self(carg->local, carg->nlocal, cfg.producers);
 
-        /*small progress prints — print every 50 reads */
-        if ((i + 1) % 50 == 0 || i == PER_CONSUMER - 1) {
+    transport_t *t = &transports[carg->shard];
+    item_t batch[BATCH_ITEMS];
+    TRACE_BEGIN("consume");
+    for (;;) {
+        ssize_t r = t->recv(t, batch, BATCH_ITEMS);
+        if (r == 0) break; /* EOF: producers are done and the transport is drained */
+        if (r < 0) {
             pthread_mutex_lock(&print_mutex);
-            printf("Consumer %d: read %d/%d numbers\n", cid, i + 1, PER_CONSUMER);
-            fflush(stdout);
+            fprintf(stderr, "Consumer %d: read error: %s\n", cid, strerror(errno));
             pthread_mutex_unlock(&print_mutex);
+            break;
+        }
+        uint64_t t = 0;
+        for (ssize_t k = 0; k < r; ++k) {
+            cres->sum += batch[k].value;
+            if (batch[k].flags & ITEM_STAMPED) {
+                if (!t) t = now_ns();
+                record_latency(cres, t > batch[k].stamp_ns ? t - batch[k].stamp_ns : 0);
+            }
         }
-    }
 
-    consumer_result_t *cres = malloc(sizeof(consumer_result_t));
-    if (!cres) pthread_exit((void*)NULL);
-    cres->cid = cid;
-    cres->sum = local_sum;
+        cres->count += r;
+        counter_add(carg->progress, (uint64_t)r);
+    }
+    TRACE_END("consume");
 
-    pthread_mutex_lock(&print_mutex);
-    printf("Consumer %d finished (thread id %lu) sum=%lld\n", cid, (unsigned long)pthread_self(), local_sum);
-    fflush(stdout);
-    pthread_mutex_unlock(&print_mutex);
+    if (!cfg.quiet) {
+        pthread_mutex_lock(&print_mutex);
+        printf("Consumer %d finished (thread id %lu) count=%lld sum=%lld\n",
+               cid, (unsigned long)pthread_self(), cres->count, cres->sum);
+        pthread_mutex_unlock(&print_mutex);
+    }
 
     return (void*)cres;
 }
 
-int main(int argc, char *argv[]) {
-    /* Create pipe */
-    if (pipe(pipefd) < 0) {
-        perror("pipe");
-        exit(EXIT_FAILURE);
+/* Print the summary over shards [0, n): the average of the consumers' sums,
+   throughput over the slowest shard's time, and the merged latency histogram. */
+static void print_totals(const char *who, const shard_result_t *res, int n) {
+    uint64_t hist[LAT_BUCKETS] = {0};
+    uint64_t lat_samples = 0, lat_total = 0, lat_max = 0;
+    long double total = 0.0L;
+    long long items_read = 0;
+    int consumers = 0;
+    double elapsed = 0;
+    for (int s = 0; s < n; ++s) {
+        total += (long double)res[s].sum;
+        items_read += res[s].count;
+        consumers += res[s].consumers;
+        if (res[s].elapsed > elapsed) elapsed = res[s].elapsed;
+        for (int b = 0; b < LAT_BUCKETS; ++b) hist[b] += res[s].lat_hist[b];
+        lat_samples += res[s].lat_samples;
+        lat_total += res[s].lat_total_ns;
+        if (res[s].lat_max_ns > lat_max) lat_max = res[s].lat_max_ns;
     }
+    long double average = consumers ? total / (long double)consumers : 0.0L;
+    double items = (double)items_read;
+    char label[64];
+    if (n > 1) snprintf(label, sizeof(label), "%d-shard %s", n, transports[0].name);
+    else snprintf(label, sizeof(label), "%s", transports[0].name);
 
-    /* Fork child */
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("fork");
-        exit(EXIT_FAILURE);
+    pthread_mutex_lock(&print_mutex);
+    printf("%s: Average of consumer sums = %.6Lf\n", who, average);
+    printf("%s: %s transport moved %.0f items in %.6f s (%.4f x 1e8 items/s)\n",
+           who, label, items, elapsed, elapsed > 0 ? items / elapsed / 1e8 : 0.0);
+    if (lat_samples) {
+        printf("%s: latency ns: samples=%llu avg=%llu p50<=%llu p99<=%llu max=%llu\n",
+               who, (unsigned long long)lat_samples,
+               (unsigned long long)(lat_total / lat_samples),
+               (unsigned long long)latency_quantile(hist, lat_samples, 0.50),
+               (unsigned long long)latency_quantile(hist, lat_samples, 0.99),
+               (unsigned long long)lat_max);
     }
+    fflush(stdout);
+    pthread_mutex_unlock(&print_mutex);
+}
 
-    if (pid > 0) {
-        /* Parent process: PRODUCERS */
-        /* Parent will write to pipefd[1], close read end */
-        close(pipefd[0]); /* close read end in parent */
-
-        pthread_t producers[NUM_PRODUCERS];
-        producer_arg_t pargs[NUM_PRODUCERS];
+/* Body of consumer process `shard`: runs its share of the consumer threads
+   on its own transport and CPUs, and records the totals in shard_results.
+   Returns the exit status: 0 if every item routed to the shard was read. */
+static int consumer_process(int shard) {
+    /* Keep only the read side of our own transport */
+    for (int s = 0; s < cfg.shards; ++s)
+        if (s != shard) transport_release(&transports[s]);
+    transport_t *t = &transports[shard];
+    t->consumer_side(t);
+    if (cfg.shards > 1) shard_confine(shard);
 
-        /* Seed the random generator differently for each thread */
-        unsigned int global_seed = (unsigned int)time(NULL) ^ (unsigned int)getpid();
+    int first = (int)((long long)shard * cfg.consumers / cfg.shards);
+    int nlocal = (int)((long long)(shard + 1) * cfg.consumers / cfg.shards) - first;
+    pthread_t *consumers = calloc((size_t)nlocal, sizeof(pthread_t));
+    consumer_arg_t *cargs = calloc((size_t)nlocal, sizeof(consumer_arg_t));
+    char *started = calloc((size_t)nlocal, 1);
+    thread_counter_t *progress = counters_alloc(nlocal);
+    if (!consumers || !cargs || !started || !progress) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    trace_thread_name("shard %d main", shard);
+    uint64_t t_start = now_ns();
+    char role[32];
+    if (cfg.shards > 1) snprintf(role, sizeof(role), "shard %d consumers", shard);
+    else snprintf(role, sizeof(role), "consumers");
+    reporter_t rep;
+    reporter_start(&rep, role, progress, nlocal, t, 1);
 
-        for (int i = 0; i < NUM_PRODUCERS; ++i) {
-            pargs[i].tid = i;
-            pargs[i].seed = global_seed ^ (i * 101);
-            if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
-                pthread_mutex_lock(&print_mutex);
-                fprintf(stderr, "Failed to create producer %d\n", i);
-                pthread_mutex_unlock(&print_mutex);
-            }
+    for (int i = 0; i < nlocal; ++i) {
+        cargs[i].cid = first + i;
+        cargs[i].shard = shard;
+        cargs[i].local = i;
+        cargs[i].nlocal = nlocal;
+        cargs[i].progress = &progress[i];
+        if (pthread_create(&consumers[i], NULL, consumer_thread, &cargs[i]) != 0) {
+            pthread_mutex_lock(&print_mutex);
+            fprintf(stderr, "Failed to create consumer %d\n", first + i);
+            pthread_mutex_unlock(&print_mutex);
+        } else {
+            started[i] = 1;
         }
+    }
 
-        /* Join producers */
-        for (int i = 0; i < NUM_PRODUCERS; ++i) {
-            pthread_join(producers[i], NULL);
+    shard_result_t *out = &shard_results[shard];
+    out->consumers = nlocal;
+    for (int i = 0; i < nlocal; ++i) {
+        void *res = NULL;
+        if (started[i]) pthread_join(consumers[i], &res);
+        if (res) {
+            consumer_result_t *cres = (consumer_result_t*)res;
+            out->sum += cres->sum;
+            out->count += cres->count;
+            for (int b = 0; b < LAT_BUCKETS; ++b) out->lat_hist[b] += cres->lat_hist[b];
+            out->lat_samples += cres->lat_samples;
+            out->lat_total_ns += cres->lat_total_ns;
+            if (cres->lat_max_ns > out->lat_max_ns) out->lat_max_ns = cres->lat_max_ns;
+            free(cres);
         }
+    }
+    out->elapsed = (double)(now_ns() - t_start) / 1e9;
+    reporter_stop(&rep);
 
-        /* All producers finished */
+    /* The producers are done by the time the transport reports EOF, so
+       `sent` is final here */
+    long long expected = atomic_load(&out->sent);
+    if (out->count != expected) {
         pthread_mutex_lock(&print_mutex);
-        printf("Parent: all producers finished, closing write end of pipe.\n");
-        fflush(stdout);
+        fprintf(stderr, "Shard %d: expected %lld items but consumers read %lld\n", shard, expected, out->count);
         pthread_mutex_unlock(&print_mutex);
+    }
+    /* With a single consumer process it reports for itself, as it always has */
+    if (cfg.shards == 1) print_totals("Child", shard_results, 1);
 
-        close(pipefd[1]); /* signal EOF to child by closing write end */
+    free(consumers);
+    free(cargs);
+    free(started);
+    free(progress);
+    close_fd(&t->fd[0]);
+    return out->count == expected ? 0 : 1;
+}
 
-        /* Wait for child to finish */
-        int status;
-        waitpid(pid, &status, 0);
-        pthread_mutex_lock(&print_mutex);
-        printf("Parent: child finished with status %d. Exiting.\n", status);
-        fflush(stdout);
-        pthread_mutex_unlock(&print_mutex);
-        return 0;
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-t pipe|shm] [-p producers] [-c consumers] [-n per-producer]\n"
+                    "          [-r max-value] [-g xoshiro|pcg|rand_r] [-a] [-N] [-q] [-i report-ms]\n"
+                    "          [-s shards] [-R rr|hash]\n"
+                    "  -a  pin threads to cores    -N  NUMA-aware placement (implies -a)\n"
+                    "  -q  quiet: no progress reports, only the final summary\n"
+                    "  -s  consumer processes, each with its own transport and CPUs;\n"
+                    "      the consumers are split between them\n"
+                    "  -R  route batches to shards in turn (rr) or by value hash\n"
+                    "  TRACE_FILE=out.json writes a Chrome trace of every process (see trace.h)\n", prog);
+}
 
-    } else {
-        /* Child process: CONSUMERS */
-        /* Child will read from pipefd[0], close write end */
-        close(pipefd[1]); /* close write end in child */
-
-        pthread_t consumers[NUM_CONSUMERS];
-        consumer_arg_t cargs[NUM_CONSUMERS];
-
-        for (int i = 0; i < NUM_CONSUMERS; ++i) {
-            cargs[i].cid = i;
-            if (pthread_create(&consumers[i], NULL, consumer_thread, &cargs[i]) != 0) {
-                pthread_mutex_lock(&print_mutex);
-                fprintf(stderr, "Failed to create consumer %d\n", i);
-                pthread_mutex_unlock(&print_mutex);
+/* Parse a positive int option; returns -1 if it isn't one */
+static int parse_positive(const char *s) {
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (errno || *end || v <= 0 || v > INT_MAX) return -1;
+    return (int)v;
+}
+
+int main(int argc, char *argv[]) {
+    const char *transport_name = "pipe";
+    int opt;
+    while ((opt = getopt(argc, argv, "t:p:c:n:r:aNqi:g:s:R:")) != -1) {
+        switch (opt) {
+        case 't': transport_name = optarg; break;
+        case 'p': cfg.producers = parse_positive(optarg); break;
+        case 'c': cfg.consumers = parse_positive(optarg); break;
+        case 'n': cfg.per_producer = parse_positive(optarg); break;
+        case 'r': cfg.max_val = parse_positive(optarg); break;
+        case 'a': cfg.pin = 1; break;
+        case 'N': cfg.pin = 1; cfg.numa = 1; break;
+        case 'q': cfg.quiet = 1; break;
+        case 'g': cfg.gen = optarg; break;
+        case 'i': cfg.report_ms = parse_positive(optarg); break;
+        case 's': cfg.shards = parse_positive(optarg); break;
+        case 'R':
+            if (strcmp(optarg, "rr") == 0) cfg.route = ROUTE_RR;
+            else if (strcmp(optarg, "hash") == 0) cfg.route = ROUTE_HASH;
+            else {
+                fprintf(stderr, "Unknown routing '%s' (expected rr or hash)\n", optarg);
+                exit(EXIT_FAILURE);
             }
+            break;
+        default: usage(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+    if (cfg.producers < 0 || cfg.consumers < 0 || cfg.per_producer < 0 || cfg.max_val < 0 ||
+        cfg.report_ms < 0 || cfg.shards < 0) {
+        fprintf(stderr, "Counts and ranges must be positive integers\n");
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if ((long long)cfg.per_producer > (long long)cfg.max_val + 1) {
+        fprintf(stderr, "Each producer needs %d unique values but [0, %d] only holds %lld\n",
+                cfg.per_producer, cfg.max_val, (long long)cfg.max_val + 1);
+        exit(EXIT_FAILURE);
+    }
+    if (cfg.consumers < cfg.shards) {
+        fprintf(stderr, "%d shards need at least as many consumers, got %d\n", cfg.shards, cfg.consumers);
+        exit(EXIT_FAILURE);
+    }
+    const rng_kind_t *gen = rng_find(cfg.gen);
+    if (!gen) {
+        fprintf(stderr, "Unknown generator '%s' (expected xoshiro, pcg or rand_r)\n", cfg.gen);
+        exit(EXIT_FAILURE);
+    }
+    /* Shards are confined to slices of the topology even without -a */
+    if (cfg.pin || cfg.shards > 1) topo_init(cfg.numa);
+    if (trace_init("hw4 producers")) trace_thread_name("main");
+
+    /* Pipes and rings must exist before fork so every process shares them */
+    transports = calloc((size_t)cfg.shards, sizeof(transport_t));
+    shard_results = mmap(NULL, sizeof(shard_result_t) * (size_t)cfg.shards, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    pid_t *pids = calloc((size_t)cfg.shards, sizeof(pid_t));
+    if (!transports || !pids || shard_results == MAP_FAILED) {
+        perror("shard setup");
+        exit(EXIT_FAILURE);
+    }
+    for (int s = 0; s < cfg.shards; ++s) {
+        if (transport_init(&transports[s], transport_name) < 0) {
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
         }
+    }
 
-        long long sums[NUM_CONSUMERS];
-        for (int i = 0; i < NUM_CONSUMERS; ++i) {
-            void *res = NULL;
-            pthread_join(consumers[i], &res);
-            if (res) {
-                consumer_result_t *cres = (consumer_result_t*)res;
-                sums[i] = cres->sum;
-                free(cres);
-            } else {
-                sums[i] = 0;
-            }
+    /* Fork one consumer process per shard */
+    int forked = 0;
+    for (; forked < cfg.shards; ++forked) {
+        TRACE_INSTANT("fork shard");
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            break;
         }
+        if (pid == 0) {
+            /* Child process: CONSUMERS. _exit skips atexit, so dump here. */
+            char name[32];
+            snprintf(name, sizeof(name), "hw4 shard %d consumers", forked);
+            trace_fork_child(name);
+            int status = consumer_process(forked);
+            trace_dump();
+            _exit(status);
+        }
+        pids[forked] = pid;
+    }
 
-        /* Compute average of the sums (average per consumer) */
-        long double total = 0.0L;
-        for (int i = 0; i < NUM_CONSUMERS; ++i) total += (long double)sums[i];
-        long double average = total / (long double)NUM_CONSUMERS;
+    /* Parent process: PRODUCERS */
+    /* Parent only writes; drop the ends it does not need */
+    for (int s = 0; s < cfg.shards; ++s) transports[s].producer_side(&transports[s]);
+    if (forked < cfg.shards) {
+        /* let the children that did start see EOF, then give up */
+        for (int s = 0; s < cfg.shards; ++s) transports[s].close_write(&transports[s]);
+        for (int s = 0; s < forked; ++s) waitpid(pids[s], NULL, 0);
+        exit(EXIT_FAILURE);
+    }
 
-        /* Print the average to stdout. Per assignment, the student should redirect stdout to a file if desired. */
+    pthread_t *producers = calloc((size_t)cfg.producers, sizeof(pthread_t));
+    producer_arg_t *pargs = calloc((size_t)cfg.producers, sizeof(producer_arg_t));
+    char *started = calloc((size_t)cfg.producers, 1);
+    thread_counter_t *progress = counters_alloc(cfg.producers);
+    if (!producers || !pargs || !started || !progress) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    reporter_t rep;
+    reporter_start(&rep, "producers", progress, cfg.producers, transports, cfg.shards);
+
+    /* Seed the random generator differently for each thread */
+    uint64_t global_seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+
+    for (int i = 0; i < cfg.producers; ++i) {
+        pargs[i].tid = i;
+        pargs[i].seed = global_seed ^ ((uint64_t)i * 101);
+        pargs[i].gen = gen;
+        pargs[i].progress = &progress[i];
+        if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
+            pthread_mutex_lock(&print_mutex);
+            fprintf(stderr, "Failed to create producer %d\n", i);
+            pthread_mutex_unlock(&print_mutex);
+        } else {
+            started[i] = 1;
+        }
+    }
+
+    /* Join producers */
+    for (int i = 0; i < cfg.producers; ++i) {
+        if (started[i]) pthread_join(producers[i], NULL);
+    }
+    reporter_stop(&rep);
+    free(producers);
+    free(pargs);
+    free(started);
+    free(progress);
+
+    /* All producers finished */
+    pthread_mutex_lock(&print_mutex);
+    if (cfg.shards > 1)
+        printf("Parent: all producers finished, closing %d %s transports.\n", cfg.shards, transports[0].name);
+    else
+        printf("Parent: all producers finished, closing %s transport.\n", transports[0].name);
+    fflush(stdout);
+    pthread_mutex_unlock(&print_mutex);
+
+    /* signal EOF to the children */
+    for (int s = 0; s < cfg.shards; ++s) transports[s].close_write(&transports[s]);
+
+    /* Wait for the children to finish */
+    int failed = 0;
+    for (int s = 0; s < cfg.shards; ++s) {
+        int status;
+        TRACE_BEGIN("wait child");
+        waitpid(pids[s], &status, 0);
+        TRACE_END("wait child");
+        TRACE_INSTANT("child exit");
+        if (status != 0) failed = 1;
         pthread_mutex_lock(&print_mutex);
-        printf("Child: Average of consumer sums = %.6Lf\n", average);
+        if (cfg.shards > 1) printf("Parent: shard %d child finished with status %d.\n", s, status);
+        else printf("Parent: child finished with status %d. Exiting.\n", status);
         fflush(stdout);
         pthread_mutex_unlock(&print_mutex);
+    }
 
-        /* close read end and exit */
-        close(pipefd[0]);
-        _exit(0);
+    /* Every child has exited, so its shard_results entry is complete */
+    long long expected = (long long)cfg.producers * cfg.per_producer, items_read = 0;
+    for (int s = 0; s < cfg.shards; ++s) items_read += shard_results[s].count;
+    if (cfg.shards > 1) {
+        for (int s = 0; s < cfg.shards; ++s) {
+            const shard_result_t *r = &shard_results[s];
+            printf("Parent: shard %d: %d consumers read %lld items, sum = %lld, average of consumer sums = %.6Lf\n",
+                   s, r->consumers, r->count, r->sum,
+                   r->consumers ? (long double)r->sum / r->consumers : 0.0L);
+        }
+        print_totals("Parent", shard_results, cfg.shards);
+    }
+    if (items_read != expected) {
+        fprintf(stderr, "Parent: expected %lld items but consumers read %lld\n", expected, items_read);
+        failed = 1;
     }
+    if (cfg.shards > 1) printf("Parent: all shards finished. Exiting.\n");
+    return failed ? EXIT_FAILURE : 0;
 }
@@ -3,79 +3,371 @@ CS 332/532 – Lab 3
 Homework: Insertion sort with strings using dynamic memory allocation.
 
 How to compile (on CS Linux systems because im on windows):
-    gcc -o hwins hwins.c
+    gcc -O2 -o hwins hwins.c strsort.c strfreq.c intio.c parallel.c trace.c -lpthread -lm
 
 How to run:
-    ./hwins
+    ./hwins                       read a count and that many strings, print them sorted
+    ./hwins -i <file>             read the count and strings from file instead of stdin
+    ./hwins -s                    only print the sorted strings, one per line
+    ./hwins -t <threads>          threads for sorting (default: all CPUs)
+    ./hwins -c [-k <k>]           count: total, distinct and the k most frequent (default 10)
+    ./hwins -u                    every distinct string with its count, in sorted order
+    ./hwins -A [-M <MB>] [-k <k>] approximate -c in bounded memory, streaming the input
+    In -c, -u and -A modes every whitespace-separated token is counted
+    (there is no leading count).
 
 Tested on: moat.cs.uab.edu (CS Linux systems)
+
+Strings are stored back to back in one arena (strsort.c) and indexed by
+offset and length, so there is no malloc per string and no length limit.
+When stdin is not a terminal the whole input is loaded at once and used
+as the arena directly. Sorting is a multikey quicksort on 8-byte prefixes,
+run over the first-two-byte buckets in parallel for large inputs.
+Counting (strfreq.c) uses an open-addressing table keyed by each string's
+hash, or for -A a Count-Min sketch, HyperLogLog and heavy-hitter heap of
+fixed size, so input larger than memory can be streamed through.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "strsort.h"
+#include "strfreq.h"
+#include "intio.h"
+
+#define TOKEN_BATCH 4096        // refs split per batch in count mode
+#define STREAM_CHUNK (1 << 20)  // read size for -A
 
 // Function declarations
-void readStrings(char **arr, int n);
-void displayStrings(char **arr, int n);
-void sortStrings(char **arr, int n);
+int readStrings(str_arena_t *arena, str_ref_t *arr, int n);
+int displayStrings(const char *label, const str_arena_t *arena, const str_ref_t *arr, int n, int lines);
+int sortStrings(const str_arena_t *arena, str_ref_t *arr, int n, par_pool_t *pool);
 
 // Function definitions
-void readStrings(char **arr, int n) {
-    char buffer[100]; // temp storage
+
+// Interactive: prompt for each string and append it to the arena
+int readStrings(str_arena_t *arena, str_ref_t *arr, int n) {
+    char *buffer = NULL; // temp storage, grows with the longest string
+    size_t cap = 0;
     for (int i = 0; i < n; i++) {
         printf("Enter string %d: ", i + 1);
-        scanf("%99s", buffer); // avoid overflow
-        arr[i] = (char*) malloc((strlen(buffer) + 1) * sizeof(char));
-        strcpy(arr[i], buffer);
+        fflush(stdout);
+        int c;
+        size_t len = 0;
+        while ((c = getchar()) != EOF && c <= ' ') ;
+        while (c != EOF && c > ' ') {
+            if (len == cap) {
+                cap = cap ? cap * 2 : 128;
+                char *bigger = realloc(buffer, cap);
+                if (!bigger) {
+                    free(buffer);
+                    return -1;
+                }
+                buffer = bigger;
+            }
+            buffer[len++] = (char)c;
+            c = getchar();
+        }
+        arr[i] = str_arena_add(arena, buffer, len);
+        if (arr[i].len == UINT32_MAX) {
+            free(buffer);
+            return -1;
+        }
     }
+    free(buffer);
+    return 0;
 }
 
-void displayStrings(char **arr, int n) {
-    printf("[");
-    for (int i = 0; i < n - 1; i++) {
-        printf("%s, ", arr[i]);
+// Build the whole line (or lines) in one buffer and write it once
+int displayStrings(const char *label, const str_arena_t *arena, const str_ref_t *arr, int n, int lines) {
+    size_t size = strlen(label) + 4;
+    for (int i = 0; i < n; i++) size += arr[i].len + 2;
+    char *out = malloc(size);
+    if (!out) return -1;
+
+    char *p = out;
+    memcpy(p, label, strlen(label));
+    p += strlen(label);
+    if (!lines) *p++ = '[';
+    for (int i = 0; i < n; i++) {
+        memcpy(p, str_ptr(arena, arr[i]), arr[i].len);
+        p += arr[i].len;
+        if (lines) {
+            *p++ = '\n';
+        } else if (i < n - 1) {
+            *p++ = ',';
+            *p++ = ' ';
+        }
     }
-    printf("%s]\n", arr[n - 1]);
+    if (!lines) {
+        *p++ = ']';
+        *p++ = '\n';
+    }
+    int rc = intio_write_all(STDOUT_FILENO, out, (size_t)(p - out)) < 0 ? -1 : 0;
+    free(out);
+    return rc;
+}
+
+int sortStrings(const str_arena_t *arena, str_ref_t *arr, int n, par_pool_t *pool) {
+    return str_sort(arena, arr, (size_t)n, pool);
+}
+
+// The prompts a piped run would have printed, in one write
+static int print_prompts(int n) {
+    char *out = malloc((size_t)n * 32 + 64);
+    if (!out) return -1;
+    char *p = out;
+    p += sprintf(p, "Enter number of strings: ");
+    for (int i = 0; i < n; i++) p += sprintf(p, "Enter string %d: ", i + 1);
+    int rc = intio_write_all(STDOUT_FILENO, out, (size_t)(p - out)) < 0 ? -1 : 0;
+    free(out);
+    return rc;
 }
 
-void sortStrings(char **arr, int n) {
-    for (int i = 1; i < n; i++) {
-        char *key = arr[i];
-        int j = i - 1;
-        while (j >= 0 && strcmp(arr[j], key) > 0) {
-            arr[j + 1] = arr[j];
-            j = j - 1;
+// -c / -u: exact counts over the loaded input
+// The slots' refs are first occurrences, so their arena offsets are distinct
+static int cmp_count_off(const void *a, const void *b) {
+    uint64_t x = ((const str_count_t *)a)->ref.off, y = ((const str_count_t *)b)->ref.off;
+    return (x > y) - (x < y);
+}
+
+static int count_exact(const char *path, size_t k, int unique, par_pool_t *pool) {
+    str_arena_t arena;
+    if (str_arena_load(&arena, path) != 0) {
+        perror(path ? path : "stdin");
+        return 1;
+    }
+    str_table_t table;
+    str_ref_t *batch = malloc(TOKEN_BATCH * sizeof(str_ref_t));
+    if (!batch || str_table_init(&table, &arena, arena.len / 64) != 0) {
+        printf("Memory allocation failed.\n");
+        return 1;
+    }
+    size_t pos = 0, got;
+    while ((got = str_arena_split(&arena, &pos, batch, TOKEN_BATCH)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            if (str_table_add(&table, batch[i], str_hash(str_ptr(&arena, batch[i]), batch[i].len)) != 0) {
+                printf("Memory allocation failed.\n");
+                return 1;
+            }
         }
-        arr[j + 1] = key;
     }
-}
+    free(batch);
 
-int main() {
-    int N;
-    printf("Enter number of strings: ");
-    scanf("%d", &N);
+    if (unique) {
+        // distinct strings, sorted, each with its count: the occupied slots
+        // in offset order, so a sorted ref finds its count by bsearch
+        // instead of probing the table again
+        str_count_t *slots = malloc((table.distinct + 1) * sizeof(str_count_t));
+        str_ref_t *refs = malloc((table.distinct + 1) * sizeof(str_ref_t));
+        if (!slots || !refs) {
+            printf("Memory allocation failed.\n");
+            return 1;
+        }
+        size_t n = 0;
+        for (size_t i = 0; i < table.cap; i++)
+            if (table.slots[i].count) slots[n++] = table.slots[i];
+        qsort(slots, n, sizeof(str_count_t), cmp_count_off);
+        for (size_t i = 0; i < n; i++) refs[i] = slots[i].ref;
+        str_sort(&arena, refs, n, pool);
+        for (size_t i = 0; i < n; i++) {
+            str_count_t key = { .ref = refs[i] };
+            const str_count_t *s = bsearch(&key, slots, n, sizeof(str_count_t), cmp_count_off);
+            printf("%llu %.*s\n", (unsigned long long)s->count, (int)refs[i].len, str_ptr(&arena, refs[i]));
+        }
+        free(refs);
+        free(slots);
+    } else {
+        str_count_t *top = malloc((k + 1) * sizeof(str_count_t));
+        if (!top) {
+            printf("Memory allocation failed.\n");
+            return 1;
+        }
+        size_t n = str_table_top(&table, k, top);
+        printf("Total strings: %llu\nDistinct strings: %zu\nTop %zu:\n",
+               (unsigned long long)table.total, table.distinct, n);
+        for (size_t i = 0; i < n; i++)
+            printf("%10llu  %.*s\n", (unsigned long long)top[i].count, (int)top[i].ref.len,
+                   str_ptr(&arena, top[i].ref));
+        free(top);
+    }
+    str_table_free(&table);
+    str_arena_free(&arena);
+    return 0;
+}
 
-    char **arr = (char**) malloc(N * sizeof(char*));
-    if (arr == NULL) {
+// -A: stream the input through a fixed-size sketch
+static int count_approx(const char *path, size_t k, size_t memory) {
+    int fd = path && strcmp(path, "-") != 0 ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    // track more candidates than reported so late risers are not missed
+    str_sketch_t *sk = str_sketch_create(memory, k * 8 < 64 ? 64 : k * 8);
+    size_t cap = STREAM_CHUNK, have = 0;
+    char *buf = malloc(cap);
+    if (!sk || !buf) {
         printf("Memory allocation failed.\n");
         return 1;
     }
+    for (;;) {
+        ssize_t r = read(fd, buf + have, cap - have);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            return 1;
+        }
+        int eof = r == 0;
+        have += (size_t)r;
+
+        // count every complete token; one cut off by the end of the buffer
+        // is moved to the front and finished by the next read
+        size_t p = 0, done;
+        for (;;) {
+            while (p < have && (unsigned char)buf[p] <= ' ') p++;
+            done = p;
+            if (p == have) break;
+            size_t start = p;
+            while (p < have && (unsigned char)buf[p] > ' ') p++;
+            if (p == have && !eof) break;
+            if (str_sketch_add(sk, buf + start, p - start) != 0) {
+                printf("Memory allocation failed.\n");
+                return 1;
+            }
+        }
+        if (eof) break;
+        memmove(buf, buf + done, have - done);
+        have -= done;
+        if (have == cap) { // one token fills the whole buffer
+            char *bigger = realloc(buf, cap * 2);
+            if (!bigger) {
+                printf("Memory allocation failed.\n");
+                return 1;
+            }
+            buf = bigger;
+            cap *= 2;
+        }
+    }
+    if (fd != STDIN_FILENO) close(fd);
+
+    str_hitter_t *top = malloc((k + 1) * sizeof(str_hitter_t));
+    size_t n = top ? str_sketch_top(sk, top, k) : 0;
+    printf("Total strings: %llu\nDistinct strings: ~%.0f\nTop %zu (counts may be high by up to %llu):\n",
+           (unsigned long long)str_sketch_total(sk), str_sketch_distinct(sk), n,
+           (unsigned long long)str_sketch_error(sk));
+    for (size_t i = 0; i < n; i++)
+        printf("%10llu  %.*s\n", (unsigned long long)top[i].count, (int)top[i].len, top[i].s);
+    free(top);
+    free(buf);
+    str_sketch_free(sk);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int N;
+    int nthreads = 0, sorted_only = 0;
+    int count_mode = 0;  // 'c', 'u' or 'A'
+    size_t k = 10, memory_mb = 64;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0) {
+            sorted_only = 1;
+        } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "-u") == 0 || strcmp(argv[i], "-A") == 0) {
+            count_mode = argv[i][1];
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            k = (size_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            memory_mb = (size_t)atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [-i file] [-s] [-t threads] [-c [-k k] | -u | -A [-M MB] [-k k]]\n", argv[0]);
+            return 1;
+        }
+    }
 
-    readStrings(arr, N);
+    if (count_mode == 'A') return count_approx(path, k, memory_mb << 20);
+    if (count_mode) {
+        par_pool_t *pool = par_pool_create(nthreads);
+        int rc = count_exact(path, k, count_mode == 'u', pool);
+        if (pool) par_pool_destroy(pool);
+        return rc;
+    }
 
-    printf("Original array: ");
-    displayStrings(arr, N);
+    str_arena_t arena;
+    str_ref_t *arr;
+    int interactive = !path && isatty(STDIN_FILENO);
 
-    sortStrings(arr, N);
+    if (interactive) {
+        printf("Enter number of strings: ");
+        if (scanf("%d", &N) != 1 || N <= 0) {
+            printf("Invalid input.\n");
+            return 1;
+        }
+        arr = malloc((size_t)N * sizeof(str_ref_t));
+        if (arr == NULL || str_arena_init(&arena, 4096) != 0) {
+            printf("Memory allocation failed.\n");
+            return 1;
+        }
+        if (readStrings(&arena, arr, N) != 0) {
+            printf("Memory allocation failed.\n");
+            return 1;
+        }
+    } else {
+        // the loaded input is the arena; the refs point into it
+        if (str_arena_load(&arena, path) != 0) {
+            perror(path ? path : "stdin");
+            return 1;
+        }
+        size_t pos = 0;
+        str_ref_t count;
+        char num[16] = "";
+        if (str_arena_split(&arena, &pos, &count, 1) == 1 && count.len < sizeof(num))
+            memcpy(num, str_ptr(&arena, count), count.len);
+        N = atoi(num);
+        if (N <= 0) {
+            printf("Enter number of strings: Invalid input.\n");
+            return 1;
+        }
+        arr = malloc((size_t)N * sizeof(str_ref_t));
+        if (arr == NULL) {
+            printf("Memory allocation failed.\n");
+            return 1;
+        }
+        if (str_arena_split(&arena, &pos, arr, (size_t)N) != (size_t)N) {
+            printf("Enter number of strings: Expected %d strings.\n", N);
+            return 1;
+        }
+        if (!sorted_only) print_prompts(N);
+    }
 
-    printf("Sorted array: ");
-    displayStrings(arr, N);
+    par_pool_t *pool = par_pool_create(nthreads);
 
-    // Free memory
-    for (int i = 0; i < N; i++) {
-        free(arr[i]);
+    if (!sorted_only) {
+        fflush(stdout);
+        displayStrings("Original array: ", &arena, arr, N, 0);
     }
+
+    if (sortStrings(&arena, arr, N, pool) != 0) {
+        printf("Memory allocation failed.\n");
+        return 1;
+    }
+
+    fflush(stdout);
+    if (sorted_only) displayStrings("", &arena, arr, N, 1);
+    else displayStrings("Sorted array: ", &arena, arr, N, 0);
+
+    // Free memory: one arena and one index, however many strings
+    if (pool) par_pool_destroy(pool);
+    str_arena_free(&arena);
     free(arr);
 
     return 0;
@@ -5,30 +5,137 @@ Oladotun Adigun
 
 
 How to compile (on CS Linux systems because im on windows):
-    gcc -o insertion insertion.c
+    gcc -O2 -o insertion insertion.c sort.c parallel.c intio.c trace.c -lpthread -lm
 
 How to run:
-    ./insertion */
+    ./insertion                   read a count and that many integers, print them sorted
+    ./insertion -a <algo>         force auto|insertion|intro|radix|parallel (default auto)
+    ./insertion -t <threads>      threads for the parallel sort (default: all CPUs)
+    ./insertion -i <file>         read the count and integers from file instead of stdin
+    ./insertion -b                binary: native int32s in (no count), sorted int32s out
+    ./insertion -B <n>            benchmark every algorithm on n integers of several shapes
+
+The sorting itself lives in sort.c; insertion sort is kept for small
+partitions and as the baseline in the benchmark. Unless stdin is a
+terminal, input is loaded whole (mmapped when it is a file) and parsed
+and printed by intio.c, which is far cheaper than scanf/printf per
+number. */
 
 #include <stdio.h>
-#include <stdlib.h> 
-
-void insertionSort(int arr[], int n) {
-    int i, key, j;
-    for (i = 1; i < n; i++) {
-        key = arr[i];
-        j = i - 1;
-
-        // Move elements greater than key to one position ahead
-        while (j >= 0 && arr[j] > key) {
-            arr[j + 1] = arr[j];
-            j = j - 1;
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sort.h"
+#include "intio.h"
+
+#define BENCH_INSERTION_MAX 200000  // insertion sort is skipped above this size
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_int(const void *x, const void *y) {
+    int a = *(const int *)x, b = *(const int *)y;
+    return (a > b) - (a < b);
+}
+
+static const char *shape_names[] = { "random", "sorted", "reversed", "nearly", "few-unique" };
+#define NUM_SHAPES (int)(sizeof(shape_names) / sizeof(shape_names[0]))
+
+static void fill_shape(int *a, size_t n, int shape) {
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int r = (int)(seed ^ (seed >> 15));
+        switch (shape) {
+        case 0: a[i] = r; break;
+        case 1: a[i] = (int)i; break;
+        case 2: a[i] = (int)(n - i); break;
+        case 3: a[i] = (int)i; break;
+        default: a[i] = r & 15; break;
+        }
+    }
+    if (shape == 3) { // sorted with 0.1% of elements swapped at random
+        for (size_t k = 0; k < n / 1000 + 1; k++) {
+            seed = seed * 1103515245u + 12345u;
+            size_t i = seed % n;
+            seed = seed * 1103515245u + 12345u;
+            size_t j = seed % n;
+            int t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+}
+
+#define BENCH_QSORT -1  // libc qsort as a reference column
+static const int bench_columns[] = { SORT_INSERTION, BENCH_QSORT, SORT_INTRO, SORT_RADIX, SORT_PARALLEL, SORT_AUTO };
+#define NUM_COLUMNS (int)(sizeof(bench_columns) / sizeof(bench_columns[0]))
+
+// Time every algorithm (and libc qsort) on each input shape
+static int benchmark(size_t n, par_pool_t *pool) {
+    int *src = malloc(n * sizeof(int));
+    int *ref = malloc(n * sizeof(int));
+    int *work = malloc(n * sizeof(int));
+    if (!src || !ref || !work) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    printf("n = %zu, %d threads, times in ms\n", n, par_pool_size(pool));
+    printf("%-11s %10s %10s %10s %10s %10s %10s  auto picks\n",
+           "shape", "insertion", "qsort", "intro", "radix", "parallel", "auto");
+
+    for (int shape = 0; shape < NUM_SHAPES; shape++) {
+        fill_shape(src, n, shape);
+        memcpy(ref, src, n * sizeof(int));
+        qsort(ref, n, sizeof(int), cmp_int);
+        printf("%-11s", shape_names[shape]);
+
+        sort_algo_t picked = SORT_AUTO;
+        for (int c = 0; c < NUM_COLUMNS; c++) {
+            int algo = bench_columns[c];
+            if (algo == SORT_INSERTION && n > BENCH_INSERTION_MAX && shape != 1) {
+                printf(" %10s", "-");
+                continue;
+            }
+            memcpy(work, src, n * sizeof(int));
+            double t0 = now_sec();
+            if (algo == BENCH_QSORT) qsort(work, n, sizeof(int), cmp_int);
+            else picked = sort_ints(work, n, (sort_algo_t)algo, pool);
+            double ms = (now_sec() - t0) * 1e3;
+            printf(" %10.2f%s", ms, memcmp(work, ref, n * sizeof(int)) ? "!" : "");
         }
-        arr[j + 1] = key;
+        printf("  %s\n", sort_algo_name(picked));
+    }
+    printf("(! marks a result that differs from qsort)\n");
+    free(src);
+    free(ref);
+    free(work);
+    return 0;
+}
+
+// Print "Sorted array:" and the values with one write
+static int print_sorted(const char *prefix, const int *arr, size_t n) {
+    size_t plen = strlen(prefix);
+    char *out = malloc(plen + INTIO_FORMAT_MAX(n) + 2);
+    if (!out) {
+        printf("Not enough memory for the output.\n");
+        return 1;
     }
+    memcpy(out, prefix, plen);
+    size_t len = plen + intio_format_ints(arr, n, ' ', out + plen);
+    out[len++] = '\n';
+    int rc = intio_write_all(STDOUT_FILENO, out, len) < 0;
+    free(out);
+    return rc;
 }
 
-int main() {
+// Typing at a terminal: prompt and read as the numbers come in
+static int sort_interactive(sort_algo_t algo, par_pool_t *pool) {
     int n, i;
 
     printf("Enter the number of elements: ");
@@ -37,24 +144,130 @@ int main() {
         return 1;
     }
 
-    int arr[n];
+    // on the heap: a stack array overflows for large n
+    int *arr = malloc((size_t)n * sizeof(int));
+    if (!arr) {
+        printf("Not enough memory for %d integers.\n", n);
+        return 1;
+    }
 
     printf("Enter %d integers:\n", n);
     for (i = 0; i < n; i++) {
         if (scanf("%d", &arr[i]) != 1) {
             printf("Invalid input. Exiting.\n");
+            free(arr);
             return 1;
         }
     }
 
-    // Sort array using insertion sort
-    insertionSort(arr, n);
+    // Sort array (insertion sort for small inputs, see sort_choose())
+    sort_ints(arr, (size_t)n, algo, pool);
 
-    printf("Sorted array:\n");
-    for (i = 0; i < n; i++) {
-        printf("%d ", arr[i]);
+    fflush(stdout);
+    int rc = print_sorted("Sorted array:\n", arr, (size_t)n);
+    free(arr);
+    return rc;
+}
+
+// Count and integers from a file or pipe, loaded and parsed in bulk. The
+// prompts are still printed so the output matches the interactive run.
+static int sort_text(const char *path, sort_algo_t algo, par_pool_t *pool) {
+    intio_buf_t in;
+    if (intio_load(path, 0, &in) != 0) {
+        perror(path ? path : "stdin");
+        return 1;
+    }
+    const char *p = in.data, *end = in.data + in.len;
+    int n, bad;
+    if (intio_parse_ints(&p, end, in.padded, &n, 1, &bad) != 1 || n <= 0) {
+        printf("Enter the number of elements: Invalid input. Please enter a positive integer.\n");
+        intio_release(&in);
+        return 1;
+    }
+    int *arr = malloc((size_t)n * sizeof(int));
+    if (!arr) {
+        printf("Enter the number of elements: Not enough memory for %d integers.\n", n);
+        intio_release(&in);
+        return 1;
+    }
+    size_t got = intio_parse_ints(&p, end, in.padded, arr, (size_t)n, &bad);
+    intio_release(&in);
+    if (got != (size_t)n) {
+        printf("Enter the number of elements: Enter %d integers:\nInvalid input. Exiting.\n", n);
+        free(arr);
+        return 1;
     }
-    printf("\n");
 
-    return 0;
+    sort_ints(arr, (size_t)n, algo, pool);
+
+    char prefix[96];
+    snprintf(prefix, sizeof(prefix), "Enter the number of elements: Enter %d integers:\nSorted array:\n", n);
+    int rc = print_sorted(prefix, arr, (size_t)n);
+    free(arr);
+    return rc;
+}
+
+// Raw native-endian int32s in, sorted raw int32s out. A file is mapped
+// copy-on-write and sorted where it lies.
+static int sort_binary(const char *path, sort_algo_t algo, par_pool_t *pool) {
+    intio_buf_t in;
+    if (intio_load(path, 1, &in) != 0) {
+        perror(path ? path : "stdin");
+        return 1;
+    }
+    if (in.len % sizeof(int) != 0) {
+        fprintf(stderr, "Input is not a whole number of 32-bit integers.\n");
+        intio_release(&in);
+        return 1;
+    }
+    size_t n = in.len / sizeof(int);
+    int *arr = (int *)(void *)in.data;  // page or malloc aligned
+    sort_ints(arr, n, algo, pool);
+    int rc = intio_write_all(STDOUT_FILENO, arr, in.len) < 0;
+    if (rc) perror("write");
+    intio_release(&in);
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    int i;
+    int nthreads = 0;
+    long bench = 0;
+    int binary = 0;
+    const char *path = NULL;
+    sort_algo_t algo = SORT_AUTO;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-a") == 0 && i + 1 < argc && sort_algo_parse(argv[i + 1]) >= 0) {
+            algo = (sort_algo_t)sort_algo_parse(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0) {
+            binary = 1;
+        } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+            bench = atol(argv[++i]);
+        } else {
+            printf("Usage: %s [-a auto|insertion|intro|radix|parallel] [-t threads] [-i file] [-b] [-B n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    par_pool_t *pool = par_pool_create(nthreads);
+    if (!pool) {
+        printf("Could not start threads\n");
+        return 1;
+    }
+    if (bench > 0) {
+        int rc = benchmark((size_t)bench, pool);
+        par_pool_destroy(pool);
+        return rc;
+    }
+
+    int rc = binary ? sort_binary(path, algo, pool)
+           : (!path && isatty(STDIN_FILENO)) ? sort_interactive(algo, pool)
+           : sort_text(path, algo, pool);
+    par_pool_destroy(pool);
+    return rc;
 }
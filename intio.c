@@ -0,0 +1,197 @@
+/* intio.c
+   Bulk integer input/output; see intio.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "intio.h"
+
+#define READ_CHUNK (1 << 20)
+
+int intio_load(const char *path, int writable, intio_buf_t *buf) {
+    int use_stdin = !path || strcmp(path, "-") == 0;
+    int fd = use_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+    memset(buf, 0, sizeof(*buf));
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t len = (size_t)st.st_size;
+        int prot = PROT_READ | (writable ? PROT_WRITE : 0);
+        void *map = mmap(NULL, len, prot, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, len, MADV_SEQUENTIAL);
+            if (!use_stdin) close(fd);
+            buf->data = map;
+            buf->len = len;
+            buf->map = map;
+            buf->map_len = len;
+            // the zero fill after EOF is only readable if the page has room
+            buf->padded = len % (size_t)sysconf(_SC_PAGESIZE) != 0 &&
+                          len % (size_t)sysconf(_SC_PAGESIZE) <= (size_t)sysconf(_SC_PAGESIZE) - 8;
+            return 0;
+        }
+    }
+
+    // pipes, terminals, or mmap refused: read everything into one buffer
+    size_t cap = READ_CHUNK, n = 0;
+    char *data = malloc(cap + 8);
+    while (data) {
+        ssize_t r = read(fd, data + n, cap - n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            if (r < 0) {
+                free(data);
+                data = NULL;
+            }
+            break;
+        }
+        n += (size_t)r;
+        if (n == cap) {
+            char *bigger = realloc(data, cap * 2 + 8);
+            if (!bigger) {
+                free(data);
+                data = NULL;
+                break;
+            }
+            data = bigger;
+            cap *= 2;
+        }
+    }
+    int saved = errno;
+    if (!use_stdin) close(fd);
+    if (!data) {
+        errno = saved ? saved : ENOMEM;
+        return -1;
+    }
+    memset(data + n, 0, 8);
+    buf->data = data;
+    buf->len = n;
+    buf->padded = 1;
+    return 0;
+}
+
+void intio_release(intio_buf_t *buf) {
+    if (buf->map) munmap(buf->map, buf->map_len);
+    else free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+// Number of leading ASCII digits in the 8 bytes of chunk (little endian)
+static inline int digit_run(uint64_t chunk) {
+    // a byte is a digit iff its high nibble is 3 and its low nibble <= 9
+    uint64_t high = (chunk & 0xF0F0F0F0F0F0F0F0ull) ^ 0x3030303030303030ull;
+    uint64_t over = ((chunk & 0x0F0F0F0F0F0F0F0Full) + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull;
+    uint64_t y = high | over;  // zero byte <=> digit
+    uint64_t nonzero = (((y & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | y) & 0x8080808080808080ull;
+    return nonzero ? __builtin_ctzll(nonzero) / 8 : 8;
+}
+
+// Value of the first len (1..8) digits of chunk: shift them to the top so
+// the rest read as leading zeros, then combine pairs, quads and octets.
+static inline uint64_t digits_value(uint64_t chunk, int len) {
+    uint64_t v = (chunk & 0x0F0F0F0F0F0F0F0Full) << (8 * (8 - len));
+    v = (v * (1 + (10 << 8))) >> 8 & 0x00FF00FF00FF00FFull;
+    v = (v * (1 + (100 << 16))) >> 16 & 0x0000FFFF0000FFFFull;
+    return (v * (1 + (10000ull << 32))) >> 32;
+}
+
+size_t intio_parse_ints(const char **pos, const char *end, int padded, int *out, size_t max, int *bad) {
+    const char *p = *pos;
+    size_t count = 0;
+    *bad = 0;
+    while (count < max) {
+        while (p < end && (unsigned char)*p <= ' ') p++;
+        if (p >= end) break;
+
+        int neg = 0;
+        if (*p == '-' || *p == '+') {
+            neg = *p == '-';
+            p++;
+        }
+        uint64_t v = 0;
+        int ndigits = 0;
+        if (padded || end - p >= 8) {
+            uint64_t chunk;
+            memcpy(&chunk, p, 8);
+            int len = digit_run(chunk);
+            if (len > end - p) len = (int)(end - p);
+            if (len > 0) v = digits_value(chunk, len);
+            p += len;
+            ndigits = len;
+        }
+        // the rest (past 8 digits, or near an unpadded end) one at a time
+        while (p < end && (unsigned)(*p - '0') < 10 && ndigits < 12) {
+            v = v * 10 + (uint64_t)(*p++ - '0');
+            ndigits++;
+        }
+        if (ndigits == 0 || ndigits >= 12 || (p < end && (unsigned char)*p > ' ') ||
+            v > (neg ? 2147483648ull : 2147483647ull)) {
+            *bad = 1;
+            break;
+        }
+        out[count++] = neg ? (int)(0 - (int64_t)v) : (int)v;
+    }
+    *pos = p;
+    return count;
+}
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+size_t intio_format_ints(const int *a, size_t n, char sep, char *out) {
+    char *o = out;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t v = (uint32_t)a[i];
+        if (a[i] < 0) {
+            *o++ = '-';
+            v = 0u - v;
+        }
+        // two digits per step from the right, into a small scratch
+        char tmp[12];
+        char *t = tmp + sizeof(tmp);
+        while (v >= 100) {
+            uint32_t q = v / 100;
+            t -= 2;
+            memcpy(t, digit_pairs + 2 * (v - q * 100), 2);
+            v = q;
+        }
+        if (v >= 10) {
+            t -= 2;
+            memcpy(t, digit_pairs + 2 * v, 2);
+        } else {
+            *--t = (char)('0' + v);
+        }
+        size_t len = (size_t)(tmp + sizeof(tmp) - t);
+        memcpy(o, t, len);
+        o += len;
+        *o++ = sep;
+    }
+    return (size_t)(o - out);
+}
+
+ssize_t intio_write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t w = write(fd, p, left);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        left -= (size_t)w;
+        p += w;
+    }
+    return (ssize_t)len;
+}
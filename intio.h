@@ -0,0 +1,45 @@
+/* intio.h
+   Bulk integer input/output: whole-file loading (mmap or one growing
+   read buffer), a SWAR decimal parser and a table-driven formatter.
+   Used by insertion.c; compile intio.c alongside it.
+*/
+
+#ifndef INTIO_H
+#define INTIO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef struct {
+    char *data;        /* file contents; readable 8 bytes past len when padded */
+    size_t len;
+    int padded;        /* data[len..len+7] may be read (zeros) */
+    void *map;         /* non-NULL if data is an mmap of a regular file */
+    size_t map_len;
+} intio_buf_t;
+
+/* Load all of path (NULL or "-" = stdin). Regular files are mmapped
+   MAP_PRIVATE, so writable != 0 gives a copy-on-write view that can be
+   sorted in place; pipes and terminals are read into a malloc'd buffer.
+   Returns 0, or -1 with errno set. */
+int intio_load(const char *path, int writable, intio_buf_t *buf);
+void intio_release(intio_buf_t *buf);
+
+/* Parse up to max whitespace-separated decimal ints from [*pos, end) into
+   out. Eight digits are converted at a time with SWAR arithmetic when
+   padded or at least 8 bytes remain. Returns the number parsed and
+   advances *pos; stops early at end of input, or sets *bad to 1 at a
+   malformed or out-of-range token. */
+size_t intio_parse_ints(const char **pos, const char *end, int padded, int *out, size_t max, int *bad);
+
+/* Maximum bytes intio_format_ints() writes for n values */
+#define INTIO_FORMAT_MAX(n) ((size_t)(n) * 12)
+
+/* Write each value followed by sep into out using a 00..99 digit-pair
+   table; returns the number of bytes written. */
+size_t intio_format_ints(const int *a, size_t n, char sep, char *out);
+
+/* write() until everything is out, retrying on EINTR */
+ssize_t intio_write_all(int fd, const void *buf, size_t len);
+
+#endif
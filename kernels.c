@@ -0,0 +1,289 @@
+/* kernels.c
+   Vectorized kernels from oaadigun_HW01.c; see kernels.h.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "kernels.h"
+
+// GCC vector extensions give portable 32-byte arithmetic; target_clones
+// builds an AVX-512 (x86-64-v4: F, CD, DQ, BW, VL), AVX2, SSE4.2 and
+// baseline copy of each kernel and the loader picks one by CPU features (an
+// arch=skylake-avx512 copy is picked by CPU model, so only on Skylake-SP).
+// Vectors stay at 32 bytes: GCC scalarizes byte compares on 64-byte
+// vectors, and the AVX-512 copy still gains masked compares and three-input
+// logic on them.
+#pragma GCC diagnostic ignored "-Wpsabi"   // vector helpers are static inline, no ABI exposure
+typedef int32_t v8i __attribute__((vector_size(32)));
+typedef uint32_t v8u __attribute__((vector_size(32)));
+typedef int8_t v32b __attribute__((vector_size(32)));
+typedef uint8_t v32u8 __attribute__((vector_size(32)));
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define KERN_KERNEL __attribute__((target_clones("arch=x86-64-v4", "avx2", "sse4.2", "default")))
+#else
+#define KERN_KERNEL
+#endif
+
+#define INTS 8                    // ints per vector
+#define BYTES 32                  // bytes per vector
+#define VOWEL_FLUSH 255           // vectors before the byte counters could wrap
+#define DIGIT_FLUSH (1 << 20)     // vectors before the digit-sum lanes could wrap
+
+// 1 for a, e, i, o, u in either case: the scalar lookup for buffer tails
+static const unsigned char vowel_class[256] = {
+    ['a'] = 1, ['e'] = 1, ['i'] = 1, ['o'] = 1, ['u'] = 1,
+    ['A'] = 1, ['E'] = 1, ['I'] = 1, ['O'] = 1, ['U'] = 1,
+};
+
+static inline v8i load_ints(const int *p) {
+    v8i v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store_ints(int *p, const v8i *v) {
+    memcpy(p, v, sizeof(*v));
+}
+
+static inline v32u8 load_bytes(const char *p) {
+    v32u8 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+// Comparisons give all-ones lanes, so the select is branchless
+KERN_KERNEL
+static void minmax_kernel(const int *a, size_t n, int *min, int *max) {
+    int lo = a[0], hi = a[0];
+    size_t i = 0;
+    if (n >= 2 * INTS) {
+        v8i lo0 = load_ints(a), hi0 = lo0;
+        v8i lo1 = load_ints(a + INTS), hi1 = lo1;
+        for (i = 2 * INTS; i + 2 * INTS <= n; i += 2 * INTS) {
+            v8i x0 = load_ints(a + i), x1 = load_ints(a + i + INTS);
+            v8i k;
+            k = x0 < lo0; lo0 = (x0 & k) | (lo0 & ~k);
+            k = x0 > hi0; hi0 = (x0 & k) | (hi0 & ~k);
+            k = x1 < lo1; lo1 = (x1 & k) | (lo1 & ~k);
+            k = x1 > hi1; hi1 = (x1 & k) | (hi1 & ~k);
+        }
+        for (int l = 0; l < INTS; l++) {
+            if (lo0[l] < lo) lo = lo0[l];
+            if (lo1[l] < lo) lo = lo1[l];
+            if (hi0[l] > hi) hi = hi0[l];
+            if (hi1[l] > hi) hi = hi1[l];
+        }
+    }
+    for (; i < n; i++) {
+        if (a[i] < lo) lo = a[i];
+        if (a[i] > hi) hi = a[i];
+    }
+    *min = lo;
+    *max = hi;
+}
+
+// x & -(x & 1): all ones for odd x, zero for even, including negatives
+KERN_KERNEL
+static void even_kernel(const int *a, size_t n, int *out) {
+    size_t i = 0;
+    for (; i + INTS <= n; i += INTS) {
+        v8i x = load_ints(a + i);
+        v8i r = x & -(x & 1);
+        store_ints(out + i, &r);
+    }
+    for (; i < n; i++) out[i] = a[i] & -(a[i] & 1);
+}
+
+// Setting bit 5 folds upper case onto lower case and maps no other byte onto
+// a vowel, so five compares classify 32 bytes. A match is -1, subtracted
+// into per-lane byte counters that are widened before they can wrap.
+KERN_KERNEL
+static size_t vowel_kernel(const char *s, size_t n) {
+    size_t count = 0, i = 0;
+    while (i + BYTES <= n) {
+        v32b acc = { 0 };
+        for (int k = 0; k < VOWEL_FLUSH && i + BYTES <= n; k++, i += BYTES) {
+            v32u8 c = load_bytes(s + i) | 0x20;
+            acc -= (v32b)((c == 'a') | (c == 'e') | (c == 'i') | (c == 'o') | (c == 'u'));
+        }
+        v32u8 u = (v32u8)acc;
+        for (int l = 0; l < BYTES; l++) count += u[l];
+    }
+    for (; i < n; i++) count += vowel_class[(unsigned char)s[i]];
+    return count;
+}
+
+static inline int digit_sum(int x) {
+    if (x <= 0) return -1;
+    int sum = 0;
+    while (x > 0) {
+        sum += x % 10;
+        x /= 10;
+    }
+    return sum;
+}
+
+// Ten rounds of divide-by-ten cover every int; GCC turns the constant
+// division into a high multiply, so no lane ever branches on its length.
+KERN_KERNEL
+static long long digits_kernel(const int *a, size_t n, int *out) {
+    long long total = 0;
+    size_t i = 0;
+    while (i + INTS <= n) {
+        v8u acc = { 0 };
+        for (int k = 0; k < DIGIT_FLUSH && i + INTS <= n; k++, i += INTS) {
+            v8i x = load_ints(a + i);
+            v8i pos = x > 0;
+            v8u u = (v8u)x, s = { 0 };
+            for (int d = 0; d < 10; d++) {
+                v8u q = u / 10;
+                s += u - q * 10;
+                u = q;
+            }
+            s &= (v8u)pos;
+            acc += s;
+            v8i r = (v8i)s | ~pos;
+            store_ints(out + i, &r);
+        }
+        for (int l = 0; l < INTS; l++) total += acc[l];
+    }
+    for (; i < n; i++) {
+        out[i] = digit_sum(a[i]);
+        if (out[i] > 0) total += out[i];
+    }
+    return total;
+}
+
+// ---------------------------------------------------------------------------
+// Threaded drivers
+// ---------------------------------------------------------------------------
+
+static int use_pool(const par_pool_t *pool, size_t n) {
+    return pool && par_pool_size(pool) > 1 && n >= KERN_PARALLEL_MIN;
+}
+
+typedef struct {
+    const int *a;
+    const char *s;
+    int *out;
+} kern_job_t;
+
+typedef struct {
+    int min, max;
+    int any;
+} minmax_acc_t;
+
+static void minmax_init(void *acc, void *arg) {
+    (void)arg;
+    memset(acc, 0, sizeof(minmax_acc_t));
+}
+
+static void minmax_combine(void *into, const void *from, void *arg) {
+    minmax_acc_t *x = (minmax_acc_t *)into;
+    const minmax_acc_t *y = (const minmax_acc_t *)from;
+    (void)arg;
+    if (!y->any) return;
+    if (!x->any || y->min < x->min) x->min = y->min;
+    if (!x->any || y->max > x->max) x->max = y->max;
+    x->any = 1;
+}
+
+static void minmax_body(void *arg, size_t start, size_t end, void *acc) {
+    const kern_job_t *job = (const kern_job_t *)arg;
+    minmax_acc_t r = { 0, 0, 1 };
+    if (end == start) return;
+    minmax_kernel(job->a + start, end - start, &r.min, &r.max);
+    minmax_combine(acc, &r, arg);
+}
+
+int kern_minmax(const int *a, size_t n, int *min, int *max, par_pool_t *pool) {
+    if (n == 0) return -1;
+    if (!use_pool(pool, n)) {
+        minmax_kernel(a, n, min, max);
+        return 0;
+    }
+    static const par_reducer_t reducer = { sizeof(minmax_acc_t), minmax_init, minmax_combine };
+    kern_job_t job = { a, NULL, NULL };
+    minmax_acc_t r;
+    par_parallel_reduce(pool, n, 0, &reducer, minmax_body, &job, &r);
+    *min = r.min;
+    *max = r.max;
+    return 0;
+}
+
+long long kern_max_min_diff(const int *a, size_t n, par_pool_t *pool) {
+    int min, max;
+    if (kern_minmax(a, n, &min, &max, pool) != 0) return 0;
+    return (long long)max - min;
+}
+
+static void even_body(void *arg, size_t start, size_t end, int tid) {
+    const kern_job_t *job = (const kern_job_t *)arg;
+    (void)tid;
+    even_kernel(job->a + start, end - start, job->out + start);
+}
+
+void kern_replace_even_with_zero(const int *a, size_t n, int *out, par_pool_t *pool) {
+    if (!use_pool(pool, n)) {
+        even_kernel(a, n, out);
+        return;
+    }
+    kern_job_t job = { a, NULL, out };
+    par_for(pool, n, 0, even_body, &job);
+}
+
+// Shared by the vowel count and the digit sums: one 64-bit total per thread
+static void total_init(void *acc, void *arg) {
+    (void)arg;
+    *(long long *)acc = 0;
+}
+
+static void total_combine(void *into, const void *from, void *arg) {
+    (void)arg;
+    *(long long *)into += *(const long long *)from;
+}
+
+static const par_reducer_t total_reducer = { sizeof(long long), total_init, total_combine };
+
+static void vowel_body(void *arg, size_t start, size_t end, void *acc) {
+    const kern_job_t *job = (const kern_job_t *)arg;
+    *(long long *)acc += (long long)vowel_kernel(job->s + start, end - start);
+}
+
+size_t kern_count_vowels(const char *s, size_t n, par_pool_t *pool) {
+    if (!use_pool(pool, n)) return vowel_kernel(s, n);
+    kern_job_t job = { NULL, s, NULL };
+    long long total;
+    par_parallel_reduce(pool, n, 0, &total_reducer, vowel_body, &job, &total);
+    return (size_t)total;
+}
+
+static void digits_body(void *arg, size_t start, size_t end, void *acc) {
+    const kern_job_t *job = (const kern_job_t *)arg;
+    *(long long *)acc += digits_kernel(job->a + start, end - start, job->out + start);
+}
+
+long long kern_sum_of_digits(const int *a, size_t n, int *out, par_pool_t *pool) {
+    if (!use_pool(pool, n)) return digits_kernel(a, n, out);
+    kern_job_t job = { a, NULL, out };
+    long long total;
+    par_parallel_reduce(pool, n, 0, &total_reducer, digits_body, &job, &total);
+    return total;
+}
+
+const char *kern_isa(void) {
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+    __builtin_cpu_init();
+    // the same tests the target_clones resolver makes
+    if (__builtin_cpu_supports("x86-64-v4")) return "avx512";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    if (__builtin_cpu_supports("sse4.2")) return "sse4.2";
+#endif
+    return "baseline";
+}
@@ -0,0 +1,42 @@
+/* kernels.h
+   Vectorized array and text kernels grown out of oaadigun_HW01.c: min/max,
+   even-zeroing, vowel counting and digit sums over large buffers. Every
+   kernel is built for AVX-512, AVX2, SSE4.2 and baseline x86-64 and the
+   best one for the running CPU is picked at load time. Given a pool with
+   more than one thread, inputs of at least KERN_PARALLEL_MIN elements are
+   split across it with par_for()/par_parallel_reduce().
+   Used by oaadigun_HW01.c; compile kernels.c and parallel.c alongside it:
+       gcc -O2 -Wall oaadigun_HW01.c kernels.c parallel.c trace.c -lpthread -lm -o hw01
+*/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+
+#include "parallel.h"
+
+#define KERN_PARALLEL_MIN (1 << 18)
+
+/* Smallest and largest of a[0, n) in one pass; returns 0, or -1 if n == 0 */
+int kern_minmax(const int *a, size_t n, int *min, int *max, par_pool_t *pool);
+
+/* max - min of a[0, n) without overflow, 0 for an empty array */
+long long kern_max_min_diff(const int *a, size_t n, par_pool_t *pool);
+
+/* out[i] = a[i] if odd, else 0, with a mask instead of a branch.
+   out may equal a. */
+void kern_replace_even_with_zero(const int *a, size_t n, int *out, par_pool_t *pool);
+
+/* Number of a, e, i, o, u (either case) in s[0, n) */
+size_t kern_count_vowels(const char *s, size_t n, par_pool_t *pool);
+
+/* out[i] = sum of the decimal digits of a[i], or -1 if a[i] <= 0 (as
+   sumOfDigits()); returns the sum of the positive out[i]. */
+long long kern_sum_of_digits(const int *a, size_t n, int *out, par_pool_t *pool);
+
+/* Instruction set the kernels dispatched to: "avx512", "avx2", "sse4.2"
+   or "baseline" */
+const char *kern_isa(void);
+
+#endif
@@ -1,10 +1,110 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 
 #define BUFFSIZE 4096
+#define COPY_CHUNK (1 << 20)    // bytes per copy_file_range/pread call
+
+// What happened to the source's bytes
+long long clonedBytes = 0, copiedBytes = 0, holeBytes = 0;
+int canClone = 1;               // cleared once the filesystem refuses FICLONERANGE
+int canCopyRange = 1;           // cleared once copy_file_range is refused
+
+// Copy src[off, off + len) to dst at dstOff: copy_file_range first (the
+// kernel moves the pages, and some filesystems share them), then pread/pwrite.
+// Returns 0 or -1.
+int copyRange(int src, int dst, off_t off, off_t len, off_t dstOff) {
+    static char buf[COPY_CHUNK];
+    while (len > 0) {
+        size_t want = len < COPY_CHUNK ? (size_t)len : COPY_CHUNK;
+        ssize_t n = -1;
+        if (canCopyRange) {
+            loff_t in = off, out = dstOff;
+            n = copy_file_range(src, &in, dst, &out, want, 0);
+            if (n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                canCopyRange = 0;
+            }
+        }
+        if (!canCopyRange) {
+            n = pread(src, buf, want, off);
+            if (n > 0 && pwrite(dst, buf, n, dstOff) != n) return -1;
+        }
+        if (n < 0) return -1;
+        if (n == 0) break;      // the source shrank under us
+        off += n;
+        dstOff += n;
+        len -= n;
+        copiedBytes += n;
+    }
+    return 0;
+}
+
+// Share src[off, off + len) into dst at dstOff if the filesystem can (both
+// offsets block aligned; len too unless it runs to the source's end).
+// Returns 0 if shared, -1 if the range has to be copied instead.
+int cloneRange(int src, int dst, off_t off, off_t len, off_t dstOff) {
+    if (!canClone || len == 0) return -1;
+    struct file_clone_range r = { .src_fd = src, .src_offset = off, .src_length = len, .dest_offset = dstOff };
+    if (ioctl(dst, FICLONERANGE, &r) == 0) {
+        clonedBytes += len;
+        return 0;
+    }
+    // EINVAL is about this range (alignment, EOF); anything else means never
+    if (errno != EINVAL) canClone = 0;
+    return -1;
+}
+
+// Append one data extent src[start, end) at base + start. The block-aligned
+// middle is cloned where possible; unaligned edges and refused ranges are copied.
+int appendExtent(int src, int dst, off_t start, off_t end, off_t srcSize, off_t base, off_t block) {
+    off_t cs = (start + block - 1) / block * block;
+    off_t ce = end == srcSize ? end : end / block * block;
+    if (canClone && base % block == 0 && cs < ce &&
+        cloneRange(src, dst, cs, ce - cs, base + cs) == 0) {
+        if (copyRange(src, dst, start, cs - start, base + start) != 0) return -1;
+        return copyRange(src, dst, ce, end - ce, base + ce);
+    }
+    return copyRange(src, dst, start, end - start, base + start);
+}
+
+// Append a regular source file extent by extent: SEEK_DATA/SEEK_HOLE find
+// the data, holes are skipped (left unwritten, so they stay holes in the
+// destination) and the destination is extended over a trailing hole at the
+// end. Returns 0, -1 on error, or 1 if the source can't be walked this way.
+int appendSparse(int src, int dst) {
+    struct stat sst, dst_st;
+    if (fstat(src, &sst) != 0 || fstat(dst, &dst_st) != 0) return -1;
+    if (!S_ISREG(sst.st_mode) || !S_ISREG(dst_st.st_mode)) return 1;
+    off_t size = sst.st_size, base = dst_st.st_size;
+    off_t block = dst_st.st_blksize > 0 ? dst_st.st_blksize : BUFFSIZE;
+
+    off_t off = 0;
+    while (off < size) {
+        off_t data = lseek(src, off, SEEK_DATA);
+        if (data < 0 && errno == ENXIO) break;      // only a hole is left
+        if (data < 0) {
+            // no SEEK_DATA here: everything is data
+            if (off != 0) return -1;
+            return appendExtent(src, dst, 0, size, size, base, block);
+        }
+        off_t hole = lseek(src, data, SEEK_HOLE);
+        if (hole < 0) return -1;
+        if (hole > size) hole = size;
+        holeBytes += data - off;
+        if (appendExtent(src, dst, data, hole, size, base, block) != 0) return -1;
+        off = hole;
+    }
+    if (off < size) holeBytes += size - off;
+    // a trailing hole has no data to write, so set the length directly
+    return ftruncate(dst, base + size) == 0 ? 0 : -1;
+}
 
 int main(int argc, char *argv[]) {
     int sourceFile, destFile;
@@ -30,35 +130,54 @@ int main(int argc, char *argv[]) {
         exit(-1);
     }
     
-    // Open destination file for appending (create if doesn't exist)
-    destFile = open(argv[1], O_WRONLY | O_CREAT | O_APPEND, 0644);
+    // Open destination file for writing (create if doesn't exist). Writes go
+    // to explicit offsets past its current end rather than through
+    // O_APPEND, which FICLONERANGE and skipping holes both need.
+    destFile = open(argv[1], O_WRONLY | O_CREAT, 0644);
     if (destFile == -1) {
         printf("Error: Cannot open destination file '%s'\n", argv[1]);
         close(sourceFile);
         exit(-1);
     }
     
-    // Copy contents from source to destination
-    while ((n = read(sourceFile, buf, BUFFSIZE)) > 0) {
-        if (write(destFile, buf, n) != n) {
-            printf("Error writing to destination file\n");
-            close(sourceFile);
-            close(destFile);
-            exit(-1);
-        }
-    }
-    
-    if (n < 0) {
-        printf("Error reading from source file\n");
+    // Regular files: copy only the data extents, sharing blocks if possible
+    int r = appendSparse(sourceFile, destFile);
+    if (r < 0) {
+        printf("Error appending '%s' to '%s': %s\n", argv[2], argv[1], strerror(errno));
         close(sourceFile);
         close(destFile);
         exit(-1);
     }
+
+    // Anything else (pipes, devices): copy contents from source to destination
+    if (r > 0) {
+        lseek(destFile, 0, SEEK_END);
+        while ((n = read(sourceFile, buf, BUFFSIZE)) > 0) {
+            if (write(destFile, buf, n) != n) {
+                printf("Error writing to destination file\n");
+                close(sourceFile);
+                close(destFile);
+                exit(-1);
+            }
+            copiedBytes += n;
+        }
     
+        if (n < 0) {
+            printf("Error reading from source file\n");
+            close(sourceFile);
+            close(destFile);
+            exit(-1);
+        }
+    }
+
     // Close files
     close(sourceFile);
-    close(destFile);
+    if (close(destFile) != 0) {
+        printf("Error writing to destination file\n");
+        exit(-1);
+    }
     
     printf("Successfully concatenated '%s' to '%s'\n", argv[2], argv[1]);
+    printf("%lld bytes shared, %lld copied, %lld left as holes\n", clonedBytes, copiedBytes, holeBytes);
     return 0;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #define MAX_LINE 1024
 #define MAX_LISTINGS 1000
@@ -58,6 +59,15 @@ int compareByPrice(const void *a, const void *b) {
     else return 0;
 }
 
+// Write one listing as a CSV row
+void writeListing(FILE *fp, const struct listing *item) {
+    fprintf(fp, "%d,%d,%s,%s,%s,%.6f,%.6f,%s,%.2f,%d,%d,%d,%d\n",
+        item->id, item->host_id, item->host_name, item->neighbourhood_group,
+        item->neighbourhood, item->latitude, item->longitude, item->room_type,
+        item->price, item->minimum_nights, item->number_of_reviews,
+        item->calculated_host_listings_count, item->availability_365);
+}
+
 // Write sorted data to a new file
 void writeToFile(struct listing *list, int count, const char *filename) {
     FILE *fp = fopen(filename, "w");
@@ -67,22 +77,657 @@ void writeToFile(struct listing *list, int count, const char *filename) {
     }
 
     for (int i = 0; i < count; i++) {
-        fprintf(fp, "%d,%d,%s,%s,%s,%.6f,%.6f,%s,%.2f,%d,%d,%d,%d\n",
-            list[i].id, list[i].host_id, list[i].host_name, list[i].neighbourhood_group,
-            list[i].neighbourhood, list[i].latitude, list[i].longitude, list[i].room_type,
-            list[i].price, list[i].minimum_nights, list[i].number_of_reviews,
-            list[i].calculated_host_listings_count, list[i].availability_365);
+        writeListing(fp, &list[i]);
     }
 
     fclose(fp);
 }
 
-int main() {
+// ---------------------------------------------------------------------------
+// Delta mode (-d changes.csv)
+//
+// A changeset line is an op, a comma, and then either a full listing row
+// (I = insert, U = update) or just the id (D = delete):
+//     U,2001,1234,Anna,Brooklyn,Kensington,40.64,-73.97,Private room,149,1,9,6,365
+//     D,2002
+// Only the changes are parsed and sorted. Each sorted file is streamed once:
+// rows whose id has a change are dropped, and the new versions of changed
+// rows are merged in by the file's key. Untouched rows are copied without
+// being parsed beyond their id and key.
+// ---------------------------------------------------------------------------
+
+struct change {
+    int id;
+    char op;          // 'U' for inserts and updates, 'D' for deletes
+    int seq;          // position in the changeset: the last change to an id wins
+    int found;        // the id was in the sorted file
+    struct listing item;
+};
+
+int compareChangeById(const void *a, const void *b) {
+    const struct change *c1 = (const struct change *)a;
+    const struct change *c2 = (const struct change *)b;
+    if (c1->id != c2->id) return (c1->id > c2->id) - (c1->id < c2->id);
+    return (c1->seq > c2->seq) - (c1->seq < c2->seq);
+}
+
+// Read the changeset, sorted by id with one change per id; returns the count
+int readChanges(const char *filename, struct change **out) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        perror("Error opening changeset");
+        exit(1);
+    }
+    char line[MAX_LINE];
+    struct change *changes = NULL;
+    int count = 0, cap = 0, lineno = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        char op = line[0];
+        if ((op != 'I' && op != 'U' && op != 'D') || line[1] != ',') {
+            fprintf(stderr, "%s:%d: expected I, U or D and a comma\n", filename, lineno);
+            exit(1);
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 256;
+            changes = realloc(changes, cap * sizeof(struct change));
+            if (changes == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        struct change *c = &changes[count];
+        memset(c, 0, sizeof(*c));
+        c->op = op == 'D' ? 'D' : 'U';
+        c->seq = count;
+        if (op == 'D') {
+            c->id = atoi(line + 2);
+        } else {
+            int fields = 1;
+            for (const char *p = line + 2; *p; p++) fields += *p == ',';
+            if (fields != 13) {
+                fprintf(stderr, "%s:%d: a listing needs 13 fields\n", filename, lineno);
+                exit(1);
+            }
+            c->item = getfields(line + 2);
+            c->id = c->item.id;
+        }
+        count++;
+    }
+    fclose(fp);
+
+    // keep only the last change to each id
+    qsort(changes, count, sizeof(struct change), compareChangeById);
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (kept > 0 && changes[kept - 1].id == changes[i].id) kept--;
+        changes[kept++] = changes[i];
+    }
+    *out = changes;
+    return kept;
+}
+
+struct change *findChange(struct change *changes, int count, int id) {
+    struct change key;
+    key.id = id;
+    key.seq = -1;
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (compareChangeById(&changes[mid], &key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < count && changes[lo].id == id ? &changes[lo] : NULL;
+}
+
+// Start of the n-th (0-based) comma-separated field of a row
+const char *fieldAt(const char *line, int n) {
+    while (n-- > 0) {
+        line = strchr(line, ',');
+        if (line == NULL) return "";
+        line++;
+    }
+    return line;
+}
+
+// Compare a new listing with a row of the sorted file by that file's key,
+// the same way compareByHostName/compareByPrice order them
+int compareItemToRow(const struct listing *item, const char *row, int byPrice) {
+    if (byPrice) {
+        float price = atof(fieldAt(row, 8));
+        if (item->price < price) return -1;
+        else if (item->price > price) return 1;
+        else return 0;
+    }
+    const char *host = fieldAt(row, 2);
+    size_t len = strcspn(host, ",\n");
+    int c = strncmp(item->host_name, host, len);
+    if (c != 0) return c;
+    return item->host_name[len] != '\0';
+}
+
+// Stream filename into filename.tmp with the changes applied, then rename it
+// over the original. items are the new rows, already sorted by the file's
+// key. Returns the number of rows written.
+int mergeSortedFile(const char *filename, struct change *changes, int nchanges,
+                    struct listing *items, int nitems, int byPrice) {
+    char tmpname[MAX_LINE];
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+    FILE *in = fopen(filename, "r");
+    if (in == NULL) {
+        perror("Error opening sorted file (run lab6 without -d first)");
+        exit(1);
+    }
+    FILE *out = fopen(tmpname, "w");
+    if (out == NULL) {
+        perror("Error opening output file");
+        exit(1);
+    }
+    char line[MAX_LINE];
+    int next = 0, rows = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        struct change *c = findChange(changes, nchanges, atoi(line));
+        if (c != NULL) {
+            c->found = 1;
+            continue;
+        }
+        // on equal keys the existing rows stay first
+        while (next < nitems && compareItemToRow(&items[next], line, byPrice) < 0) {
+            writeListing(out, &items[next++]);
+            rows++;
+        }
+        fputs(line, out);
+        rows++;
+    }
+    for (; next < nitems; next++, rows++) writeListing(out, &items[next]);
+    fclose(in);
+    if (fclose(out) != 0 || rename(tmpname, filename) != 0) {
+        perror("Error writing output file");
+        exit(1);
+    }
+    return rows;
+}
+
+int applyDelta(const char *changesFile) {
+    struct change *changes;
+    int nchanges = readChanges(changesFile, &changes);
+    printf("Read %d changes from %s\n", nchanges, changesFile);
+
+    struct listing *items = malloc((nchanges ? nchanges : 1) * sizeof(struct listing));
+    if (items == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    int nitems = 0;
+    for (int i = 0; i < nchanges; i++)
+        if (changes[i].op == 'U') items[nitems++] = changes[i].item;
+
+    qsort(items, nitems, sizeof(struct listing), compareByHostName);
+    int rows = mergeSortedFile("sorted_by_host.csv", changes, nchanges, items, nitems, 0);
+    printf("Merged into sorted_by_host.csv (%d records)\n", rows);
+
+    int inserted = 0, updated = 0, deleted = 0, missing = 0;
+    for (int i = 0; i < nchanges; i++) {
+        if (changes[i].op == 'U') {
+            if (changes[i].found) updated++;
+            else inserted++;
+        } else {
+            if (changes[i].found) deleted++;
+            else missing++;
+        }
+    }
+
+    qsort(items, nitems, sizeof(struct listing), compareByPrice);
+    rows = mergeSortedFile("sorted_by_price.csv", changes, nchanges, items, nitems, 1);
+    printf("Merged into sorted_by_price.csv (%d records)\n", rows);
+
+    printf("%d inserted, %d updated, %d deleted\n", inserted, updated, deleted);
+    if (missing > 0) fprintf(stderr, "%d deletes named ids that were not listed\n", missing);
+
+    free(items);
+    free(changes);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Query mode (-c N, -e N, -p list, -a)
+//
+// listings.csv is streamed once and nothing is fully sorted:
+//   -c N / -e N  the N cheapest / most expensive listings, kept in an N-entry
+//                heap whose root is the worst one kept: O(n log N)
+//   -p list      price percentiles per neighbourhood, e.g. -p 50,90,99, by
+//                introselect over each neighbourhood's prices: O(n) expected
+//   -a           with -p: summarize each neighbourhood in a t-digest instead,
+//                a fixed amount of memory however many rows stream past
+// Percentiles interpolate between the two nearest ranks, so -p 50 of an
+// even count is the mean of the middle two prices.
+// ---------------------------------------------------------------------------
+
+#define MAX_PERCENTILES 16
+#define TDIGEST_COMPRESSION 100
+#define TDIGEST_CENTROIDS (2 * TDIGEST_COMPRESSION)
+#define TDIGEST_BUFFER 512
+
+struct ranked {
+    float price;
+    int id;
+    char *line;       // the row as read, parsed only if it is printed
+};
+
+// Merging t-digest: points are buffered, then sorted in with the centroids
+// and merged left to right. A centroid may span at most one unit of
+// k(q) = d / (2 pi) * asin(2q - 1), which is steep near q = 0 and q = 1, so
+// tail centroids stay small and extreme percentiles stay sharp. The k range
+// is d / 2 wide, which bounds the centroids to about d.
+struct centroid {
+    double mean, weight;
+};
+
+struct tdigest {
+    struct centroid c[TDIGEST_CENTROIDS + TDIGEST_BUFFER];
+    int merged, buffered;
+    double total, min, max;
+};
+
+struct neighbourhood {
+    char *name;
+    float *prices;            // exact mode
+    int count, cap;
+    struct tdigest *digest;   // -a
+};
+
+struct query {
+    int cheapest, expensive;
+    double pct[MAX_PERCENTILES];  // ascending
+    int npct;
+    int approx;
+};
+
+// Is a worse than b: pricier for -c, cheaper for -e. Ties go by id so the
+// same listings come out on every run.
+int rankedWorse(const struct ranked *a, const struct ranked *b, int wantCheap) {
+    if (a->price != b->price) return wantCheap ? a->price > b->price : a->price < b->price;
+    return a->id > b->id;
+}
+
+void heapSiftDown(struct ranked *heap, int n, int i, int wantCheap) {
+    for (;;) {
+        int worst = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && rankedWorse(&heap[l], &heap[worst], wantCheap)) worst = l;
+        if (r < n && rankedWorse(&heap[r], &heap[worst], wantCheap)) worst = r;
+        if (worst == i) return;
+        struct ranked t = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = t;
+        i = worst;
+    }
+}
+
+// Offer a listing to a heap of at most k; the line is copied only if kept
+void heapOffer(struct ranked *heap, int *n, int k, float price, int id, const char *line, int wantCheap) {
+    struct ranked r = { price, id, NULL };
+    if (k == 0) return;
+    if (*n == k) {
+        if (!rankedWorse(&heap[0], &r, wantCheap)) return;
+        free(heap[0].line);
+        heap[0] = heap[--*n];
+        heapSiftDown(heap, *n, 0, wantCheap);
+    }
+    r.line = strdup(line);
+    if (r.line == NULL) {
+        perror("strdup");
+        exit(1);
+    }
+    int i = (*n)++;
+    while (i > 0 && rankedWorse(&r, &heap[(i - 1) / 2], wantCheap)) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = r;
+}
+
+// Print the heap best first, in the sorted_by_price.csv row format
+void heapPrint(struct ranked *heap, int n, int wantCheap) {
+    // moving the root (the worst) behind the heap each time leaves the
+    // array ordered best first
+    for (int end = n - 1; end > 0; end--) {
+        struct ranked t = heap[0];
+        heap[0] = heap[end];
+        heap[end] = t;
+        heapSiftDown(heap, end, 0, wantCheap);
+    }
+    for (int i = 0; i < n; i++) {
+        struct listing item = getfields(heap[i].line);
+        writeListing(stdout, &item);
+        free(heap[i].line);
+    }
+}
+
+int compareFloat(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Put the k-th smallest of a[0, n) at a[k], smaller ones before it and
+// larger ones after. Quickselect with median-of-three pivots; if about
+// 2 log2(n) partitions have not narrowed it down, the rest is sorted, so
+// the worst case stays O(n log n) (introselect).
+void selectKth(float *a, int n, int k) {
+    int lo = 0, hi = n - 1, budget = 2;
+    for (int m = n; m > 1; m >>= 1) budget += 2;
+    while (hi > lo) {
+        if (budget-- == 0) {
+            qsort(a + lo, hi - lo + 1, sizeof(float), compareFloat);
+            return;
+        }
+        int mid = lo + (hi - lo) / 2;
+        float t;
+        if (a[mid] < a[lo]) { t = a[mid]; a[mid] = a[lo]; a[lo] = t; }
+        if (a[hi] < a[lo]) { t = a[hi]; a[hi] = a[lo]; a[lo] = t; }
+        if (a[hi] < a[mid]) { t = a[hi]; a[hi] = a[mid]; a[mid] = t; }
+        float pivot = a[mid];
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (a[i] < pivot) i++;
+            while (a[j] > pivot) j--;
+            if (i <= j) {
+                t = a[i]; a[i] = a[j]; a[j] = t;
+                i++;
+                j--;
+            }
+        }
+        // a[lo..j] <= pivot, a[i..hi] >= pivot, and anything between equals it
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else return;
+    }
+}
+
+// Percentiles pct[0, npct) (ascending) of a[0, n) into out; a is reordered.
+// Each selection only searches above the previous rank.
+void exactPercentiles(float *a, int n, const double *pct, int npct, double *out) {
+    int from = 0;
+    for (int p = 0; p < npct; p++) {
+        double pos = pct[p] / 100 * (n - 1);
+        int r = (int)pos;
+        selectKth(a + from, n - from, r - from);
+        from = r;
+        out[p] = a[r];
+        if (pos > r) {
+            float next = a[r + 1];
+            for (int i = r + 2; i < n; i++)
+                if (a[i] < next) next = a[i];
+            out[p] += (pos - r) * (next - a[r]);
+        }
+    }
+}
+
+int compareCentroid(const void *a, const void *b) {
+    const struct centroid *c1 = (const struct centroid *)a;
+    const struct centroid *c2 = (const struct centroid *)b;
+    return (c1->mean > c2->mean) - (c1->mean < c2->mean);
+}
+
+// Largest q a centroid starting at q0 may reach: k(q) = k(q0) + 1
+double tdigestLimit(double q0) {
+    double k = TDIGEST_COMPRESSION / (2 * M_PI) * asin(2 * q0 - 1) + 1;
+    if (k >= TDIGEST_COMPRESSION / 4.0) return 1;
+    return (sin(k * 2 * M_PI / TDIGEST_COMPRESSION) + 1) / 2;
+}
+
+void tdigestMerge(struct tdigest *t) {
+    if (t->buffered == 0) return;
+    int n = t->merged + t->buffered, out = 0;
+    qsort(t->c, n, sizeof(struct centroid), compareCentroid);
+    double before = 0, limit = tdigestLimit(0) * t->total;
+    struct centroid cur = t->c[0];
+    for (int i = 1; i < n; i++) {
+        if (before + cur.weight + t->c[i].weight <= limit) {
+            cur.weight += t->c[i].weight;
+            cur.mean += (t->c[i].mean - cur.mean) * t->c[i].weight / cur.weight;
+        } else {
+            before += cur.weight;
+            t->c[out++] = cur;
+            limit = tdigestLimit(before / t->total) * t->total;
+            cur = t->c[i];
+        }
+    }
+    t->c[out++] = cur;
+    t->merged = out;
+    t->buffered = 0;
+}
+
+void tdigestAdd(struct tdigest *t, double x) {
+    if (t->merged + t->buffered == TDIGEST_CENTROIDS + TDIGEST_BUFFER) tdigestMerge(t);
+    if (t->total == 0 || x < t->min) t->min = x;
+    if (t->total == 0 || x > t->max) t->max = x;
+    t->c[t->merged + t->buffered++] = (struct centroid){ x, 1 };
+    t->total += 1;
+}
+
+// Each centroid's weight is taken to be spread evenly around its mean, so
+// weight w centred at cumulative rank c covers ranks c - w/2 to c + w/2;
+// a digest of single points then gives the exact interpolated percentile.
+double tdigestPercentile(struct tdigest *t, double pct) {
+    tdigestMerge(t);
+    double target = pct / 100 * (t->total - 1) + 0.5;
+    double cum = 0, prevCentre = 0, prevMean = t->min;
+    for (int i = 0; i < t->merged; i++) {
+        double centre = cum + t->c[i].weight / 2;
+        if (target <= centre) {
+            if (centre == prevCentre) return t->c[i].mean;
+            return prevMean + (t->c[i].mean - prevMean) * (target - prevCentre) / (centre - prevCentre);
+        }
+        cum += t->c[i].weight;
+        prevCentre = centre;
+        prevMean = t->c[i].mean;
+    }
+    if (t->total == prevCentre) return t->max;
+    return prevMean + (t->max - prevMean) * (target - prevCentre) / (t->total - prevCentre);
+}
+
+// Neighbourhoods by name: open addressing over an index, linear probing
+struct neighbourhood *hoods = NULL;
+int nhoods = 0, hoodCap = 0;
+int *hoodIndex = NULL;    // -1 for an empty slot; 2 * hoodCap slots
+
+unsigned hashName(const char *s, size_t len) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+struct neighbourhood *findNeighbourhood(const char *name, size_t len) {
+    unsigned mask = 2 * hoodCap - 1;
+    if (hoodCap > 0) {
+        for (unsigned j = hashName(name, len) & mask; hoodIndex[j] >= 0; j = (j + 1) & mask) {
+            struct neighbourhood *h = &hoods[hoodIndex[j]];
+            if (strncmp(h->name, name, len) == 0 && h->name[len] == '\0') return h;
+        }
+    }
+    if (nhoods == hoodCap) {
+        hoodCap = hoodCap ? hoodCap * 2 : 64;
+        hoods = realloc(hoods, hoodCap * sizeof(struct neighbourhood));
+        free(hoodIndex);
+        hoodIndex = malloc(2 * hoodCap * sizeof(int));
+        if (hoods == NULL || hoodIndex == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+        mask = 2 * hoodCap - 1;
+        memset(hoodIndex, -1, 2 * hoodCap * sizeof(int));
+        for (int i = 0; i < nhoods; i++) {
+            unsigned j = hashName(hoods[i].name, strlen(hoods[i].name)) & mask;
+            while (hoodIndex[j] >= 0) j = (j + 1) & mask;
+            hoodIndex[j] = i;
+        }
+    }
+    unsigned j = hashName(name, len) & mask;
+    while (hoodIndex[j] >= 0) j = (j + 1) & mask;
+    hoodIndex[j] = nhoods;
+    struct neighbourhood *h = &hoods[nhoods++];
+    memset(h, 0, sizeof(*h));
+    h->name = strndup(name, len);
+    if (h->name == NULL) {
+        perror("strndup");
+        exit(1);
+    }
+    return h;
+}
+
+void addPrice(struct neighbourhood *h, float price, int approx) {
+    if (approx) {
+        if (h->digest == NULL && (h->digest = calloc(1, sizeof(struct tdigest))) == NULL) {
+            perror("calloc");
+            exit(1);
+        }
+        tdigestAdd(h->digest, price);
+        h->count++;
+        return;
+    }
+    if (h->count == h->cap) {
+        h->cap = h->cap ? h->cap * 2 : 16;
+        h->prices = realloc(h->prices, h->cap * sizeof(float));
+        if (h->prices == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    h->prices[h->count++] = price;
+}
+
+int compareNeighbourhood(const void *a, const void *b) {
+    return strcmp(((const struct neighbourhood *)a)->name, ((const struct neighbourhood *)b)->name);
+}
+
+int runQuery(struct query *q) {
+    FILE *fptr = fopen("listings.csv", "r");
+    if (fptr == NULL) {
+        perror("Error opening listings.csv");
+        return 1;
+    }
+    struct ranked *cheap = malloc((q->cheapest + 1) * sizeof(struct ranked));
+    struct ranked *dear = malloc((q->expensive + 1) * sizeof(struct ranked));
+    if (cheap == NULL || dear == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    int ncheap = 0, ndear = 0, count = 0;
+    char line[MAX_LINE];
+
+    // Skip header line if it exists
+    fgets(line, sizeof(line), fptr);
+    while (fgets(line, sizeof(line), fptr) != NULL) {
+        int id = atoi(line);
+        float price = atof(fieldAt(line, 8));
+        heapOffer(cheap, &ncheap, q->cheapest, price, id, line, 1);
+        heapOffer(dear, &ndear, q->expensive, price, id, line, 0);
+        if (q->npct > 0) {
+            const char *name = fieldAt(line, 4);
+            addPrice(findNeighbourhood(name, strcspn(name, ",\r\n")), price, q->approx);
+        }
+        count++;
+    }
+    fclose(fptr);
+    printf("Read %d records from listings.csv\n", count);
+
+    if (q->cheapest > 0) {
+        printf("Cheapest %d listings:\n", ncheap);
+        heapPrint(cheap, ncheap, 1);
+    }
+    if (q->expensive > 0) {
+        printf("Most expensive %d listings:\n", ndear);
+        heapPrint(dear, ndear, 0);
+    }
+    free(cheap);
+    free(dear);
+
+    if (q->npct > 0) {
+        // hoods is no longer looked up by name, so it can be reordered
+        qsort(hoods, nhoods, sizeof(struct neighbourhood), compareNeighbourhood);
+        printf("neighbourhood,count");
+        for (int p = 0; p < q->npct; p++) printf(",p%g", q->pct[p]);
+        printf("%s\n", q->approx ? " (t-digest)" : "");
+        for (int i = 0; i < nhoods; i++) {
+            struct neighbourhood *h = &hoods[i];
+            double out[MAX_PERCENTILES];
+            if (q->approx) {
+                for (int p = 0; p < q->npct; p++) out[p] = tdigestPercentile(h->digest, q->pct[p]);
+            } else {
+                exactPercentiles(h->prices, h->count, q->pct, q->npct, out);
+            }
+            printf("%s,%d", h->name, h->count);
+            for (int p = 0; p < q->npct; p++) printf(",%.2f", out[p]);
+            printf("\n");
+            free(h->prices);
+            free(h->digest);
+            free(h->name);
+        }
+        free(hoods);
+        free(hoodIndex);
+    }
+    return 0;
+}
+
+int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Parse "50,90,99.9" into q->pct, sorted; returns 0 or -1
+int parsePercentiles(const char *list, struct query *q) {
+    const char *p = list;
+    while (*p) {
+        char *end;
+        double v = strtod(p, &end);
+        if (end == p || v < 0 || v > 100 || q->npct == MAX_PERCENTILES) return -1;
+        q->pct[q->npct++] = v;
+        if (*end == ',') end++;
+        else if (*end != '\0') return -1;
+        p = end;
+    }
+    if (q->npct == 0) return -1;
+    qsort(q->pct, q->npct, sizeof(double), compareDouble);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
     FILE *fptr;
     char line[MAX_LINE];
     struct listing list_items[MAX_LISTINGS];
     int count = 0;
 
+    // Delta mode: merge a changeset into the existing sorted files
+    if (argc == 3 && strcmp(argv[1], "-d") == 0) return applyDelta(argv[2]);
+
+    // Query mode: top-k and percentiles without sorting everything
+    struct query q = { 0 };
+    int querying = 0;
+    for (int i = 1; i < argc; i++) {
+        int ok = 1;
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            q.cheapest = atoi(argv[++i]);
+            ok = q.cheapest > 0;
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            q.expensive = atoi(argv[++i]);
+            ok = q.expensive > 0;
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            ok = parsePercentiles(argv[++i], &q) == 0;
+        } else if (strcmp(argv[i], "-a") == 0) {
+            q.approx = 1;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Usage: %s [-d changes.csv | [-c N] [-e N] [-p 50,90,...] [-a]]\n", argv[0]);
+            return 1;
+        }
+        querying = 1;
+    }
+    if (querying) return runQuery(&q);
+
     // Open file
     fptr = fopen("listings.csv", "r");
     if (fptr == NULL) {
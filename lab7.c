@@ -1,4 +1,4 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,9 +8,23 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
 
 #define MAX_LINE 4096
 #define MAX_ARGS 128
+#define MAX_PROCS 256           /* running copies plus ones being cancelled */
+#define SPEC_MIN_SEC 0.01       /* never speculate on a command younger than this */
+#define POLL_TICK_MS 10         /* wait granularity for children without a pidfd */
+
+/* Straggler handling, from the command line (see usage()) */
+static double opt_timeout = 0;      /* -t: seconds before SIGTERM, 0 = none */
+static double opt_grace = 5;        /* -k: seconds from SIGTERM to SIGKILL */
+static double opt_percentile = 95;  /* -p: speculate past this percentile ... */
+static int opt_min_peers = 5;       /* -m: ... of at least this many finished peers */
 
 /* Trim leading and trailing whitespace in place */
 static void trim_inplace(char *s) {
@@ -46,13 +60,254 @@ static void ctime_no_nl(time_t t, char *outbuf, size_t outbuf_size) {
     outbuf[n] = '\0';
 }
 
+/* ---- Timeouts and speculative re-execution ----
+   Commands still run one at a time, but the parent no longer blocks in
+   waitpid(): every child gets a pidfd, and poll() on the pidfds wakes the
+   parent when a child exits or when the next deadline is due:
+     - timeout (-t or @timeout=N): SIGTERM, then SIGKILL opt_grace seconds
+       later if the child is still alive;
+     - speculation (@idempotent): once the command has run longer than the
+       opt_percentile-th percentile of the commands finished so far, a
+       second copy is started. Whichever copy exits first is the result and
+       the other is cancelled with the same SIGTERM/SIGKILL escalation.
+   A cancelled copy is reaped in the background while the next commands run.
+   Every command runs in its own process group, so signals also reach the
+   processes it started (a shell script's children). The leader is signalled
+   through pidfd_send_signal() and the group with kill(-pid); both happen
+   before the leader is reaped, while its pid can't have been recycled. */
+
+struct job {
+    char *text;                 /* command text for the log */
+    char **argv;
+    double timeout;             /* 0 = none */
+    int idempotent;
+    double started;
+    int done, timed_out, copy_won;
+};
+
+struct proc {
+    pid_t pid;
+    int pidfd;                  /* -1 if pidfd_open() is not available */
+    struct job *job;            /* NULL once cancelled */
+    int is_copy;
+    double term_at;             /* SIGTERM due (0 = never) */
+    double kill_at;             /* SIGKILL due after SIGTERM (0 = not yet) */
+};
+
+static struct proc procs[MAX_PROCS];
+static int nprocs = 0;
+
+static double *peer_secs = NULL;    /* run times of the finished commands */
+static int npeers = 0, peer_cap = 0;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int pidfd_open_pid(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static void send_signal(struct proc *p, int sig) {
+#ifdef SYS_pidfd_send_signal
+    if (p->pidfd >= 0) syscall(SYS_pidfd_send_signal, p->pidfd, sig, NULL, 0);
+    else
+#endif
+    kill(p->pid, sig);
+    kill(-p->pid, sig);     /* the rest of its process group */
+}
+
+/* SIGTERM now, SIGKILL after the grace period */
+static void terminate(struct proc *p, double now) {
+    if (p->kill_at > 0) return;
+    TRACE_INSTANT("SIGTERM");
+    send_signal(p, SIGTERM);
+    p->term_at = 0;
+    p->kill_at = now + opt_grace;
+}
+
+static int start_proc(struct job *job, int is_copy, unsigned long lineno) {
+    if (nprocs == MAX_PROCS) {
+        errno = EAGAIN;
+        return -1;
+    }
+    TRACE_INSTANT(is_copy ? "spawn copy" : "spawn");
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        /* Child process: own process group, then execute the command */
+        setpgid(0, 0);
+        execvp(job->argv[0], job->argv);
+        /* If execvp returns, it failed. Print a message and exit. */
+        fprintf(stderr, "execvp failed on line %lu: %s : %s\n", lineno, job->text, strerror(errno));
+        _exit(127); /* conventional exit code for exec failure */
+    }
+    setpgid(pid, pid);      /* also here, so the group exists before any signal */
+    struct proc *p = &procs[nprocs++];
+    p->pid = pid;
+    p->pidfd = pidfd_open_pid(pid);
+    p->job = job;
+    p->is_copy = is_copy;
+    p->term_at = job->timeout > 0 ? job->started + job->timeout : 0;
+    p->kill_at = 0;
+    TRACE_COUNTER("children", nprocs);
+    return 0;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Run time past which an idempotent command gets a copy, or 0 if there
+   are too few peers to tell */
+static double speculation_threshold(void) {
+    if (npeers < opt_min_peers || npeers == 0) return 0;
+    double *sorted = malloc(npeers * sizeof(double));
+    if (sorted == NULL) return 0;
+    memcpy(sorted, peer_secs, npeers * sizeof(double));
+    qsort(sorted, npeers, sizeof(double), compare_double);
+    double pos = opt_percentile / 100 * (npeers - 1);
+    int r = (int)pos;
+    double t = sorted[r];
+    if (r + 1 < npeers) t += (pos - r) * (sorted[r + 1] - sorted[r]);
+    free(sorted);
+    return t > SPEC_MIN_SEC ? t : SPEC_MIN_SEC;
+}
+
+static void add_peer(double secs) {
+    if (npeers == peer_cap) {
+        peer_cap = peer_cap ? peer_cap * 2 : 64;
+        double *p = realloc(peer_secs, peer_cap * sizeof(double));
+        if (p == NULL) return;
+        peer_secs = p;
+    }
+    peer_secs[npeers++] = secs;
+}
+
+/* A child exited: settle its job if it was the first copy to finish */
+static void proc_exited(int i, double now) {
+    struct proc *p = &procs[i];
+    struct job *job = p->job;
+    if (p->pidfd >= 0) close(p->pidfd);
+    if (job != NULL && !job->done) {
+        job->done = 1;
+        job->copy_won = p->is_copy;
+        /* the other copy, if any, is no longer needed */
+        for (int j = 0; j < nprocs; j++) {
+            if (j != i && procs[j].job == job) {
+                procs[j].job = NULL;
+                terminate(&procs[j], now);
+            }
+        }
+    }
+    procs[i] = procs[--nprocs];
+    TRACE_INSTANT("child exit");
+    TRACE_COUNTER("children", nprocs);
+}
+
+/* Wait for children until job is done (or, with job == NULL, until every
+   child is gone), acting on deadlines as they come up */
+static void wait_children(struct job *job, unsigned long lineno) {
+    double spec_at = 0;
+    if (job != NULL && job->idempotent) {
+        double t = speculation_threshold();
+        if (t > 0) spec_at = job->started + t;
+    }
+    while (job != NULL ? !job->done : nprocs > 0) {
+        double now = now_sec(), next = 0;
+        int tick = 0;
+        struct pollfd fds[MAX_PROCS];
+        for (int i = 0; i < nprocs; i++) {
+            struct proc *p = &procs[i];
+            double due = p->kill_at > 0 ? p->kill_at : p->term_at;
+            if (due > 0 && (next == 0 || due < next)) next = due;
+            fds[i].fd = p->pidfd;       /* poll() skips negative fds */
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+            if (p->pidfd < 0) tick = 1;
+        }
+        if (spec_at > 0 && (next == 0 || spec_at < next)) next = spec_at;
+        int ms = -1;
+        if (next > 0) ms = next <= now ? 0 : (int)((next - now) * 1000) + 1;
+        if (tick && (ms < 0 || ms > POLL_TICK_MS)) ms = POLL_TICK_MS;
+        TRACE_BEGIN("poll");
+        int pr = poll(fds, nprocs, ms);
+        TRACE_END("poll");
+        if (pr < 0 && errno != EINTR) {
+            perror("poll");
+            exit(1);
+        }
+
+        now = now_sec();
+        for (int i = nprocs - 1; i >= 0; i--) {
+            int status;
+            if (fds[i].revents == 0 && procs[i].pidfd >= 0) continue;
+            /* A stopped command's leader may go before its group does: kill
+               whatever is left while the unreaped leader still pins the pgid */
+            siginfo_t si;
+            si.si_pid = 0;
+            if (procs[i].kill_at > 0 && waitid(P_PID, procs[i].pid, &si, WEXITED | WNOHANG | WNOWAIT) == 0 &&
+                si.si_pid == procs[i].pid)
+                kill(-procs[i].pid, SIGKILL);
+            pid_t w = waitpid(procs[i].pid, &status, procs[i].pidfd >= 0 ? 0 : WNOHANG);
+            if (w == procs[i].pid || (w < 0 && errno == ECHILD)) {
+                if (procs[i].job != NULL && procs[i].job->timed_out == 0 && procs[i].kill_at > 0)
+                    procs[i].job->timed_out = 1;
+                proc_exited(i, now);
+            }
+        }
+        if (job != NULL && job->done) break;
+
+        if (spec_at > 0 && now >= spec_at) {
+            spec_at = 0;
+            if (start_proc(job, 1, lineno) != 0) perror("fork speculative copy");
+        }
+        for (int i = 0; i < nprocs; i++) {
+            struct proc *p = &procs[i];
+            if (p->term_at > 0 && now >= p->term_at) {
+                terminate(p, now);
+                if (p->job != NULL) spec_at = 0;    /* a copy would get the same deadline */
+            } else if (p->kill_at > 0 && now >= p->kill_at) {
+                TRACE_INSTANT("SIGKILL");
+                send_signal(p, SIGKILL);
+                p->kill_at = now + opt_grace;       /* and again, should SIGKILL ever be lost */
+            }
+        }
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-t timeout] [-k grace] [-p percentile] [-m peers] <commands-file>\n", prog);
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <commands-file>\n", argv[0]);
+    int opt;
+    while ((opt = getopt(argc, argv, "t:k:p:m:")) != -1) {
+        switch (opt) {
+        case 't': opt_timeout = atof(optarg); break;
+        case 'k': opt_grace = atof(optarg); break;
+        case 'p': opt_percentile = atof(optarg); break;
+        case 'm': opt_min_peers = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind != argc - 1 || opt_timeout < 0 || opt_grace < 0 || opt_percentile < 0 || opt_percentile > 100) {
+        usage(argv[0]);
         return 1;
     }
 
-    const char *infilename = argv[1];
+    trace_init("lab7");
+
+    const char *infilename = argv[optind];
     FILE *infile = fopen(infilename, "r");
     if (infile == NULL) {
         perror("fopen input file");
@@ -88,7 +343,17 @@ int main(int argc, char *argv[]) {
         char *arglist[MAX_ARGS];
         int argcount = 0;
 
+        /* Leading @ words are directives for lab7, not part of the command:
+           @timeout=N overrides -t, @idempotent allows a speculative copy */
+        struct job job = { cmdtext, arglist, opt_timeout, 0, 0, 0, 0, 0 };
         char *token = strtok(line, " \t");
+        while (token != NULL && token[0] == '@') {
+            if (strncmp(token, "@timeout=", 9) == 0) job.timeout = atof(token + 9);
+            else if (strcmp(token, "@idempotent") == 0) job.idempotent = 1;
+            else fprintf(stderr, "line %lu: unknown directive %s\n", lineno, token);
+            token = strtok(NULL, " \t");
+        }
+        if (token != NULL) job.text = cmdtext + (token - line);
         while (token != NULL && argcount < (MAX_ARGS - 1)) {
             arglist[argcount++] = token;
             token = strtok(NULL, " \t");
@@ -100,43 +365,48 @@ int main(int argc, char *argv[]) {
 
         /* Record start time */
         time_t start_time = time(NULL);
+        job.started = now_sec();
+        TRACE_BEGIN("command");
 
-        pid_t pid = fork();
-        if (pid < 0) {
+        if (start_proc(&job, 0, lineno) != 0) {
             /* fork failed */
             perror("fork");
             /* Log failure with start time and end time same as "fork_failed" text */
             char startstr[64];
             ctime_no_nl(start_time, startstr, sizeof(startstr));
-            fprintf(logfile, "%s\t%s\t%s\n", cmdtext, startstr, "fork_failed");
+            fprintf(logfile, "%s\t%s\t%s\n", job.text, startstr, "fork_failed");
             fflush(logfile);
+            TRACE_END("command");
             continue;
-        } else if (pid == 0) {
-            /* Child process: execute the command */
-            execvp(arglist[0], arglist);
-            /* If execvp returns, it failed. Print a message and exit. */
-            fprintf(stderr, "execvp failed on line %lu: %s : %s\n", lineno, cmdtext, strerror(errno));
-            _exit(127); /* conventional exit code for exec failure */
-        } else {
-            /* Parent process: wait for child to finish */
-            int status;
-            pid_t w = waitpid(pid, &status, 0);
-            (void)w; 
+        }
 
-            /* Record end time */
-            time_t end_time = time(NULL);
+        /* Parent process: wait for the first copy to finish or time out */
+        wait_children(&job, lineno);
+        TRACE_END("command");
+        if (!job.timed_out) add_peer(now_sec() - job.started);
 
-            /* Format times and write to log:
-               <command>\t<start_time>\t<end_time>\n */
-            char startstr[64], endstr[64];
-            ctime_no_nl(start_time, startstr, sizeof(startstr));
-            ctime_no_nl(end_time, endstr, sizeof(endstr));
+        /* Record end time */
+        time_t end_time = time(NULL);
 
-            fprintf(logfile, "%s\t%s\t%s\n", cmdtext, startstr, endstr);
-            fflush(logfile);
-        }
+        /* Format times and write to log:
+           <command>\t<start_time>\t<end_time>[\t<note>]\n */
+        char startstr[64], endstr[64];
+        ctime_no_nl(start_time, startstr, sizeof(startstr));
+        ctime_no_nl(end_time, endstr, sizeof(endstr));
+
+        fprintf(logfile, "%s\t%s\t%s", job.text, startstr, endstr);
+        if (job.timed_out) fprintf(logfile, "\ttimed_out");
+        else if (job.copy_won) fprintf(logfile, "\tspeculative_copy");
+        fprintf(logfile, "\n");
+        fflush(logfile);
     }
 
+    /* reap copies still being cancelled */
+    TRACE_BEGIN("reap cancelled");
+    wait_children(NULL, lineno);
+    TRACE_END("reap cancelled");
+    free(peer_secs);
+
     fclose(infile);
     fclose(logfile);
 
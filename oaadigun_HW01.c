@@ -1,7 +1,27 @@
+/*
+CS 332/532 – Systems Programming
+Oladotun Adigun
+
+How to compile:
+    gcc -O2 -o hw01 oaadigun_HW01.c kernels.c parallel.c trace.c -lpthread -lm
+
+How to run:
+    ./hw01                  run the examples for every function
+    ./hw01 -B <n>           time scalar loops against the kernels on n ints / n bytes
+    ./hw01 -B <n> -t <k>    ... with k threads for the threaded kernels (default: all CPUs)
+
+UABMaxMinDiff, replaceEvenWithZero and countVowels run on the vectorized
+kernels in kernels.c; the scalar loops they replaced are kept below as the
+reference the benchmark checks them against. */
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
+
+#include "kernels.h"
 
 // 1. sumOfDigits
 int sumOfDigits(int n) {
@@ -19,24 +39,13 @@ int sumOfDigits(int n) {
 // 2. UABMaxMinDiff
 int UABMaxMinDiff(int arr[], int size) {
     if (size <= 0) return 0; // edge case
-    int max = arr[0];
-    int min = arr[0];
-    for (int i = 1; i < size; i++) {
-        if (arr[i] > max) max = arr[i];
-        if (arr[i] < min) min = arr[i];
-    }
-    return max - min;
+    return (int)kern_max_min_diff(arr, (size_t)size, NULL);
 }
 
 // 3. replaceEvenWithZero
 void replaceEvenWithZero(int arr[], int size, int result[]) {
-    for (int i = 0; i < size; i++) {
-        if (arr[i] % 2 == 0) {
-            result[i] = 0;
-        } else {
-            result[i] = arr[i];
-        }
-    }
+    if (size <= 0) return;
+    kern_replace_even_with_zero(arr, (size_t)size, result, NULL);
 }
 
 // 4. perfectSquare
@@ -50,9 +59,35 @@ int perfectSquare(int n) {
 
 // 5. countVowels
 int countVowels(char s[]) {
-    int count = 0;
-    for (int i = 0; s[i] != '\0'; i++) {
-        char c = tolower(s[i]);
+    return (int)kern_count_vowels(s, strlen(s), NULL);
+}
+
+// --- SCALAR REFERENCES AND BENCHMARK ---
+
+static long long max_min_diff_scalar(const int *arr, size_t size) {
+    int max = arr[0];
+    int min = arr[0];
+    for (size_t i = 1; i < size; i++) {
+        if (arr[i] > max) max = arr[i];
+        if (arr[i] < min) min = arr[i];
+    }
+    return (long long)max - min;
+}
+
+static void replace_even_scalar(const int *arr, size_t size, int *result) {
+    for (size_t i = 0; i < size; i++) {
+        if (arr[i] % 2 == 0) {
+            result[i] = 0;
+        } else {
+            result[i] = arr[i];
+        }
+    }
+}
+
+static size_t count_vowels_scalar(const char *s, size_t n) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        char c = tolower((unsigned char)s[i]);
         if (c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u') {
             count++;
         }
@@ -60,9 +95,134 @@ int countVowels(char s[]) {
     return count;
 }
 
+static long long sum_of_digits_scalar(const int *arr, size_t size, int *result) {
+    long long total = 0;
+    for (size_t i = 0; i < size; i++) {
+        result[i] = sumOfDigits(arr[i]);
+        if (result[i] > 0) total += result[i];
+    }
+    return total;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// One row of the benchmark: ms for each version and GB/s of input for the
+// fastest; ok compares both kernel results with the scalar one.
+static void bench_row(const char *name, size_t bytes, double scalar, double simd, double threads, int ok) {
+    double best = simd < threads ? simd : threads;
+    printf("%-16s %10.2f %10.2f %10.2f %10.2f  %s\n", name, scalar * 1e3, simd * 1e3,
+           threads * 1e3, bytes / best / 1e9, ok ? "ok" : "MISMATCH");
+}
+
+// Time each function as a scalar loop, a single-threaded kernel and a
+// threaded kernel on n random ints (and n random bytes for countVowels)
+static int benchmark(size_t n, par_pool_t *pool) {
+    int *arr = malloc(n * sizeof(int));
+    int *ref = malloc(n * sizeof(int));
+    int *out = malloc(n * sizeof(int));
+    char *text = malloc(n);
+    if (!arr || !ref || !out || !text) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    srand(42);
+    for (size_t i = 0; i < n; i++) {
+        arr[i] = (int)(((unsigned)rand() << 16) ^ (unsigned)rand());
+        text[i] = (char)(' ' + rand() % 95);
+    }
+    // fault the output pages in now so no column pays for them
+    memset(ref, 0, n * sizeof(int));
+    memset(out, 0, n * sizeof(int));
+    int bad = 0;
+
+    printf("n = %zu, %s kernels, %d threads, times in ms\n", n, kern_isa(), par_pool_size(pool));
+    printf("%-16s %10s %10s %10s %10s\n", "function", "scalar", "simd", "threads", "GB/s");
+
+    double t0 = now_sec();
+    long long d0 = max_min_diff_scalar(arr, n);
+    double t1 = now_sec();
+    long long d1 = kern_max_min_diff(arr, n, NULL);
+    double t2 = now_sec();
+    long long d2 = kern_max_min_diff(arr, n, pool);
+    double t3 = now_sec();
+    bad += !(d0 == d1 && d0 == d2);
+    bench_row("UABMaxMinDiff", n * sizeof(int), t1 - t0, t2 - t1, t3 - t2, d0 == d1 && d0 == d2);
+
+    t0 = now_sec();
+    replace_even_scalar(arr, n, ref);
+    t1 = now_sec();
+    kern_replace_even_with_zero(arr, n, out, NULL);
+    t2 = now_sec();
+    int ok = memcmp(out, ref, n * sizeof(int)) == 0;
+    memset(out, 0xff, n * sizeof(int));
+    t2 = now_sec();
+    kern_replace_even_with_zero(arr, n, out, pool);
+    t3 = now_sec();
+    ok = ok && memcmp(out, ref, n * sizeof(int)) == 0;
+    bad += !ok;
+    bench_row("replaceEven", n * sizeof(int), t1 - t0, t2 - t1, t3 - t2, ok);
+
+    t0 = now_sec();
+    size_t v0 = count_vowels_scalar(text, n);
+    t1 = now_sec();
+    size_t v1 = kern_count_vowels(text, n, NULL);
+    t2 = now_sec();
+    size_t v2 = kern_count_vowels(text, n, pool);
+    t3 = now_sec();
+    bad += !(v0 == v1 && v0 == v2);
+    bench_row("countVowels", n, t1 - t0, t2 - t1, t3 - t2, v0 == v1 && v0 == v2);
+
+    t0 = now_sec();
+    long long s0 = sum_of_digits_scalar(arr, n, ref);
+    t1 = now_sec();
+    long long s1 = kern_sum_of_digits(arr, n, out, NULL);
+    t2 = now_sec();
+    ok = s0 == s1 && memcmp(out, ref, n * sizeof(int)) == 0;
+    memset(out, 0, n * sizeof(int));
+    t2 = now_sec();
+    long long s2 = kern_sum_of_digits(arr, n, out, pool);
+    t3 = now_sec();
+    ok = ok && s0 == s2 && memcmp(out, ref, n * sizeof(int)) == 0;
+    bad += !ok;
+    bench_row("sumOfDigits", n * sizeof(int), t1 - t0, t2 - t1, t3 - t2, ok);
+
+    free(arr);
+    free(ref);
+    free(out);
+    free(text);
+    return bad ? 1 : 0;
+}
+
 // --- MAIN FUNCTION ---
 
-int main() {
+int main(int argc, char *argv[]) {
+    long bench = 0;
+    int nthreads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+            bench = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [-B n [-t threads]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (bench > 0) {
+        par_pool_t *pool = par_pool_create(nthreads);
+        if (!pool) {
+            printf("Could not start threads\n");
+            return 1;
+        }
+        int rc = benchmark((size_t)bench, pool);
+        par_pool_destroy(pool);
+        return rc;
+    }
+
     // Test sumOfDigits
     printf("sumOfDigits(123) = %d\n", sumOfDigits(123));   // 6
     printf("sumOfDigits(405) = %d\n", sumOfDigits(405));   // 9
@@ -9,6 +9,15 @@
 #include <errno.h>
 #include <time.h>
 #include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+
+#include "parallel.h"
+#include "strsearch.h"
 
 #define INDENT_STR "\t"
 
@@ -17,11 +26,30 @@ Name: Oladotun Adigun
 BlazerId: oaadigun
 Project #: oaadigun_HW02
 To compile: make
+    (or gcc -O2 -o oaadigun_HW02 oaadigun_HW02.c parallel.c strsearch.c trace.c -lpthread -lm)
+To run: ./oaadigun_HW02 [-S] [-s size] [-f pattern depth] [-w | -u | -D | -g text ...] [-t threads] [startdir]
+  -w  after listing the tree, keep watching it (inotify) and print one line
+      per change: "+ path" added, "- path" removed, "~ path" modified
+  -u  disk usage: bytes, allocated bytes and files below every directory
+  -D  duplicate files, hashed on -t threads (default: all CPUs)
+  -g  search the files for text instead of listing them; repeat -g to
+      search for several strings (up to 16) at once. Prints
+      "path:offset:line" for every matching line, offset being the byte
+      offset of the line's first match, in the order a listing would show
+      the files; binary files get one "binary file matches" line. Files
+      are read on -t threads.
+  -u, -D and -g use the files the -s/-f filters would list.
 */
 int opt_S = 0;            /* print attributes */
 long opt_s_size = -1;     /* size filter (-s) */
 char *opt_f_pattern = NULL; /* substring pattern for -f */
 int opt_f_depth = -1;     /* depth limit for -f */
+int opt_w = 0;            /* watch mode (-w) */
+int opt_u = 0;            /* disk usage (-u) */
+int opt_D = 0;            /* duplicate files (-D) */
+int opt_threads = 0;      /* threads for -D and -g, 0 = all CPUs */
+const char *opt_g[STR_SEARCH_MAX]; /* search strings for -g */
+int opt_g_count = 0;
 
 /* Typedef for filter function pointer */
 typedef int (*filter_fn)(const char *path, const struct stat *st, int depth);
@@ -225,12 +253,1048 @@ void traverse(const char *path, int current_depth, int indent_level) {
     }
 }
 
+/* ---- Watch mode (-w) ----
+   The tree is read once into memory, with an inotify watch on every
+   directory that traverse() would descend into. Each watch is added before
+   its directory is read, so nothing created during the walk is missed.
+   After that only the entries named by events are stat'ed again. inotify
+   reports a queue overflow for the whole instance, so an overflow rescans
+   the tree and diffs it against the model; a directory whose watch is
+   dropped while it still exists (e.g. a filesystem unmounted over it) is
+   rescanned from its parent.
+   fanotify would need CAP_SYS_ADMIN, so inotify is the mechanism used. */
+
+#define WATCH_SETTLE_MS 20      /* quiet time before queued entries are restat'ed */
+#define WATCH_MAX_DELAY_MS 250  /* ... but never hold a change back longer than this */
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB | \
+                    IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW | \
+                    IN_EXCL_UNLINK)
+
+typedef struct node {
+    char *name;
+    struct stat st;
+    int depth;                  /* 0 for the start directory */
+    int wd;                     /* inotify watch of a directory, -1 if none */
+    unsigned gen;               /* last directory pass that saw this entry */
+    int dirty;                  /* queued for a restat after the current batch of events */
+    int pending;                /* created by an event, "+" not printed yet */
+    struct node *parent;
+    struct node *first, *last;  /* children, in readdir order */
+    struct node *prev, *next;   /* siblings */
+    struct node *hnext;         /* hash chain */
+    struct node *dnext;         /* dirty list */
+} node_t;
+
+char watch_root[PATH_MAX+1];    /* real path of the start directory */
+int watch_fd = -1;
+int watch_full_warned = 0;
+node_t *root_node = NULL;
+node_t **node_table = NULL;     /* (parent, name) -> node, chained */
+size_t node_table_cap = 0, node_count = 0;
+node_t **wd_nodes = NULL;       /* watch descriptor -> directory node */
+int wd_cap = 0;
+unsigned scan_gen = 0;
+node_t *dirty_list = NULL, *dirty_tail = NULL;   /* FIFO, so output follows event order */
+
+size_t node_key(const node_t *parent, const char *name) {
+    size_t h = (size_t)parent * 0x9e3779b97f4a7c15ULL;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) h = (h ^ *c) * 0x100000001b3ULL;
+    return h ^ (h >> 29);
+}
+
+node_t *node_find(const node_t *parent, const char *name) {
+    if (!node_table) return NULL;
+    node_t *n = node_table[node_key(parent, name) & (node_table_cap - 1)];
+    while (n && (n->parent != parent || strcmp(n->name, name) != 0)) n = n->hnext;
+    return n;
+}
+
+void node_table_grow(void) {
+    size_t cap = node_table_cap ? node_table_cap * 2 : 1024;
+    node_t **t = calloc(cap, sizeof(node_t *));
+    if (!t) {
+        perror("calloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < node_table_cap; i++) {
+        node_t *n = node_table[i];
+        while (n) {
+            node_t *next = n->hnext;
+            size_t b = node_key(n->parent, n->name) & (cap - 1);
+            n->hnext = t[b];
+            t[b] = n;
+            n = next;
+        }
+    }
+    free(node_table);
+    node_table = t;
+    node_table_cap = cap;
+}
+
+node_t *node_add(node_t *parent, const char *name, const struct stat *st) {
+    if (node_count >= node_table_cap) node_table_grow();
+    node_t *n = calloc(1, sizeof(node_t));
+    if (!n || !(n->name = strdup(name))) {
+        perror("calloc");
+        exit(1);
+    }
+    n->st = *st;
+    n->wd = -1;
+    n->parent = parent;
+    n->depth = parent ? parent->depth + 1 : 0;
+    if (parent) {
+        n->prev = parent->last;
+        if (parent->last) parent->last->next = n;
+        else parent->first = n;
+        parent->last = n;
+    }
+    size_t b = node_key(parent, name) & (node_table_cap - 1);
+    n->hnext = node_table[b];
+    node_table[b] = n;
+    node_count++;
+    return n;
+}
+
+/* Path of n: relative to the start directory, or the full path */
+void node_path(const node_t *n, char *buf, size_t bufsz, int full) {
+    const node_t *chain[PATH_MAX / 2];
+    int depth = 0;
+    for (; n && n->parent && depth < PATH_MAX / 2; n = n->parent) chain[depth++] = n;
+    size_t len = (size_t)snprintf(buf, bufsz, "%s", full ? watch_root : (depth ? "" : "."));
+    for (int i = depth - 1; i >= 0 && len < bufsz; i--)
+        len += (size_t)snprintf(buf + len, bufsz - len, "%s%s", (full || i < depth - 1) ? "/" : "",
+                                chain[i]->name);
+}
+
+/* traverse() descends into a directory unless -f's depth limit stops it */
+int node_expanded(const node_t *n) {
+    if (!S_ISDIR(n->st.st_mode)) return 0;
+    return !(opt_f_pattern && opt_f_depth >= 0 && n->depth > opt_f_depth);
+}
+
+int node_matches(const node_t *n, const struct stat *st) {
+    return n->depth == 0 || should_print(n->name, st, n->depth);
+}
+
+/* "+ path" or "~ path" with -S attributes as in the listing, or "- path" */
+void emit(char op, const node_t *n, const struct stat *st) {
+    char rel[PATH_MAX+1], full[PATH_MAX+1];
+    node_path(n, rel, sizeof(rel), 0);
+    if (op == '-') {
+        printf("- %s\n", rel);     /* nothing left to readlink or describe */
+        return;
+    }
+    node_path(n, full, sizeof(full), 1);
+    printf("%c ", op);
+    print_entry(rel, full, st, 0);
+}
+
+void watch_dir(node_t *n) {
+    char full[PATH_MAX+1];
+    node_path(n, full, sizeof(full), 1);
+    int wd = inotify_add_watch(watch_fd, full, WATCH_MASK);
+    if (wd < 0) {
+        if (errno == ENOSPC && !watch_full_warned) {
+            fprintf(stderr, "inotify watch limit reached (fs.inotify.max_user_watches); "
+                            "changes under %s and later directories are not seen\n", full);
+            watch_full_warned = 1;
+        } else if (errno != ENOSPC && errno != ENOENT) {
+            fprintf(stderr, "inotify_add_watch failed on %s: %s\n", full, strerror(errno));
+        }
+        return;
+    }
+    if (wd >= wd_cap) {
+        int cap = wd_cap ? wd_cap : 1024;
+        while (cap <= wd) cap *= 2;
+        node_t **m = realloc(wd_nodes, (size_t)cap * sizeof(node_t *));
+        if (!m) {
+            perror("realloc");
+            exit(1);
+        }
+        memset(m + wd_cap, 0, (size_t)(cap - wd_cap) * sizeof(node_t *));
+        wd_nodes = m;
+        wd_cap = cap;
+    }
+    wd_nodes[wd] = n;
+    n->wd = wd;
+}
+
+/* Drop n and everything below it, printing "- path" for each matching entry
+   (children first) when report is set */
+void node_remove(node_t *n, int report) {
+    while (n->first) node_remove(n->first, report);
+    if (report && !n->pending && node_matches(n, &n->st)) emit('-', n, &n->st);
+    if (n->wd >= 0) {
+        wd_nodes[n->wd] = NULL;
+        inotify_rm_watch(watch_fd, n->wd);
+    }
+    if (n->dirty) n->dirty = -1;   /* unlinked from the dirty list when it is drained */
+
+    node_t **pp = &node_table[node_key(n->parent, n->name) & (node_table_cap - 1)];
+    while (*pp != n) pp = &(*pp)->hnext;
+    *pp = n->hnext;
+    node_count--;
+
+    if (n->parent) {
+        if (n->prev) n->prev->next = n->next;
+        else n->parent->first = n->next;
+        if (n->next) n->next->prev = n->prev;
+        else n->parent->last = n->prev;
+    }
+    if (n->dirty) {
+        n->parent = NULL;          /* freed by the drain */
+        return;
+    }
+    free(n->name);
+    free(n);
+}
+
+void sync_dir(node_t *dir, int report);
+
+/* A new entry under parent: add it, report it, and read it if it is a directory */
+node_t *node_create(node_t *parent, const char *name, const struct stat *st, int report) {
+    node_t *n = node_add(parent, name, st);
+    if (report && node_matches(n, st)) emit('+', n, st);
+    if (node_expanded(n)) sync_dir(n, report);
+    return n;
+}
+
+/* Compare n with a fresh lstat of it and report what the listing would show
+   differently: an entry that starts or stops passing the filters is added
+   or removed, a matching one whose size, mode or mtime changed is "~". */
+void node_update(node_t *n, const struct stat *st, int report) {
+    if ((n->st.st_mode & S_IFMT) != (st->st_mode & S_IFMT) || n->st.st_ino != st->st_ino) {
+        /* replaced by a different file: treat as remove + create */
+        node_t *parent = n->parent;
+        char *name = strdup(n->name);
+        if (!name) {
+            perror("strdup");
+            exit(1);
+        }
+        node_remove(n, report);
+        node_create(parent, name, st, report);
+        free(name);
+        return;
+    }
+    int was = node_matches(n, &n->st), now = node_matches(n, st);
+    int changed = n->st.st_size != st->st_size || n->st.st_mode != st->st_mode ||
+                  n->st.st_mtim.tv_sec != st->st_mtim.tv_sec || n->st.st_mtim.tv_nsec != st->st_mtim.tv_nsec;
+    if (report) {
+        if (was && !now) emit('-', n, &n->st);
+        else if (!was && now) emit('+', n, st);
+        else if (was && changed && !S_ISDIR(st->st_mode)) emit('~', n, st);
+    }
+    n->st = *st;
+}
+
+/* Bring dir's children in line with the directory on disk. The first read
+   of a directory creates its nodes; later reads (after an overflow) diff
+   against them. Expanded subdirectories are synced recursively. */
+void sync_dir(node_t *dir, int report) {
+    if (!node_expanded(dir)) return;
+    if (dir->wd < 0) watch_dir(dir);
+
+    char full[PATH_MAX+1], childpath[PATH_MAX+1];
+    node_path(dir, full, sizeof(full), 1);
+    DIR *d = opendir(full);
+    if (!d) {
+        if (errno != ENOENT) fprintf(stderr, "opendir failed on %s: %s\n", full, strerror(errno));
+        return;
+    }
+    unsigned gen = ++scan_gen;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        if (snprintf(childpath, sizeof(childpath), "%s/%s", full, entry->d_name) >= (int)sizeof(childpath)) {
+            /* a truncated path would be stat'ed and watched under the wrong name */
+            fprintf(stderr, "path too long, skipping: %s/%s\n", full, entry->d_name);
+            continue;
+        }
+        struct stat st;
+        if (lstat(childpath, &st) < 0) continue;
+        node_t *n = node_find(dir, entry->d_name);
+        if (!n) {
+            n = node_create(dir, entry->d_name, &st, report);
+        } else {
+            node_update(n, &st, report);
+            n = node_find(dir, entry->d_name);  /* node_update may replace it */
+            if (n && node_expanded(n)) sync_dir(n, report);
+        }
+        if (n) n->gen = gen;
+    }
+    closedir(d);
+
+    /* whatever the directory no longer lists is gone */
+    node_t *n = dir->first;
+    while (n) {
+        node_t *next = n->next;
+        if (n->gen != gen) node_remove(n, report);
+        n = next;
+    }
+}
+
+/* The initial listing, from the model, in traverse()'s order and format */
+void print_children(const node_t *dir, int indent_level) {
+    char full[PATH_MAX+1];
+    for (const node_t *n = dir->first; n; n = n->next) {
+        if (S_ISDIR(n->st.st_mode) || !should_print(n->name, &n->st, n->depth)) continue;
+        node_path(n, full, sizeof(full), 1);
+        print_entry(n->name, full, &n->st, indent_level + 1);
+    }
+    for (const node_t *n = dir->first; n; n = n->next) {
+        if (!S_ISDIR(n->st.st_mode)) continue;
+        node_path(n, full, sizeof(full), 1);
+        print_entry(n->name, full, &n->st, indent_level + 1);
+        if (node_expanded(n)) print_children(n, indent_level + 1);
+    }
+}
+
+void mark_dirty(node_t *n) {
+    if (n->dirty) return;
+    n->dirty = 1;
+    n->dnext = NULL;
+    if (dirty_tail) dirty_tail->dnext = n;
+    else dirty_list = n;
+    dirty_tail = n;
+}
+
+/* Restat every entry touched by the last batch of events, once each */
+void drain_dirty(void) {
+    char full[PATH_MAX+1];
+    while (dirty_list) {
+        node_t *n = dirty_list;
+        dirty_list = n->dnext;
+        if (!dirty_list) dirty_tail = NULL;
+        if (n->dirty < 0) {        /* removed while queued */
+            free(n->name);
+            free(n);
+            continue;
+        }
+        n->dirty = 0;
+        node_path(n, full, sizeof(full), 1);
+        struct stat st;
+        if (lstat(full, &st) < 0) continue;  /* IN_DELETE or IN_MOVED_FROM removes it */
+        if (n->pending) {
+            n->pending = 0;
+            if ((st.st_mode & S_IFMT) == (n->st.st_mode & S_IFMT) && st.st_ino == n->st.st_ino) {
+                n->st = st;
+                if (node_matches(n, &st)) emit('+', n, &st);
+                continue;
+            }
+            if (node_matches(n, &n->st)) emit('+', n, &n->st);
+        }
+        node_update(n, &st, 1);
+    }
+}
+
+void handle_event(const struct inotify_event *ev) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        fprintf(stderr, "inotify queue overflowed; rescanning %s\n", watch_root);
+        sync_dir(root_node, 1);
+        return;
+    }
+    node_t *dir = (ev->wd >= 0 && ev->wd < wd_cap) ? wd_nodes[ev->wd] : NULL;
+    if (!dir) return;               /* a watch we already dropped */
+
+    if (ev->mask & IN_IGNORED) {
+        /* the kernel dropped the watch; if the directory is still there
+           (e.g. unmounted), read it again from its parent */
+        wd_nodes[ev->wd] = NULL;
+        dir->wd = -1;
+        if (dir->parent) sync_dir(dir->parent, 1);
+        return;
+    }
+    if (dir == root_node && (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF))) {
+        printf("- .\n");
+        fflush(stdout);
+        fprintf(stderr, "%s was %s; stopping\n", watch_root, (ev->mask & IN_DELETE_SELF) ? "deleted" : "moved");
+        exit(0);
+    }
+    if (ev->len == 0) {
+        if (ev->mask & IN_ATTRIB) mark_dirty(dir);   /* the directory's own attributes */
+        return;
+    }
+
+    node_t *n = node_find(dir, ev->name);
+    if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (n) node_remove(n, 1);
+    } else if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+        char full[PATH_MAX+1];
+        struct stat st;
+        node_path(dir, full, sizeof(full), 1);
+        size_t len = strlen(full);
+        snprintf(full + len, sizeof(full) - len, "/%s", ev->name);
+        if (lstat(full, &st) < 0) return;         /* already gone again */
+        if (n) {
+            node_update(n, &st, 1);               /* e.g. a rename over an existing entry */
+        } else if (S_ISDIR(st.st_mode)) {
+            node_create(dir, ev->name, &st, 1);
+        } else {
+            /* a new file is usually written right away: print it with the
+               size it has once this batch of events is done */
+            n = node_add(dir, ev->name, &st);
+            n->pending = 1;
+            mark_dirty(n);
+        }
+    } else if (n && (ev->mask & (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE))) {
+        mark_dirty(n);
+    }
+}
+
+int watch_tree(const char *start) {
+    strncpy(watch_root, start, sizeof(watch_root) - 1);
+    struct stat st;
+    if (lstat(watch_root, &st) < 0) {
+        fprintf(stderr, "lstat failed on %s: %s\n", watch_root, strerror(errno));
+        return 1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "-w needs a directory: %s\n", watch_root);
+        return 1;
+    }
+    watch_fd = inotify_init1(IN_CLOEXEC);
+    if (watch_fd < 0) {
+        perror("inotify_init1");
+        return 1;
+    }
+
+    const char *name = strrchr(watch_root, '/');
+    name = (name && name[1]) ? name + 1 : watch_root;
+    root_node = node_add(NULL, name, &st);
+    sync_dir(root_node, 0);
+    print_entry(name, watch_root, &root_node->st, 0);
+    print_children(root_node, 0);
+    fflush(stdout);
+
+    /* events are at most sizeof(inotify_event) + NAME_MAX + 1 bytes */
+    char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    long batch_start_ms = 0;
+    for (;;) {
+        ssize_t r = read(watch_fd, buf, sizeof(buf));
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            perror("read inotify");
+            return 1;
+        }
+        for (char *p = buf; p < buf + r;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            handle_event(ev);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+        /* let a burst of writes settle into one restat (and one line) per file */
+        if (dirty_list) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long now_ms = now.tv_sec * 1000L + now.tv_nsec / 1000000;
+            if (!batch_start_ms) batch_start_ms = now_ms;
+            struct pollfd pfd = { watch_fd, POLLIN, 0 };
+            if (now_ms - batch_start_ms < WATCH_MAX_DELAY_MS && poll(&pfd, 1, WATCH_SETTLE_MS) > 0) continue;
+            drain_dirty();
+            batch_start_ms = 0;
+        }
+        fflush(stdout);
+    }
+}
+
+/* ---- Disk usage (-u) and duplicate files (-D) ----
+   One walk rolls sizes up bottom-up: each directory's totals are known when
+   its last entry has been read, and are printed then (children before
+   parents, as du does). Hard-linked files are counted once.
+   Duplicates are found in stages so that only real candidates are read in
+   full: files are grouped by size, same-size files are told apart by a hash
+   of their first DUP_PREFIX bytes, and only files that still collide are
+   hashed whole through mmap. Both hashing stages run on a par_pool, one
+   file per task, so slow files don't hold up a thread's other work. */
+
+#define DUP_PREFIX 4096
+
+typedef struct {
+    long long bytes;        /* apparent size of the files below */
+    long long allocated;    /* st_blocks * 512 */
+    long files;
+} usage_t;
+
+typedef struct {
+    char *path;             /* full path */
+    long long size;
+    uint64_t prefix;        /* hash of the first DUP_PREFIX bytes */
+    uint64_t hash[2];       /* 128-bit hash of the whole file */
+    int err;                /* could not be read */
+} file_rec_t;
+
+file_rec_t *dup_files = NULL;
+size_t dup_count = 0, dup_cap = 0;
+size_t root_len = 0;        /* strlen of the start path, stripped when printing */
+
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    int used;
+} inode_slot_t;
+
+inode_slot_t *inode_set = NULL;
+size_t inode_cap = 0, inode_used = 0;
+
+/* 1 if (dev, ino) was seen before; records it otherwise */
+int inode_seen(dev_t dev, ino_t ino) {
+    if (2 * (inode_used + 1) > inode_cap) {
+        size_t cap = inode_cap ? inode_cap * 2 : 1024;
+        inode_slot_t *t = calloc(cap, sizeof(inode_slot_t));
+        if (!t) {
+            perror("calloc");
+            exit(1);
+        }
+        for (size_t i = 0; i < inode_cap; i++) {
+            if (!inode_set[i].used) continue;
+            size_t j = ((uint64_t)inode_set[i].ino * 0x9e3779b97f4a7c15ULL ^ inode_set[i].dev) & (cap - 1);
+            while (t[j].used) j = (j + 1) & (cap - 1);
+            t[j] = inode_set[i];
+        }
+        free(inode_set);
+        inode_set = t;
+        inode_cap = cap;
+    }
+    size_t j = ((uint64_t)ino * 0x9e3779b97f4a7c15ULL ^ dev) & (inode_cap - 1);
+    for (; inode_set[j].used; j = (j + 1) & (inode_cap - 1))
+        if (inode_set[j].dev == dev && inode_set[j].ino == ino) return 1;
+    inode_set[j].dev = dev;
+    inode_set[j].ino = ino;
+    inode_set[j].used = 1;
+    inode_used++;
+    return 0;
+}
+
+void add_dup_candidate(const char *path, const struct stat *st) {
+    if (dup_count == dup_cap) {
+        dup_cap = dup_cap ? dup_cap * 2 : 4096;
+        file_rec_t *r = realloc(dup_files, dup_cap * sizeof(file_rec_t));
+        if (!r) {
+            perror("realloc");
+            exit(1);
+        }
+        dup_files = r;
+    }
+    file_rec_t *f = &dup_files[dup_count++];
+    memset(f, 0, sizeof(*f));
+    f->path = strdup(path);
+    f->size = (long long)st->st_size;
+    if (!f->path) {
+        perror("strdup");
+        exit(1);
+    }
+}
+
+/* Path relative to the start directory, "." for the start itself */
+const char *rel_path(const char *path) {
+    return path[root_len] ? path + root_len + 1 : ".";
+}
+
+/* Walk below path (at depth) with the same descent rules and filters as
+   traverse(), returning the totals of its subtree */
+usage_t scan_usage(const char *path, int depth) {
+    usage_t total = { 0, 0, 0 };
+    DIR *d = opendir(path);
+    if (!d) {
+        fprintf(stderr, "opendir failed on %s: %s\n", path, strerror(errno));
+        return total;
+    }
+    struct dirent *entry;
+    char childpath[PATH_MAX+1];
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(childpath, sizeof(childpath), "%s/%s", path, entry->d_name);
+        struct stat st;
+        if (lstat(childpath, &st) < 0) {
+            fprintf(stderr, "lstat failed on %s: %s\n", childpath, strerror(errno));
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            if (opt_f_pattern && opt_f_depth >= 0 && depth + 1 > opt_f_depth) continue;
+            usage_t sub = scan_usage(childpath, depth + 1);
+            total.bytes += sub.bytes;
+            total.allocated += sub.allocated;
+            total.files += sub.files;
+            continue;
+        }
+        if (!should_print(entry->d_name, &st, depth + 1)) continue;
+        if (st.st_nlink > 1 && inode_seen(st.st_dev, st.st_ino)) continue;
+        total.bytes += st.st_size;
+        total.allocated += (long long)st.st_blocks * 512;
+        total.files++;
+        if (opt_D && S_ISREG(st.st_mode) && st.st_size > 0) add_dup_candidate(childpath, &st);
+    }
+    closedir(d);
+    if (opt_u) printf("%14lld %14lld %10ld  %s\n", total.bytes, total.allocated, total.files, rel_path(path));
+    return total;
+}
+
+uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    return x ^ (x >> 33);
+}
+
+/* 128-bit content hash: two multiply-rotate lanes over 16-byte blocks.
+   Not cryptographic, but a chance collision of two different files of the
+   same size is around 2^-128. */
+void hash_bytes(const unsigned char *p, size_t n, uint64_t out[2]) {
+    uint64_t a = 0x9e3779b97f4a7c15ULL ^ n, b = 0xc2b2ae3d27d4eb4fULL + n;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint64_t w0, w1;
+        memcpy(&w0, p + i, 8);
+        memcpy(&w1, p + i + 8, 8);
+        a = rotl64(a ^ (w0 * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+        b = rotl64(b ^ (w1 * 0x4cf5ad432745937fULL), 33) * 0x87c37b91114253d5ULL;
+    }
+    uint64_t t[2] = { 0, 0 };
+    memcpy(t, p + i, n - i);
+    a ^= t[0] * 0x87c37b91114253d5ULL;
+    b ^= t[1] * 0x4cf5ad432745937fULL;
+    out[0] = mix64(a + b);
+    out[1] = mix64(b ^ rotl64(a, 17));
+}
+
+/* Stage 2: hash the first DUP_PREFIX bytes; for smaller files that is the
+   whole content, so it doubles as the full hash */
+void prefix_body(void *arg, size_t start, size_t end, int tid) {
+    file_rec_t **recs = (file_rec_t **)arg;
+    unsigned char buf[DUP_PREFIX];
+    (void)tid;
+    for (size_t i = start; i < end; i++) {
+        file_rec_t *f = recs[i];
+        int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+        size_t want = f->size < DUP_PREFIX ? (size_t)f->size : DUP_PREFIX;
+        ssize_t got = fd < 0 ? -1 : pread(fd, buf, want, 0);
+        if (fd >= 0) close(fd);
+        if (got != (ssize_t)want) {
+            f->err = 1;
+            continue;
+        }
+        hash_bytes(buf, want, f->hash);
+        f->prefix = f->hash[0];
+    }
+}
+
+/* Stage 3: hash the whole file through a read-ahead friendly mapping */
+void full_body(void *arg, size_t start, size_t end, int tid) {
+    file_rec_t **recs = (file_rec_t **)arg;
+    (void)tid;
+    for (size_t i = start; i < end; i++) {
+        file_rec_t *f = recs[i];
+        int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size != f->size) {
+            if (fd >= 0) close(fd);
+            f->err = 1;     /* gone or changed since the walk */
+            continue;
+        }
+        void *m = mmap(NULL, (size_t)f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (m == MAP_FAILED) {
+            f->err = 1;
+            continue;
+        }
+        madvise(m, (size_t)f->size, MADV_SEQUENTIAL);
+        hash_bytes((const unsigned char *)m, (size_t)f->size, f->hash);
+        munmap(m, (size_t)f->size);
+    }
+}
+
+int cmp_by_size(const void *a, const void *b) {
+    const file_rec_t *x = *(file_rec_t *const *)a, *y = *(file_rec_t *const *)b;
+    return (x->size > y->size) - (x->size < y->size);
+}
+
+int cmp_by_prefix(const void *a, const void *b) {
+    const file_rec_t *x = *(file_rec_t *const *)a, *y = *(file_rec_t *const *)b;
+    if (x->size != y->size) return (x->size > y->size) - (x->size < y->size);
+    return (x->prefix > y->prefix) - (x->prefix < y->prefix);
+}
+
+int cmp_by_content(const void *a, const void *b) {
+    const file_rec_t *x = *(file_rec_t *const *)a, *y = *(file_rec_t *const *)b;
+    if (x->size != y->size) return (x->size > y->size) - (x->size < y->size);
+    if (x->hash[0] != y->hash[0]) return (x->hash[0] > y->hash[0]) - (x->hash[0] < y->hash[0]);
+    return (x->hash[1] > y->hash[1]) - (x->hash[1] < y->hash[1]);
+}
+
+/* Same content together, each group in path order */
+int cmp_by_content_path(const void *a, const void *b) {
+    int c = cmp_by_content(a, b);
+    return c ? c : strcmp((*(file_rec_t *const *)a)->path, (*(file_rec_t *const *)b)->path);
+}
+
+/* Keep the runs of recs[0, n) that cmp puts in groups of two or more
+   (dropping unreadable files); returns the new count */
+size_t keep_groups(file_rec_t **recs, size_t n, int (*cmp)(const void *, const void *)) {
+    size_t out = 0, i = 0;
+    while (i < n) {
+        size_t j = i + 1;
+        while (j < n && cmp(&recs[i], &recs[j]) == 0) j++;
+        size_t good = 0;
+        for (size_t k = i; k < j; k++)
+            if (!recs[k]->err) good++;
+        if (good >= 2)
+            for (size_t k = i; k < j; k++)
+                if (!recs[k]->err) recs[out++] = recs[k];
+        i = j;
+    }
+    return out;
+}
+
+typedef struct {
+    size_t start, count;
+    long long wasted;       /* bytes freed by keeping one copy */
+} dup_group_t;
+
+int cmp_groups(const void *a, const void *b) {
+    const dup_group_t *x = a, *y = b;
+    if (x->wasted != y->wasted) return (x->wasted < y->wasted) - (x->wasted > y->wasted);
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+int find_duplicates(void) {
+    size_t n = dup_count;
+    file_rec_t **recs = malloc((n ? n : 1) * sizeof(file_rec_t *));
+    if (!recs) {
+        perror("malloc");
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) recs[i] = &dup_files[i];
+
+    /* stage 1: only sizes shared by two or more files */
+    qsort(recs, n, sizeof(file_rec_t *), cmp_by_size);
+    size_t same_size = keep_groups(recs, n, cmp_by_size);
+
+    par_pool_t *pool = par_pool_create(opt_threads);
+    if (!pool) {
+        fprintf(stderr, "Could not start threads\n");
+        free(recs);
+        return 1;
+    }
+
+    /* stage 2: first 4 KB */
+    par_for(pool, same_size, 1, prefix_body, recs);
+    qsort(recs, same_size, sizeof(file_rec_t *), cmp_by_prefix);
+    size_t same_prefix = keep_groups(recs, same_size, cmp_by_prefix);
+
+    /* stage 3: whole content, only for files longer than the prefix */
+    size_t nbig = 0;
+    long long full_bytes = 0;
+    file_rec_t **big = malloc((same_prefix ? same_prefix : 1) * sizeof(file_rec_t *));
+    if (!big) {
+        perror("malloc");
+        par_pool_destroy(pool);
+        free(recs);
+        return 1;
+    }
+    for (size_t i = 0; i < same_prefix; i++) {
+        if (recs[i]->size <= DUP_PREFIX) continue;
+        big[nbig++] = recs[i];
+        full_bytes += recs[i]->size;
+    }
+    par_for(pool, nbig, 1, full_body, big);
+    free(big);
+    par_pool_destroy(pool);
+
+    qsort(recs, same_prefix, sizeof(file_rec_t *), cmp_by_content_path);
+    size_t ndup = keep_groups(recs, same_prefix, cmp_by_content);
+
+    /* report the groups that free the most space first */
+    dup_group_t *groups = malloc((ndup ? ndup : 1) * sizeof(dup_group_t));
+    if (!groups) {
+        perror("malloc");
+        free(recs);
+        return 1;
+    }
+    size_t ngroups = 0, redundant = 0;
+    long long reclaimable = 0;
+    for (size_t i = 0; i < ndup;) {
+        size_t j = i + 1;
+        while (j < ndup && cmp_by_content(&recs[i], &recs[j]) == 0) j++;
+        groups[ngroups].start = i;
+        groups[ngroups].count = j - i;
+        groups[ngroups].wasted = recs[i]->size * (long long)(j - i - 1);
+        redundant += j - i - 1;
+        reclaimable += groups[ngroups].wasted;
+        ngroups++;
+        i = j;
+    }
+    qsort(groups, ngroups, sizeof(dup_group_t), cmp_groups);
+    for (size_t g = 0; g < ngroups; g++) {
+        printf("%lld bytes x %zu files:\n", recs[groups[g].start]->size, groups[g].count);
+        for (size_t k = 0; k < groups[g].count; k++)
+            printf("%s%s\n", INDENT_STR, rel_path(recs[groups[g].start + k]->path));
+    }
+    printf("%zu duplicate groups, %zu redundant files, %lld bytes reclaimable\n",
+           ngroups, redundant, reclaimable);
+    fprintf(stderr, "%zu files: %zu share a size, %zu share the first %d bytes, "
+                    "%zu fully hashed (%lld bytes)\n",
+            n, same_size, same_prefix, DUP_PREFIX, nbig, full_bytes);
+
+    free(groups);
+    free(recs);
+    return 0;
+}
+
+int usage_and_dups(const char *start) {
+    struct stat st;
+    if (lstat(start, &st) < 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "-u and -D need a directory: %s\n", start);
+        return 1;
+    }
+    root_len = strlen(start);
+    if (opt_u) printf("%14s %14s %10s  %s\n", "bytes", "allocated", "files", "directory");
+    scan_usage(start, 0);
+    return opt_D ? find_duplicates() : 0;
+}
+
+/* ---- Content search (-g) ----
+   The walker (pool thread 0) visits files in traverse() order and queues
+   every regular file the filters pass into a ring of GREP_RING slots. The
+   other pool threads take slots in queue order, map the file and collect
+   its matches in the slot; the walker prints finished slots from the head
+   of the ring, so output keeps traversal order however the reads finish.
+   A full ring stops the walk until the head is printed, which bounds the
+   memory held by finished but unprinted results; when the head has not
+   been taken yet the walker scans it itself, which is also how a single
+   thread works. */
+
+#define GREP_RING 64
+#define GREP_BINARY_PROBE 4096  /* a NUL in this prefix marks a binary file */
+#define GREP_LINE_MAX 200       /* longest line printed with a match */
+#define GREP_SMALL_FILE 16384   /* read, not mapped, up to this size */
+
+typedef struct {
+    char *path;
+    char *out;              /* the match lines (open_memstream), NULL if none */
+    size_t out_len;
+    int err;                /* errno from open/mmap, 0 if read */
+    int done;
+} grep_slot_t;
+
+typedef struct {
+    str_search_t search;
+    grep_slot_t ring[GREP_RING];
+    size_t head, next, tail;    /* printed < head <= next (taken) <= tail (queued) */
+    int walk_done;
+    pthread_mutex_t lock;
+    pthread_cond_t work;        /* a slot was queued, or the walk ended */
+    pthread_cond_t finished;    /* a slot is done */
+    const char *start;
+    long files, matches;
+    long long bytes;
+} grep_t;
+
+grep_t grep_ctx;
+
+/* Scan one file into its slot; called without the lock. Files of up to
+   GREP_SMALL_FILE bytes are read into a stack buffer, where the mapping
+   would cost more than the copy; larger ones are mapped. */
+void grep_file(grep_t *g, grep_slot_t *slot) {
+    char small[GREP_SMALL_FILE];
+    int fd = open(slot->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        slot->err = errno;
+        if (fd >= 0) close(fd);
+        return;
+    }
+    size_t size = (size_t)st.st_size;
+    const char *m = small;
+    void *map = NULL;
+    if (size <= GREP_SMALL_FILE) {
+        ssize_t got = pread(fd, small, size, 0);
+        if (got < 0) {
+            slot->err = errno;
+            close(fd);
+            return;
+        }
+        size = (size_t)got;
+    } else {
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            slot->err = errno;
+            close(fd);
+            return;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        m = map;
+    }
+    close(fd);
+
+    const char *rel = rel_path(slot->path);
+    int binary = memchr(m, '\0', size < GREP_BINARY_PROBE ? size : GREP_BINARY_PROBE) != NULL;
+    FILE *out = NULL;
+    long matches = 0;
+    size_t pos = 0, off;
+    while ((off = str_search_next(&g->search, m, size, pos, NULL)) != STR_SEARCH_NONE) {
+        if (!out && !(out = open_memstream(&slot->out, &slot->out_len))) {
+            slot->err = errno;
+            break;
+        }
+        matches++;
+        if (binary) {
+            fprintf(out, "%s:%zu: binary file matches\n", rel, off);
+            break;
+        }
+        /* one line per matching line, at the offset of its first match */
+        size_t ls = off, le;
+        while (ls > 0 && m[ls - 1] != '\n') ls--;
+        const char *nl = memchr(m + off, '\n', size - off);
+        le = nl ? (size_t)(nl - m) : size;
+        int shown = le - ls > GREP_LINE_MAX ? GREP_LINE_MAX : (int)(le - ls);
+        fprintf(out, "%s:%zu:%.*s\n", rel, off, shown, m + ls);
+        pos = le + 1;
+    }
+    if (out) fclose(out);
+    if (map) munmap(map, size);
+
+    pthread_mutex_lock(&g->lock);
+    g->files++;
+    g->bytes += (long long)size;
+    g->matches += matches;
+    pthread_mutex_unlock(&g->lock);
+}
+
+/* Print and free finished slots at the head; called with the lock held */
+void grep_flush(grep_t *g) {
+    while (g->head < g->next && g->ring[g->head % GREP_RING].done) {
+        grep_slot_t *slot = &g->ring[g->head % GREP_RING];
+        if (slot->err) fprintf(stderr, "open failed on %s: %s\n", slot->path, strerror(slot->err));
+        else if (slot->out) fwrite(slot->out, 1, slot->out_len, stdout);
+        free(slot->out);
+        free(slot->path);
+        memset(slot, 0, sizeof(*slot));
+        g->head++;
+    }
+}
+
+/* Make room for one more slot, helping with or waiting for the head */
+void grep_wait_head(grep_t *g) {
+    grep_slot_t *slot = &g->ring[g->head % GREP_RING];
+    if (g->next == g->head) {
+        g->next++;
+        pthread_mutex_unlock(&g->lock);
+        grep_file(g, slot);
+        pthread_mutex_lock(&g->lock);
+        slot->done = 1;
+    } else if (!slot->done) {
+        pthread_cond_wait(&g->finished, &g->lock);
+    }
+    grep_flush(g);
+}
+
+void grep_queue(grep_t *g, const char *path) {
+    char *copy = strdup(path);
+    if (!copy) {
+        perror("strdup");
+        exit(1);
+    }
+    pthread_mutex_lock(&g->lock);
+    grep_flush(g);
+    while (g->tail - g->head == GREP_RING) grep_wait_head(g);
+    g->ring[g->tail++ % GREP_RING].path = copy;
+    pthread_cond_signal(&g->work);
+    pthread_mutex_unlock(&g->lock);
+}
+
+/* Same descent rules, filters and order as traverse() */
+void grep_walk(grep_t *g, const char *path, int depth) {
+    DIR *d = opendir(path);
+    if (!d) {
+        fprintf(stderr, "opendir failed on %s: %s\n", path, strerror(errno));
+        return;
+    }
+    struct dirent *entry;
+    char childpath[PATH_MAX+1];
+    struct stat st;
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(childpath, sizeof(childpath), "%s/%s", path, entry->d_name);
+        if (lstat(childpath, &st) < 0) {
+            fprintf(stderr, "lstat failed on %s: %s\n", childpath, strerror(errno));
+            continue;
+        }
+        if (S_ISREG(st.st_mode) && should_print(entry->d_name, &st, depth + 1)) grep_queue(g, childpath);
+    }
+    rewinddir(d);
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(childpath, sizeof(childpath), "%s/%s", path, entry->d_name);
+        if (lstat(childpath, &st) < 0 || !S_ISDIR(st.st_mode)) continue;
+        if (opt_f_pattern && opt_f_depth >= 0 && depth + 1 > opt_f_depth) continue;
+        grep_walk(g, childpath, depth + 1);
+    }
+    closedir(d);
+}
+
+void grep_task(void *arg, int tid, int nthreads) {
+    grep_t *g = (grep_t *)arg;
+    (void)nthreads;
+    if (tid == 0) {
+        grep_walk(g, g->start, 0);
+        pthread_mutex_lock(&g->lock);
+        g->walk_done = 1;
+        pthread_cond_broadcast(&g->work);
+        while (g->head < g->tail) grep_wait_head(g);
+        pthread_mutex_unlock(&g->lock);
+        return;
+    }
+    pthread_mutex_lock(&g->lock);
+    for (;;) {
+        while (g->next == g->tail && !g->walk_done) pthread_cond_wait(&g->work, &g->lock);
+        if (g->next == g->tail) break;
+        grep_slot_t *slot = &g->ring[g->next++ % GREP_RING];
+        pthread_mutex_unlock(&g->lock);
+        grep_file(g, slot);
+        pthread_mutex_lock(&g->lock);
+        slot->done = 1;
+        pthread_cond_signal(&g->finished);
+    }
+    pthread_mutex_unlock(&g->lock);
+}
+
+int grep_tree(const char *start) {
+    grep_t *g = &grep_ctx;
+    struct stat st;
+    if (lstat(start, &st) < 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "-g needs a directory: %s\n", start);
+        return 1;
+    }
+    if (str_search_init(&g->search, opt_g, opt_g_count) != 0) {
+        fprintf(stderr, "-g patterns must not be empty\n");
+        return 1;
+    }
+    par_pool_t *pool = par_pool_create(opt_threads);
+    if (!pool) {
+        fprintf(stderr, "Could not start threads\n");
+        return 1;
+    }
+    root_len = strlen(start);
+    g->start = start;
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->work, NULL);
+    pthread_cond_init(&g->finished, NULL);
+    par_pool_run(pool, grep_task, g);
+    par_pool_destroy(pool);
+    fprintf(stderr, "%ld files searched (%lld bytes), %ld matching lines\n", g->files, g->bytes, g->matches);
+    return 0;
+}
+
 void usage(const char *prog) {
-    fprintf(stderr, "Usage: %s [-S] [-s size] [-f pattern depth] [startdir]\n", prog);
+    fprintf(stderr, "Usage: %s [-S] [-s size] [-f pattern depth] [-w | -u | -D | -g text ...] [-t threads] [startdir]\n", prog);
 }
 
 int main(int argc, char *argv[]) {
-    int opt;
     /* We'll use getopt to parse -S -s and -f */
 
     /* Custom parsing because -f takes two arguments (pattern and depth) */
@@ -239,6 +1303,23 @@ int main(int argc, char *argv[]) {
         if (strcmp(argv[idx], "-S") == 0) {
             opt_S = 1;
             idx++;
+        } else if (strcmp(argv[idx], "-w") == 0) {
+            opt_w = 1;
+            idx++;
+        } else if (strcmp(argv[idx], "-u") == 0) {
+            opt_u = 1;
+            idx++;
+        } else if (strcmp(argv[idx], "-D") == 0) {
+            opt_D = 1;
+            idx++;
+        } else if (strcmp(argv[idx], "-g") == 0) {
+            if (idx + 1 >= argc || opt_g_count == STR_SEARCH_MAX) { usage(argv[0]); return 1; }
+            opt_g[opt_g_count++] = argv[idx+1];
+            idx += 2;
+        } else if (strcmp(argv[idx], "-t") == 0) {
+            if (idx + 1 >= argc) { usage(argv[0]); return 1; }
+            opt_threads = atoi(argv[idx+1]);
+            idx += 2;
         } else if (strcmp(argv[idx], "-s") == 0) {
             if (idx + 1 >= argc) { usage(argv[0]); return 1; }
             opt_s_size = atol(argv[idx+1]);
@@ -269,7 +1350,15 @@ int main(int argc, char *argv[]) {
         real_start[sizeof(real_start)-1] = '\0';
     }
 
+    if (opt_w + (opt_u || opt_D) + (opt_g_count > 0) > 1) {
+        fprintf(stderr, "-w, -g and -u/-D cannot be combined\n");
+        return 1;
+    }
+    if (opt_w) return watch_tree(real_start);
+    if (opt_g_count) return grep_tree(real_start);
+    if (opt_u || opt_D) return usage_and_dups(real_start);
+
     traverse(real_start, 0, 0);
 
     return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,1180 @@
+/* parallel.c
+   Persistent pthread pool, work-stealing loops and parallel reductions;
+   see parallel.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <stdatomic.h>
+
+#include "parallel.h"
+#include "trace.h"
+
+/* ------------------------------------------------------------------------- */
+/* Thread pool                                                                */
+/* ------------------------------------------------------------------------- */
+
+struct par_pool {
+    int nthreads;
+    pthread_t *threads;          /* nthreads - 1 workers; the caller is tid 0 */
+    pthread_mutex_t mutex;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    unsigned long generation;    /* bumped for every par_pool_run() */
+    int pending;                 /* workers still running the current task */
+    int shutdown;
+    par_task_fn fn;
+    void *arg;
+    par_schedule_t schedule;
+};
+
+typedef struct {
+    par_pool_t *pool;
+    int tid;
+} par_worker_arg_t;
+
+static void *par_worker(void *arg) {
+    par_worker_arg_t *warg = (par_worker_arg_t *)arg;
+    par_pool_t *pool = warg->pool;
+    int tid = warg->tid;
+    free(warg);
+    trace_thread_name("pool worker %d", tid);
+
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->generation == seen && !pool->shutdown)
+            pthread_cond_wait(&pool->start_cond, &pool->mutex);
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        par_task_fn fn = pool->fn;
+        void *fnarg = pool->arg;
+        pthread_mutex_unlock(&pool->mutex);
+
+        TRACE_BEGIN("pool task");
+        fn(fnarg, tid, pool->nthreads);
+        TRACE_END("pool task");
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0) pthread_cond_signal(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+int par_num_cpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+par_pool_t *par_pool_create(int nthreads) {
+    if (nthreads <= 0) nthreads = par_num_cpus();
+
+    par_pool_t *pool = calloc(1, sizeof(par_pool_t));
+    if (!pool) return NULL;
+    pool->nthreads = nthreads;
+    pool->threads = calloc((size_t)nthreads, sizeof(pthread_t));
+    if (!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (int i = 1; i < nthreads; i++) {
+        par_worker_arg_t *warg = malloc(sizeof(par_worker_arg_t));
+        if (warg) {
+            warg->pool = pool;
+            warg->tid = i;
+        }
+        if (!warg || pthread_create(&pool->threads[i], NULL, par_worker, warg) != 0) {
+            free(warg);
+            pool->nthreads = i; /* keep the workers that did start */
+            break;
+        }
+    }
+    return pool;
+}
+
+void par_pool_destroy(par_pool_t *pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 1; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->start_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->threads);
+    free(pool);
+}
+
+int par_pool_size(const par_pool_t *pool) {
+    return pool->nthreads;
+}
+
+void par_pool_run(par_pool_t *pool, par_task_fn fn, void *arg) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->pending = pool->nthreads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    TRACE_BEGIN("pool task");
+    fn(arg, 0, pool->nthreads);
+    TRACE_END("pool task");
+
+    TRACE_BEGIN("pool join");
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+    TRACE_END("pool join");
+}
+
+void par_partition(size_t n, int part, int nparts, size_t *start, size_t *end) {
+    /* 8 doubles = one cache line; rounding keeps threads off each other's lines */
+    const size_t align = PAR_CACHE_LINE / sizeof(double);
+    size_t s = (size_t)((unsigned long long)n * (unsigned)part / (unsigned)nparts);
+    size_t e = (size_t)((unsigned long long)n * (unsigned)(part + 1) / (unsigned)nparts);
+    s -= s % align;
+    e = (part == nparts - 1) ? n : e - e % align;
+    *start = s;
+    *end = e;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Work-stealing loops                                                        */
+/* ------------------------------------------------------------------------- */
+
+#define WS_DEQUE_SIZE 128      /* binary splitting keeps at most ~log2(n) ranges live */
+#define WS_MIN_GRAIN 4096      /* elements; below this a chunk is not worth a steal */
+#define WS_CHUNKS_PER_THREAD 32
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/* Chase-Lev deque of [start, end) ranges with a fixed buffer (C11 version
+   from Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+   Models"). The owner pushes and takes at the bottom, thieves steal from
+   the top. Slots are relaxed atomics so a thief racing with the owner
+   reads stale values instead of undefined ones; its CAS on top then fails. */
+typedef struct {
+    _Atomic size_t start;
+    _Atomic size_t end;
+} ws_slot_t;
+
+typedef struct {
+    _Alignas(PAR_CACHE_LINE) _Atomic long top;
+    _Alignas(PAR_CACHE_LINE) _Atomic long bottom;
+    ws_slot_t slots[WS_DEQUE_SIZE];
+} ws_deque_t;
+
+static int ws_push(ws_deque_t *q, size_t start, size_t end) {
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    if (b - t >= WS_DEQUE_SIZE) return 0;
+    ws_slot_t *slot = &q->slots[b % WS_DEQUE_SIZE];
+    atomic_store_explicit(&slot->start, start, memory_order_relaxed);
+    atomic_store_explicit(&slot->end, end, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    return 1;
+}
+
+static int ws_take(ws_deque_t *q, size_t *start, size_t *end) {
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+    ws_slot_t *slot = &q->slots[b % WS_DEQUE_SIZE];
+    *start = atomic_load_explicit(&slot->start, memory_order_relaxed);
+    *end = atomic_load_explicit(&slot->end, memory_order_relaxed);
+    if (t == b) {
+        /* last element: race thieves for it */
+        int won = atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                          memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+    return 1;
+}
+
+static int ws_steal(ws_deque_t *q, size_t *start, size_t *end) {
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b) return 0;
+    ws_slot_t *slot = &q->slots[t % WS_DEQUE_SIZE];
+    *start = atomic_load_explicit(&slot->start, memory_order_relaxed);
+    *end = atomic_load_explicit(&slot->end, memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                   memory_order_seq_cst, memory_order_relaxed);
+}
+
+typedef struct {
+    size_t n;
+    size_t grain;
+    par_range_fn body;
+    void *arg;
+    ws_deque_t *deques;
+    _Alignas(PAR_CACHE_LINE) _Atomic size_t remaining;  /* elements not yet run */
+} ws_job_t;
+
+/* Split r in halves down to the grain, leaving the upper halves for thieves
+   (and for ourselves later), then run what is left. */
+static void ws_run_range(ws_job_t *job, ws_deque_t *self, int tid, size_t start, size_t end) {
+    const size_t align = PAR_CACHE_LINE / sizeof(double);
+    while (end - start > job->grain) {
+        size_t mid = start + (end - start) / 2;
+        mid -= mid % align;
+        if (mid <= start || !ws_push(self, mid, end)) break;
+        end = mid;
+    }
+    job->body(job->arg, start, end, tid);
+    atomic_fetch_sub_explicit(&job->remaining, end - start, memory_order_release);
+}
+
+static void ws_task(void *arg, int tid, int nthreads) {
+    ws_job_t *job = (ws_job_t *)arg;
+    ws_deque_t *self = &job->deques[tid];
+    size_t start, end;
+
+    par_partition(job->n, tid, nthreads, &start, &end);
+    if (start < end) ws_run_range(job, self, tid, start, end);
+
+    unsigned int seed = (unsigned int)tid * 2654435761u + 1;
+    int idle = 0;
+    while (atomic_load_explicit(&job->remaining, memory_order_acquire) > 0) {
+        if (ws_take(self, &start, &end)) {
+            ws_run_range(job, self, tid, start, end);
+            idle = 0;
+            continue;
+        }
+        seed = seed * 1103515245u + 12345u;
+        int victim = (int)((seed >> 8) % (unsigned)nthreads);
+        if (victim != tid && ws_steal(&job->deques[victim], &start, &end)) {
+            TRACE_INSTANT("steal");
+            ws_run_range(job, self, tid, start, end);
+            idle = 0;
+            continue;
+        }
+        /* back off quickly on oversubscribed hosts: the thread we wait on may need our CPU */
+        if (++idle > 64) sched_yield();
+        else cpu_relax();
+    }
+}
+
+typedef struct {
+    size_t n;
+    par_range_fn body;
+    void *arg;
+} static_job_t;
+
+static void static_task(void *arg, int tid, int nthreads) {
+    static_job_t *job = (static_job_t *)arg;
+    size_t start, end;
+    par_partition(job->n, tid, nthreads, &start, &end);
+    if (start < end) job->body(job->arg, start, end, tid);
+}
+
+void par_pool_set_schedule(par_pool_t *pool, par_schedule_t sched) {
+    pool->schedule = sched;
+}
+
+void par_for(par_pool_t *pool, size_t n, size_t grain, par_range_fn body, void *arg) {
+    if (n == 0) return;
+    if (pool->schedule == PAR_STATIC || pool->nthreads == 1) {
+        static_job_t job = { n, body, arg };
+        par_pool_run(pool, static_task, &job);
+        return;
+    }
+
+    if (grain == 0) {
+        grain = n / ((size_t)pool->nthreads * WS_CHUNKS_PER_THREAD);
+        if (grain < WS_MIN_GRAIN) grain = WS_MIN_GRAIN;
+    }
+    ws_deque_t *deques = aligned_alloc(PAR_CACHE_LINE, sizeof(ws_deque_t) * (size_t)pool->nthreads);
+    if (!deques) {
+        static_job_t job = { n, body, arg };
+        par_pool_run(pool, static_task, &job);
+        return;
+    }
+    memset(deques, 0, sizeof(ws_deque_t) * (size_t)pool->nthreads);
+
+    ws_job_t job;
+    job.n = n;
+    job.grain = grain;
+    job.body = body;
+    job.arg = arg;
+    job.deques = deques;
+    atomic_init(&job.remaining, n);
+    par_pool_run(pool, ws_task, &job);
+    free(deques);
+}
+
+typedef struct {
+    const par_reducer_t *reducer;
+    par_reduce_body_fn body;
+    void *arg;
+    char *accs;
+    size_t stride;
+} preduce_job_t;
+
+static void preduce_body(void *arg, size_t start, size_t end, int tid) {
+    preduce_job_t *job = (preduce_job_t *)arg;
+    job->body(job->arg, start, end, job->accs + (size_t)tid * job->stride);
+}
+
+void par_parallel_reduce(par_pool_t *pool, size_t n, size_t grain, const par_reducer_t *reducer,
+                         par_reduce_body_fn body, void *arg, void *result) {
+    int nt = pool->nthreads;
+    size_t stride = (reducer->size + PAR_CACHE_LINE - 1) & ~(size_t)(PAR_CACHE_LINE - 1);
+    char *accs = aligned_alloc(PAR_CACHE_LINE, stride * (size_t)nt);
+    if (!accs) {
+        /* no room for partials: fold everything on the calling thread */
+        reducer->init(result, arg);
+        body(arg, 0, n, result);
+        return;
+    }
+    for (int i = 0; i < nt; i++) reducer->init(accs + (size_t)i * stride, arg);
+
+    preduce_job_t job = { reducer, body, arg, accs, stride };
+    par_for(pool, n, grain, preduce_body, &job);
+
+    /* Binary tree over the partials: stride 1, 2, 4, ... */
+    for (int step = 1; step < nt; step *= 2)
+        for (int i = 0; i + step < nt; i += 2 * step)
+            reducer->combine(accs + (size_t)i * stride, accs + (size_t)(i + step) * stride, arg);
+
+    memcpy(result, accs, reducer->size);
+    free(accs);
+}
+
+int par_schedule_parse(const char *s) {
+    if (strcmp(s, "steal") == 0) return PAR_STEAL;
+    if (strcmp(s, "static") == 0) return PAR_STATIC;
+    return -1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Pinning and NUMA-aware arrays                                              */
+/* ------------------------------------------------------------------------- */
+
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define MAX_NODES 64
+
+/* Allowed CPUs ordered node0[0], node1[0], node0[1], node1[1], ...
+   Node cpulists come from sysfs; without them the order is plain. */
+static int numa_cpu_order(int *order, int max) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return 0;
+
+    int *node_cpus[MAX_NODES];
+    int node_n[MAX_NODES];
+    int nnodes = 0;
+    for (int node = 0; node < MAX_NODES; node++) {
+        char path[PATH_MAX], buf[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        int *cpus = malloc(sizeof(int) * CPU_SETSIZE);
+        int n = 0;
+        if (cpus && fgets(buf, sizeof(buf), f)) {
+            char *p = buf;
+            while (*p && *p != '\n') {
+                char *end;
+                long lo = strtol(p, &end, 10), hi = lo;
+                if (end == p) break;
+                if (*end == '-') hi = strtol(end + 1, &end, 10);
+                for (long c = lo; c <= hi && c < CPU_SETSIZE; c++)
+                    if (CPU_ISSET((int)c, &allowed)) cpus[n++] = (int)c;
+                p = (*end == ',') ? end + 1 : end;
+            }
+        }
+        fclose(f);
+        if (n == 0) {
+            free(cpus);
+            continue;
+        }
+        node_cpus[nnodes] = cpus;
+        node_n[nnodes++] = n;
+    }
+
+    int count = 0;
+    if (nnodes == 0) {
+        for (int c = 0; c < CPU_SETSIZE && count < max; c++)
+            if (CPU_ISSET(c, &allowed)) order[count++] = c;
+        return count;
+    }
+    for (int round = 0; count < max; round++) {
+        int added = 0;
+        for (int nd = 0; nd < nnodes && count < max; nd++)
+            if (round < node_n[nd]) {
+                order[count++] = node_cpus[nd][round];
+                added = 1;
+            }
+        if (!added) break;
+    }
+    for (int nd = 0; nd < nnodes; nd++) free(node_cpus[nd]);
+    return count;
+}
+
+typedef struct {
+    int *order;
+    int ncpus;
+    int failed;
+} pin_job_t;
+
+static void pin_task(void *arg, int tid, int nthreads) {
+    (void)nthreads;
+    pin_job_t *job = (pin_job_t *)arg;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(job->order[tid % job->ncpus], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+}
+
+int par_pool_pin(par_pool_t *pool) {
+    int order[CPU_SETSIZE];
+    pin_job_t job = { order, numa_cpu_order(order, CPU_SETSIZE), 0 };
+    if (job.ncpus == 0) return -1;
+    par_pool_run(pool, pin_task, &job);
+    return job.failed ? -1 : 0;
+}
+
+typedef struct {
+    double *a;
+    size_t n;
+    par_init_fn init;
+    void *arg;
+} first_touch_job_t;
+
+static void first_touch_task(void *arg, int tid, int nthreads) {
+    first_touch_job_t *job = (first_touch_job_t *)arg;
+    size_t start, end;
+    par_partition(job->n, tid, nthreads, &start, &end);
+    if (job->init)
+        job->init(job->a, start, end, job->arg);
+    else
+        memset(job->a + start, 0, (end - start) * sizeof(double));
+}
+
+int par_array_alloc(par_array_t *arr, par_pool_t *pool, size_t n, par_pages_t pages,
+                    par_init_fn init, void *arg) {
+    memset(arr, 0, sizeof(*arr));
+    size_t bytes = n * sizeof(double);
+    if (bytes == 0) bytes = sizeof(double);
+
+    void *map = MAP_FAILED;
+    size_t map_bytes = 0;
+    if (pages == PAR_PAGES_HUGETLB) {
+        map_bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);  /* reserves up front, no SIGBUS later */
+        if (map == MAP_FAILED) pages = PAR_PAGES_THP; /* pool empty or not configured */
+    }
+    if (map == MAP_FAILED) {
+        /* over-allocate so the data can start on a 2 MB boundary for THP */
+        map_bytes = bytes + (pages == PAR_PAGES_THP ? HUGE_PAGE_SIZE : 0);
+        map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (map == MAP_FAILED) return -1;
+    }
+
+    char *data = map;
+    if (pages == PAR_PAGES_THP) {
+        data = (char *)(((unsigned long)map + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+#ifdef MADV_HUGEPAGE
+        /* whole huge pages, but never past the end of our own mapping */
+        size_t advise = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        size_t room = (size_t)((char *)map + map_bytes - data);
+        madvise(data, advise < room ? advise : room, MADV_HUGEPAGE);
+#endif
+    }
+
+    arr->data = (double *)data;
+    arr->n = n;
+    arr->map = map;
+    arr->map_bytes = map_bytes;
+    arr->pages = pages;
+
+    first_touch_job_t job = { arr->data, n, init, arg };
+    par_pool_run(pool, first_touch_task, &job);
+    return 0;
+}
+
+void par_array_free(par_array_t *arr) {
+    if (arr->map) munmap(arr->map, arr->map_bytes);
+    memset(arr, 0, sizeof(*arr));
+}
+
+/* Sum huge-page backing of every smaps entry overlapping [lo, hi) */
+static long smaps_huge_kb(unsigned long lo, unsigned long hi) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return -1;
+    char line[512];
+    int inside = 0;
+    long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end;
+        long v;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            inside = start < hi && end > lo;
+        } else if (inside && (sscanf(line, "AnonHugePages: %ld kB", &v) == 1 ||
+                              sscanf(line, "Private_Hugetlb: %ld kB", &v) == 1 ||
+                              sscanf(line, "Shared_Hugetlb: %ld kB", &v) == 1)) {
+            kb += v;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+long par_array_placement(const par_array_t *arr, long *pages_per_node, int max_nodes,
+                         long max_samples, long *huge_kb) {
+    long page = sysconf(_SC_PAGESIZE);
+    unsigned long lo = (unsigned long)arr->data & ~(unsigned long)(page - 1);
+    unsigned long hi = (unsigned long)(arr->data + arr->n);
+    long npages = (long)((hi - lo + (unsigned long)page - 1) / (unsigned long)page);
+    if (npages <= 0 || max_samples <= 0) return 0;
+    long step = npages > max_samples ? npages / max_samples : 1;
+    long count = (npages + step - 1) / step;
+
+    for (int i = 0; i < max_nodes; i++) pages_per_node[i] = 0;
+    if (huge_kb) *huge_kb = smaps_huge_kb(lo, hi);
+
+    void **addrs = malloc(sizeof(void *) * (size_t)count);
+    int *status = malloc(sizeof(int) * (size_t)count);
+    if (!addrs || !status) {
+        free(addrs);
+        free(status);
+        return -1;
+    }
+    for (long i = 0; i < count; i++) addrs[i] = (void *)(lo + (unsigned long)(i * step * page));
+
+    /* move_pages with nodes == NULL only reports where each page lives */
+    long rc = syscall(SYS_move_pages, 0, (unsigned long)count, addrs, NULL, status, 0);
+    if (rc == 0) {
+        for (long i = 0; i < count; i++)
+            if (status[i] >= 0 && status[i] < max_nodes) pages_per_node[status[i]]++;
+    }
+    free(addrs);
+    free(status);
+    return rc == 0 ? count : -1;
+}
+
+int par_pages_parse(const char *s) {
+    if (strcmp(s, "none") == 0 || strcmp(s, "default") == 0) return PAR_PAGES_DEFAULT;
+    if (strcmp(s, "thp") == 0) return PAR_PAGES_THP;
+    if (strcmp(s, "hugetlb") == 0) return PAR_PAGES_HUGETLB;
+    return -1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Kernels                                                                    */
+/* ------------------------------------------------------------------------- */
+
+/* GCC vector extensions give portable 4-wide double arithmetic; target_clones
+   builds AVX-512, AVX2 and baseline versions of each kernel and picks one at
+   load time. Two independent vector accumulators hide the add latency.
+   The code must not be built with -ffast-math, or Kahan compensation is
+   optimised away. */
+#pragma GCC diagnostic ignored "-Wpsabi"   /* v4d helpers are static inline, no ABI exposure */
+typedef double v4d __attribute__((vector_size(32)));
+typedef long long v4l __attribute__((vector_size(32)));
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define PAR_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define PAR_KERNEL
+#endif
+
+#define PAIRWISE_BLOCK 256
+
+static inline v4d load4(const double *p) {
+    v4d v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline double hsum4(const v4d *v) {
+    return ((*v)[0] + (*v)[1]) + ((*v)[2] + (*v)[3]);
+}
+
+/* Value represented as hi + lo, used to carry compensation between threads */
+typedef struct {
+    double hi;
+    double lo;
+} dd_t;
+
+static inline dd_t two_sum(double a, double b) {
+    double s = a + b;
+    double bb = s - a;
+    dd_t r = { s, (a - (s - bb)) + (b - bb) };
+    return r;
+}
+
+static inline dd_t dd_add(dd_t x, dd_t y) {
+    dd_t s = two_sum(x.hi, y.hi);
+    s.lo += x.lo + y.lo;
+    return two_sum(s.hi, s.lo);
+}
+
+PAR_KERNEL
+static double sum_naive(const double *a, size_t n) {
+    v4d s0 = {0, 0, 0, 0}, s1 = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 += load4(a + i);
+        s1 += load4(a + i + 4);
+    }
+    s0 += s1;
+    double s = hsum4(&s0);
+    for (; i < n; i++) s += a[i];
+    return s;
+}
+
+PAR_KERNEL
+static double dot_naive(const double *a, const double *b, size_t n) {
+    v4d s0 = {0, 0, 0, 0}, s1 = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 += load4(a + i) * load4(b + i);
+        s1 += load4(a + i + 4) * load4(b + i + 4);
+    }
+    s0 += s1;
+    double s = hsum4(&s0);
+    for (; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+/* Kahan summation, one compensation term per lane. b == NULL sums a,
+   otherwise sums a[i] * b[i]. */
+PAR_KERNEL
+static dd_t kahan_kernel(const double *a, const double *b, size_t n) {
+    v4d s = {0, 0, 0, 0}, c = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        v4d x = b ? load4(a + i) * load4(b + i) : load4(a + i);
+        v4d y = x - c;
+        v4d t = s + y;
+        c = (t - s) - y;
+        s = t;
+    }
+    dd_t r = { 0.0, 0.0 };
+    for (int l = 0; l < 4; l++) {
+        dd_t lane = { s[l], -c[l] };
+        r = dd_add(r, lane);
+    }
+    for (; i < n; i++) {
+        dd_t x = { b ? a[i] * b[i] : a[i], 0.0 };
+        r = dd_add(r, x);
+    }
+    return r;
+}
+
+static double pairwise(const double *a, const double *b, size_t n) {
+    if (n <= PAIRWISE_BLOCK) return b ? dot_naive(a, b, n) : sum_naive(a, n);
+    size_t half = (n / 2) & ~(size_t)7;
+    return pairwise(a, b, half) + pairwise(a + half, b ? b + half : NULL, n - half);
+}
+
+/* Lanes start at +INFINITY (-INFINITY for max) and the bitwise select keeps
+   NaNs out: x < m is false for NaN, so m stays. Only a result of +INFINITY
+   is ambiguous: either some element is +INFINITY or all of them are NaN. */
+PAR_KERNEL
+static double min_kernel(const double *a, size_t n) {
+    double m = INFINITY;
+    size_t i = 0;
+    v4d m0 = { INFINITY, INFINITY, INFINITY, INFINITY }, m1 = m0;
+    for (; i + 8 <= n; i += 8) {
+        v4d x0 = load4(a + i), x1 = load4(a + i + 4);
+        v4l k0 = x0 < m0, k1 = x1 < m1;
+        m0 = (v4d)(((v4l)x0 & k0) | ((v4l)m0 & ~k0));
+        m1 = (v4d)(((v4l)x1 & k1) | ((v4l)m1 & ~k1));
+    }
+    for (int l = 0; l < 4; l++) {
+        if (m0[l] < m) m = m0[l];
+        if (m1[l] < m) m = m1[l];
+    }
+    for (; i < n; i++)
+        if (a[i] < m) m = a[i];
+    if (m == INFINITY)
+        for (i = 0; i < n; i++)
+            if (!isnan(a[i])) return m;
+    return m == INFINITY ? NAN : m;
+}
+
+PAR_KERNEL
+static double max_kernel(const double *a, size_t n) {
+    double m = -INFINITY;
+    size_t i = 0;
+    v4d m0 = { -INFINITY, -INFINITY, -INFINITY, -INFINITY }, m1 = m0;
+    for (; i + 8 <= n; i += 8) {
+        v4d x0 = load4(a + i), x1 = load4(a + i + 4);
+        v4l k0 = x0 > m0, k1 = x1 > m1;
+        m0 = (v4d)(((v4l)x0 & k0) | ((v4l)m0 & ~k0));
+        m1 = (v4d)(((v4l)x1 & k1) | ((v4l)m1 & ~k1));
+    }
+    for (int l = 0; l < 4; l++) {
+        if (m0[l] > m) m = m0[l];
+        if (m1[l] > m) m = m1[l];
+    }
+    for (; i < n; i++)
+        if (a[i] > m) m = a[i];
+    if (m == -INFINITY)
+        for (i = 0; i < n; i++)
+            if (!isnan(a[i])) return m;
+    return m == -INFINITY ? NAN : m;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Reductions                                                                 */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    par_op_t op;
+    par_accuracy_t accuracy;
+    const double *a;
+    const double *b;
+} reduce_job_t;
+
+static dd_t reduce_range(const reduce_job_t *job, size_t start, size_t end) {
+    const double *a = job->a + start;
+    const double *b = job->b ? job->b + start : NULL;
+    size_t n = end - start;
+    dd_t r = { 0.0, 0.0 };
+
+    switch (job->op) {
+    case PAR_MIN:
+        r.hi = n ? min_kernel(a, n) : NAN;
+        break;
+    case PAR_MAX:
+        r.hi = n ? max_kernel(a, n) : NAN;
+        break;
+    case PAR_SUM:
+    case PAR_DOT:
+        if (job->op == PAR_SUM) b = NULL;
+        if (job->accuracy == PAR_KAHAN) r = kahan_kernel(a, b, n);
+        else if (job->accuracy == PAR_PAIRWISE) r.hi = pairwise(a, b, n);
+        else r.hi = b ? dot_naive(a, b, n) : sum_naive(a, n);
+        break;
+    }
+    return r;
+}
+
+static dd_t combine(par_op_t op, dd_t x, dd_t y) {
+    switch (op) {
+    case PAR_MIN:
+        return (isnan(x.hi) || y.hi < x.hi) ? y : x;
+    case PAR_MAX:
+        return (isnan(x.hi) || y.hi > x.hi) ? y : x;
+    default:
+        return dd_add(x, y);
+    }
+}
+
+static void reduce_init(void *acc, void *arg) {
+    const reduce_job_t *job = (const reduce_job_t *)arg;
+    dd_t *d = (dd_t *)acc;
+    d->hi = (job->op == PAR_MIN || job->op == PAR_MAX) ? NAN : 0.0;
+    d->lo = 0.0;
+}
+
+static void reduce_combine(void *into, const void *from, void *arg) {
+    const reduce_job_t *job = (const reduce_job_t *)arg;
+    *(dd_t *)into = combine(job->op, *(dd_t *)into, *(const dd_t *)from);
+}
+
+static void reduce_body(void *arg, size_t start, size_t end, void *acc) {
+    const reduce_job_t *job = (const reduce_job_t *)arg;
+    *(dd_t *)acc = combine(job->op, *(dd_t *)acc, reduce_range(job, start, end));
+}
+
+double par_reduce(par_pool_t *pool, par_op_t op, par_accuracy_t accuracy,
+                  const double *a, const double *b, size_t n) {
+    static const par_reducer_t reducer = { sizeof(dd_t), reduce_init, reduce_combine };
+    reduce_job_t job = { op, accuracy, a, b };
+    dd_t result;
+    par_parallel_reduce(pool, n, 0, &reducer, reduce_body, &job, &result);
+    return result.hi + result.lo;
+}
+
+int par_op_parse(const char *s) {
+    if (strcmp(s, "sum") == 0) return PAR_SUM;
+    if (strcmp(s, "min") == 0) return PAR_MIN;
+    if (strcmp(s, "max") == 0) return PAR_MAX;
+    if (strcmp(s, "dot") == 0) return PAR_DOT;
+    return -1;
+}
+
+int par_accuracy_parse(const char *s) {
+    if (strcmp(s, "naive") == 0) return PAR_NAIVE;
+    if (strcmp(s, "kahan") == 0) return PAR_KAHAN;
+    if (strcmp(s, "pairwise") == 0) return PAR_PAIRWISE;
+    return -1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Scans                                                                      */
+/* ------------------------------------------------------------------------- */
+
+#define SCAN_PARALLEL_MIN 65536   /* elements; below this one thread scans it all */
+
+/* Integer scans run on unsigned lanes so overflow wraps instead of being undefined */
+typedef unsigned long long v4u __attribute__((vector_size(32)));
+
+static inline void store4(double *p, const v4d *v) {
+    memcpy(p, v, sizeof(*v));
+}
+
+static inline v4u load4u(const unsigned long long *p) {
+    v4u v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store4u(unsigned long long *p, const v4u *v) {
+    memcpy(p, v, sizeof(*v));
+}
+
+/* Head flags of four elements as all-ones lane masks: one 4-byte load,
+   widened in a single instruction */
+typedef unsigned char v4u8 __attribute__((vector_size(4)));
+
+static inline v4l heads4(const unsigned char *h) {
+    v4u8 b;
+    memcpy(&b, h, sizeof(b));
+    return __builtin_convertvector(b, v4l) != 0;
+}
+
+PAR_KERNEL
+static unsigned long long sum_u64(const unsigned long long *a, size_t n) {
+    v4u s0 = {0, 0, 0, 0}, s1 = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 += load4u(a + i);
+        s1 += load4u(a + i + 4);
+    }
+    s0 += s1;
+    unsigned long long s = s0[0] + s0[1] + s0[2] + s0[3];
+    for (; i < n; i++) s += a[i];
+    return s;
+}
+
+/* Inside a vector, two shifted adds (Hillis-Steele) give the four prefix
+   sums; the running total, kept broadcast in c, is then added to every
+   lane. With two vectors per step the loop-carried chain is one add and
+   one lane broadcast per 8 elements. Each step loads before it stores, so
+   out may be a. Returns the total after the last element. */
+PAR_KERNEL
+static double scan_kernel(const double *a, double *out, size_t n, double carry, int exclusive) {
+    const v4l lane0 = { -1, 0, 0, 0 };
+    v4d c = { carry, carry, carry, carry };
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        v4d x0 = load4(a + i), x1 = load4(a + i + 4);
+        x0 += (v4d){ 0, x0[0], x0[1], x0[2] };
+        x1 += (v4d){ 0, x1[0], x1[1], x1[2] };
+        x0 += (v4d){ 0, 0, x0[0], x0[1] };
+        x1 += (v4d){ 0, 0, x1[0], x1[1] };
+        x1 += (v4d){ x0[3], x0[3], x0[3], x0[3] };
+        x0 += c;
+        x1 += c;
+        if (exclusive) {
+            v4d e0 = (v4d){ 0, x0[0], x0[1], x0[2] } + (v4d)((v4l)c & lane0);
+            v4d e1 = (v4d){ 0, x1[0], x1[1], x1[2] } + (v4d)((v4l)(v4d){ x0[3], x0[3], x0[3], x0[3] } & lane0);
+            store4(out + i, &e0);
+            store4(out + i + 4, &e1);
+        } else {
+            store4(out + i, &x0);
+            store4(out + i + 4, &x1);
+        }
+        c = (v4d){ x1[3], x1[3], x1[3], x1[3] };
+    }
+    carry = c[0];
+    for (; i < n; i++) {
+        double x = a[i];
+        out[i] = exclusive ? carry : carry + x;
+        carry += x;
+    }
+    return carry;
+}
+
+PAR_KERNEL
+static unsigned long long scan_kernel_u64(const unsigned long long *a, unsigned long long *out, size_t n,
+                                          unsigned long long carry, int exclusive) {
+    v4u c = { carry, carry, carry, carry };
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        v4u r0 = load4u(a + i), r1 = load4u(a + i + 4);
+        v4u x0 = r0 + (v4u){ 0, r0[0], r0[1], r0[2] };
+        v4u x1 = r1 + (v4u){ 0, r1[0], r1[1], r1[2] };
+        x0 += (v4u){ 0, 0, x0[0], x0[1] };
+        x1 += (v4u){ 0, 0, x1[0], x1[1] };
+        x1 += (v4u){ x0[3], x0[3], x0[3], x0[3] };
+        x0 += c;
+        x1 += c;
+        if (exclusive) {
+            /* exact in wrapping integer arithmetic */
+            v4u e0 = x0 - r0, e1 = x1 - r1;
+            store4u(out + i, &e0);
+            store4u(out + i + 4, &e1);
+        } else {
+            store4u(out + i, &x0);
+            store4u(out + i + 4, &x1);
+        }
+        c = (v4u){ x1[3], x1[3], x1[3], x1[3] };
+    }
+    carry = c[0];
+    for (; i < n; i++) {
+        unsigned long long x = a[i];
+        out[i] = exclusive ? carry : carry + x;
+        carry += x;
+    }
+    return carry;
+}
+
+/* The same with segment heads: g collects the heads at or before each lane
+   and masks what a lane may add, so it only adds from lanes before it while
+   no head lies in between. The second vector continues the first one's last
+   segment unless it starts a new one itself, and only lanes with no head
+   before them in the step take the running total. Masked lanes add +0.0. */
+PAR_KERNEL
+static double segscan_kernel(const double *a, const unsigned char *heads, double *out, size_t n,
+                             double carry, int exclusive) {
+    const v4l lane0 = { -1, 0, 0, 0 };
+    v4d c = { carry, carry, carry, carry };
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        v4l f0 = heads4(heads + i), f1 = heads4(heads + i + 4), g0 = f0, g1 = f1;
+        v4d x0 = load4(a + i), x1 = load4(a + i + 4);
+        x0 += (v4d)((v4l)(v4d){ 0, x0[0], x0[1], x0[2] } & ~g0);
+        x1 += (v4d)((v4l)(v4d){ 0, x1[0], x1[1], x1[2] } & ~g1);
+        g0 |= (v4l){ 0, g0[0], g0[1], g0[2] };
+        g1 |= (v4l){ 0, g1[0], g1[1], g1[2] };
+        x0 += (v4d)((v4l)(v4d){ 0, 0, x0[0], x0[1] } & ~g0);
+        x1 += (v4d)((v4l)(v4d){ 0, 0, x1[0], x1[1] } & ~g1);
+        g0 |= (v4l){ 0, 0, g0[0], g0[1] };
+        g1 |= (v4l){ 0, 0, g1[0], g1[1] };
+        x1 += (v4d)((v4l)(v4d){ x0[3], x0[3], x0[3], x0[3] } & ~g1);
+        g1 |= (v4l){ g0[3], g0[3], g0[3], g0[3] };
+        x0 += (v4d)((v4l)c & ~g0);
+        x1 += (v4d)((v4l)c & ~g1);
+        if (exclusive) {
+            v4d e0 = (v4d){ 0, x0[0], x0[1], x0[2] } + (v4d)((v4l)c & lane0);
+            v4d e1 = (v4d){ 0, x1[0], x1[1], x1[2] } + (v4d)((v4l)(v4d){ x0[3], x0[3], x0[3], x0[3] } & lane0);
+            e0 = (v4d)((v4l)e0 & ~f0);
+            e1 = (v4d)((v4l)e1 & ~f1);
+            store4(out + i, &e0);
+            store4(out + i + 4, &e1);
+        } else {
+            store4(out + i, &x0);
+            store4(out + i + 4, &x1);
+        }
+        c = (v4d){ x1[3], x1[3], x1[3], x1[3] };
+    }
+    carry = c[0];
+    for (; i < n; i++) {
+        double x = a[i];
+        if (heads[i]) carry = 0;
+        out[i] = exclusive ? carry : carry + x;
+        carry += x;
+    }
+    return carry;
+}
+
+PAR_KERNEL
+static unsigned long long segscan_kernel_u64(const unsigned long long *a, const unsigned char *heads,
+                                             unsigned long long *out, size_t n,
+                                             unsigned long long carry, int exclusive) {
+    v4u c = { carry, carry, carry, carry };
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        v4l f0 = heads4(heads + i), f1 = heads4(heads + i + 4), g0 = f0, g1 = f1;
+        v4u r0 = load4u(a + i), r1 = load4u(a + i + 4);
+        v4u x0 = r0 + ((v4u){ 0, r0[0], r0[1], r0[2] } & ~(v4u)g0);
+        v4u x1 = r1 + ((v4u){ 0, r1[0], r1[1], r1[2] } & ~(v4u)g1);
+        g0 |= (v4l){ 0, g0[0], g0[1], g0[2] };
+        g1 |= (v4l){ 0, g1[0], g1[1], g1[2] };
+        x0 += (v4u){ 0, 0, x0[0], x0[1] } & ~(v4u)g0;
+        x1 += (v4u){ 0, 0, x1[0], x1[1] } & ~(v4u)g1;
+        g0 |= (v4l){ 0, 0, g0[0], g0[1] };
+        g1 |= (v4l){ 0, 0, g1[0], g1[1] };
+        x1 += (v4u){ x0[3], x0[3], x0[3], x0[3] } & ~(v4u)g1;
+        g1 |= (v4l){ g0[3], g0[3], g0[3], g0[3] };
+        x0 += c & ~(v4u)g0;
+        x1 += c & ~(v4u)g1;
+        if (exclusive) {
+            /* a head's inclusive sum is its own value, so this is 0 there */
+            v4u e0 = x0 - r0, e1 = x1 - r1;
+            store4u(out + i, &e0);
+            store4u(out + i + 4, &e1);
+        } else {
+            store4u(out + i, &x0);
+            store4u(out + i + 4, &x1);
+        }
+        c = (v4u){ x1[3], x1[3], x1[3], x1[3] };
+    }
+    carry = c[0];
+    for (; i < n; i++) {
+        unsigned long long x = a[i];
+        if (heads[i]) carry = 0;
+        out[i] = exclusive ? carry : carry + x;
+        carry += x;
+    }
+    return carry;
+}
+
+/* Index just past the last head in h[start, end), or start if there is
+   none. Blocks without heads are skipped eight flags at a time. */
+static size_t last_head(const unsigned char *h, size_t start, size_t end) {
+    for (; end > start && (end - start) % 8; end--)
+        if (h[end - 1]) return end;
+    for (; end > start; end -= 8) {
+        unsigned long long w;
+        memcpy(&w, h + end - 8, sizeof(w));
+        if (w) break;
+    }
+    while (end > start && !h[end - 1]) end--;
+    return end;
+}
+
+/* One per block. The first pass stores what the block adds to the running
+   total (for a block holding a head, the sum after its last head); the
+   caller then replaces it with the running total entering the block. */
+typedef struct {
+    _Alignas(PAR_CACHE_LINE) double d;
+    unsigned long long u;
+    int head;
+} scan_part_t;
+
+typedef struct {
+    int is_double;
+    int exclusive;
+    const void *a;
+    const unsigned char *heads;   /* NULL for a plain scan */
+    void *out;
+    size_t n;
+    scan_part_t *parts;
+} scan_job_t;
+
+static void scan_sum_task(void *arg, int tid, int nthreads) {
+    scan_job_t *job = (scan_job_t *)arg;
+    scan_part_t *p = &job->parts[tid];
+    size_t start, end;
+    par_partition(job->n, tid, nthreads, &start, &end);
+    size_t from = start;
+    p->head = 0;
+    if (job->heads) {
+        size_t h = last_head(job->heads, start, end);
+        if (h > start) {
+            from = h - 1;
+            p->head = 1;
+        }
+    }
+    if (job->is_double) p->d = sum_naive((const double *)job->a + from, end - from);
+    else p->u = sum_u64((const unsigned long long *)job->a + from, end - from);
+}
+
+static void scan_block_task(void *arg, int tid, int nthreads) {
+    scan_job_t *job = (scan_job_t *)arg;
+    const scan_part_t *p = &job->parts[tid];
+    size_t start, end;
+    par_partition(job->n, tid, nthreads, &start, &end);
+    const unsigned char *heads = job->heads ? job->heads + start : NULL;
+    if (job->is_double) {
+        const double *a = (const double *)job->a + start;
+        double *out = (double *)job->out + start;
+        if (heads) segscan_kernel(a, heads, out, end - start, p->d, job->exclusive);
+        else scan_kernel(a, out, end - start, p->d, job->exclusive);
+    } else {
+        const unsigned long long *a = (const unsigned long long *)job->a + start;
+        unsigned long long *out = (unsigned long long *)job->out + start;
+        if (heads) segscan_kernel_u64(a, heads, out, end - start, p->u, job->exclusive);
+        else scan_kernel_u64(a, out, end - start, p->u, job->exclusive);
+    }
+}
+
+static void scan_run(par_pool_t *pool, scan_job_t *job) {
+    int nthreads = pool ? par_pool_size(pool) : 1;
+    scan_part_t single = { 0.0, 0, 0 };
+    if (nthreads > 1 && job->n >= SCAN_PARALLEL_MIN)
+        job->parts = aligned_alloc(PAR_CACHE_LINE, sizeof(scan_part_t) * (size_t)nthreads);
+    if (nthreads == 1 || job->n < SCAN_PARALLEL_MIN || !job->parts) {
+        job->parts = &single;
+        scan_block_task(job, 0, 1);
+        return;
+    }
+
+    par_pool_run(pool, scan_sum_task, job);
+    double dc = 0.0;
+    unsigned long long uc = 0;
+    for (int t = 0; t < nthreads; t++) {
+        scan_part_t *p = &job->parts[t];
+        double ds = p->d;
+        unsigned long long us = p->u;
+        p->d = dc;
+        p->u = uc;
+        dc = p->head ? ds : dc + ds;
+        uc = p->head ? us : uc + us;
+    }
+    par_pool_run(pool, scan_block_task, job);
+    free(job->parts);
+}
+
+void par_scan_double(par_pool_t *pool, par_scan_t kind, const double *a, double *out, size_t n) {
+    scan_job_t job = { 1, kind == PAR_EXCLUSIVE, a, NULL, out, n, NULL };
+    scan_run(pool, &job);
+}
+
+void par_scan_int64(par_pool_t *pool, par_scan_t kind, const long long *a, long long *out, size_t n) {
+    scan_job_t job = { 0, kind == PAR_EXCLUSIVE, a, NULL, out, n, NULL };
+    scan_run(pool, &job);
+}
+
+void par_segscan_double(par_pool_t *pool, par_scan_t kind, const double *a, const unsigned char *heads,
+                        double *out, size_t n) {
+    scan_job_t job = { 1, kind == PAR_EXCLUSIVE, a, heads, out, n, NULL };
+    scan_run(pool, &job);
+}
+
+void par_segscan_int64(par_pool_t *pool, par_scan_t kind, const long long *a, const unsigned char *heads,
+                       long long *out, size_t n) {
+    scan_job_t job = { 0, kind == PAR_EXCLUSIVE, a, heads, out, n, NULL };
+    scan_run(pool, &job);
+}
+
+int par_scan_parse(const char *s) {
+    if (strcmp(s, "inclusive") == 0) return PAR_INCLUSIVE;
+    if (strcmp(s, "exclusive") == 0) return PAR_EXCLUSIVE;
+    return -1;
+}
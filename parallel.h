@@ -0,0 +1,178 @@
+/* parallel.h
+   Persistent pthread pool, work-stealing parallel_for/parallel_reduce,
+   parallel reductions over double arrays and (segmented) prefix sums.
+   Used by pthread_sum_struct.c; compile parallel.c alongside it:
+       gcc -O2 -Wall pthread_sum_struct.c parallel.c trace.c -lpthread -o pthread_sum_struct
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+#define PAR_CACHE_LINE 64
+
+/* ---- thread pool ---- */
+
+typedef struct par_pool par_pool_t;
+
+/* Task run once by every thread of the pool; tid is 0..nthreads-1 and the
+   calling thread always runs tid 0. */
+typedef void (*par_task_fn)(void *arg, int tid, int nthreads);
+
+/* Create a pool of nthreads (<= 0 means one per online CPU). The workers are
+   started once and reused by every call to par_pool_run(). */
+par_pool_t *par_pool_create(int nthreads);
+void par_pool_destroy(par_pool_t *pool);
+int par_pool_size(const par_pool_t *pool);
+
+/* Run fn on all pool threads and return when every one has finished */
+void par_pool_run(par_pool_t *pool, par_task_fn fn, void *arg);
+
+/* Split [0, n) into nparts nearly equal ranges whose boundaries fall on
+   cache-line multiples; writes part's range to *start and *end. */
+void par_partition(size_t n, int part, int nparts, size_t *start, size_t *end);
+
+/* Number of online CPUs (at least 1) */
+int par_num_cpus(void);
+
+/* Pin pool thread tid to the tid-th CPU of an order that alternates between
+   NUMA nodes, so any number of threads is spread over every socket. Returns
+   0, or -1 if some thread could not be pinned. */
+int par_pool_pin(par_pool_t *pool);
+
+/* ---- loops ---- */
+
+typedef enum {
+    PAR_STEAL,   /* work stealing over per-thread Chase-Lev deques (default) */
+    PAR_STATIC   /* one par_partition() slice per thread */
+} par_schedule_t;
+
+/* Schedule used by par_for/par_parallel_reduce on this pool */
+void par_pool_set_schedule(par_pool_t *pool, par_schedule_t sched);
+
+/* Loop body over [start, end); tid identifies the pool thread running it */
+typedef void (*par_range_fn)(void *arg, size_t start, size_t end, int tid);
+
+/* Run body over [0, n). Under PAR_STEAL every thread starts on its own
+   par_partition() slice and splits it in halves down to grain elements,
+   pushing the upper halves on its deque; idle threads steal the largest
+   pending half from a random victim. Slow or preempted threads therefore
+   lose work instead of holding up the join. grain == 0 picks one from n
+   and the pool size. Chunk boundaries stay on cache-line multiples. */
+void par_for(par_pool_t *pool, size_t n, size_t grain, par_range_fn body, void *arg);
+
+/* Accumulator type for par_parallel_reduce: size bytes, set to the identity
+   by init and merged by combine (into = into op from). */
+typedef struct {
+    size_t size;
+    void (*init)(void *acc, void *arg);
+    void (*combine)(void *into, const void *from, void *arg);
+} par_reducer_t;
+
+/* Folds [start, end) into acc */
+typedef void (*par_reduce_body_fn)(void *arg, size_t start, size_t end, void *acc);
+
+/* par_for with one cache-line padded accumulator per thread, combined as a
+   binary tree into result at the end. */
+void par_parallel_reduce(par_pool_t *pool, size_t n, size_t grain, const par_reducer_t *reducer,
+                         par_reduce_body_fn body, void *arg, void *result);
+
+int par_schedule_parse(const char *s);
+
+/* ---- NUMA-aware arrays ---- */
+
+typedef enum {
+    PAR_PAGES_DEFAULT,  /* normal 4 KB pages */
+    PAR_PAGES_THP,      /* 2 MB aligned and madvise(MADV_HUGEPAGE) */
+    PAR_PAGES_HUGETLB   /* MAP_HUGETLB from the reserved pool, falls back to THP */
+} par_pages_t;
+
+typedef struct {
+    double *data;
+    size_t n;
+    void *map;          /* mapping as returned by mmap */
+    size_t map_bytes;
+    par_pages_t pages;  /* what was actually obtained */
+} par_array_t;
+
+/* Fills a[start, end) of the array being allocated */
+typedef void (*par_init_fn)(double *a, size_t start, size_t end, void *arg);
+
+/* Map n doubles without touching them, then let every pool thread
+   initialize the par_partition() range it will later reduce. Linux places
+   a page on the node of the thread that first writes it, so with a pinned
+   pool each socket ends up owning the pages its threads read.
+   init == NULL zero-fills. Returns 0 or -1 with errno set. */
+int par_array_alloc(par_array_t *arr, par_pool_t *pool, size_t n, par_pages_t pages,
+                    par_init_fn init, void *arg);
+void par_array_free(par_array_t *arr);
+
+/* Where the array's pages live: pages_per_node[i] counts sampled pages on
+   node i (at most max_nodes), *huge_kb is the THP/hugetlb backing reported by
+   the kernel. Samples at most max_samples pages spread over the array.
+   Returns the number of pages sampled, or -1 if the kernel can't tell. */
+long par_array_placement(const par_array_t *arr, long *pages_per_node, int max_nodes,
+                         long max_samples, long *huge_kb);
+
+int par_pages_parse(const char *s);
+
+/* ---- reductions ---- */
+
+typedef enum {
+    PAR_SUM,    /* sum of a[i] */
+    PAR_MIN,    /* smallest a[i] (NaNs are skipped) */
+    PAR_MAX,    /* largest a[i] (NaNs are skipped) */
+    PAR_DOT     /* sum of a[i] * b[i] */
+} par_op_t;
+
+typedef enum {
+    PAR_NAIVE,     /* vectorized multi-accumulator summation */
+    PAR_KAHAN,     /* compensated (Kahan) summation per lane */
+    PAR_PAIRWISE   /* pairwise summation over vector-summed blocks */
+} par_accuracy_t;
+
+/* Reduce a (and b, for PAR_DOT) of length n with every thread in the pool,
+   through par_parallel_reduce() and the pool's schedule. Each thread folds
+   its chunks into a cache-line padded partial and the partials are combined
+   as a binary tree. With PAR_STEAL the chunk-to-thread mapping varies from
+   run to run, so naive sums may differ in the last bits; Kahan partials are
+   merged in double-double and stay stable. accuracy only affects PAR_SUM
+   and PAR_DOT.
+   Returns 0 for an empty sum/dot and NaN for min/max of an empty array. */
+double par_reduce(par_pool_t *pool, par_op_t op, par_accuracy_t accuracy,
+                  const double *a, const double *b, size_t n);
+
+/* Parse "sum"/"min"/"max"/"dot" and "naive"/"kahan"/"pairwise"; -1 if unknown */
+int par_op_parse(const char *s);
+int par_accuracy_parse(const char *s);
+
+/* ---- scans ---- */
+
+typedef enum {
+    PAR_INCLUSIVE,  /* out[i] = a[0] + ... + a[i] */
+    PAR_EXCLUSIVE   /* out[i] = a[0] + ... + a[i-1], out[0] = 0 */
+} par_scan_t;
+
+/* Prefix sums of a into out (out may be a). Two passes over one
+   par_partition() block per thread: every thread sums its block, the caller
+   turns the block sums into running totals, and every thread scans its
+   block from its total with vector in-block scans. Blocks are taken in
+   order whatever the pool's schedule, and they match par_array_alloc()'s
+   first touch. Double scans associate differently from a serial loop and may
+   differ from it in the last bits; integer scans are exact (they wrap on overflow). */
+void par_scan_double(par_pool_t *pool, par_scan_t kind, const double *a, double *out, size_t n);
+void par_scan_int64(par_pool_t *pool, par_scan_t kind, const long long *a, long long *out, size_t n);
+
+/* Segmented scans: the running total restarts at every i with heads[i] != 0
+   (and at 0), so each segment is scanned on its own and an exclusive scan
+   writes 0 at every head. */
+void par_segscan_double(par_pool_t *pool, par_scan_t kind, const double *a, const unsigned char *heads,
+                        double *out, size_t n);
+void par_segscan_int64(par_pool_t *pool, par_scan_t kind, const long long *a, const unsigned char *heads,
+                       long long *out, size_t n);
+
+/* Parse "inclusive"/"exclusive"; -1 if unknown */
+int par_scan_parse(const char *s);
+
+#endif
@@ -4,45 +4,355 @@ Oladotun Adigun
 oaadigun
 
 How to compile (on CS Linux systems because im on windows):
-    gcc -o prime prime.c
+    gcc -O2 -o prime prime.c primes.c -lpthread
 
 How to run:
-    ./prime
+    ./prime                       read one number from stdin, say if it is prime
+    ./prime -r <lo> <hi> [-l]     count (or with -l list) the primes in [lo, hi]
+    ./prime -b [file]             batch: classify every number in file (or stdin)
+    ./prime -w <table> -x <limit> [-B <bitmap limit>]
+                                  precompute pi(x) up to limit into a table file
+    ./prime -T <table> -r ...     answer -r from the table
+    ./prime -T <table> -p [file]  batch: print pi(x) for every x in file (or stdin)
+    -t <threads> sets the number of worker threads (default: all CPUs)
 
 Tested on: moat.cs.uab.edu (CS Linux systems)
 
 Thiscode reads an integer from input and prints
 whether it is prime or not.
+The number theory lives in primes.c: Miller-Rabin for single numbers, a
+segmented mod-30 wheel sieve for ranges, and mmapped tables of pi at every
+sieve segment boundary (plus an optional sieved bitmap) so repeated range
+queries only sieve or popcount one partial segment at each end.
 */
 
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-int main(void) {
-    int given_number;
+#include "primes.h"
 
-    // Read input using scanf
-    if (scanf("%d", &given_number) != 1) {
-        // If input is not an integer, exit
-        return 0;
+#define BATCH_CHUNK 4096  // numbers per work unit in batch mode
+
+// ---------------------------------------------------------------------------
+// Batch mode
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const uint64_t *nums;
+    uint64_t *result;             // 1/0 for primality, or pi(x) with a table
+    size_t count;
+    const primes_table_t *table;  // NULL: test primality
+    _Atomic size_t next;
+} batch_job_t;
+
+static void *batch_worker(void *arg) {
+    batch_job_t *job = (batch_job_t *)arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&job->next, BATCH_CHUNK);
+        if (i >= job->count) break;
+        size_t end = i + BATCH_CHUNK < job->count ? i + BATCH_CHUNK : job->count;
+        for (; i < end; i++)
+            job->result[i] = job->table ? primes_table_pi(job->table, job->nums[i])
+                                        : (uint64_t)primes_is_prime(job->nums[i]);
     }
+    return NULL;
+}
 
-    
-    if (given_number <= 1) {
-        printf("The number is not prime\n");
-        return 0;
+// Map a regular file, or slurp stdin / pipes into a malloc'd buffer
+static char *load_input(const char *path, size_t *len, int *mapped) {
+    int fd = path ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    *mapped = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        char *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+            if (path) close(fd);
+            *len = (size_t)st.st_size;
+            *mapped = 1;
+            return p;
+        }
+    }
+    size_t cap = 1 << 20, n = 0;
+    char *buf = malloc(cap);
+    ssize_t r;
+    while (buf && (r = read(fd, buf + n, cap - n)) > 0) {
+        n += (size_t)r;
+        if (n == cap) {
+            char *bigger = realloc(buf, cap * 2);
+            if (!bigger) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = bigger;
+            cap *= 2;
+        }
+    }
+    if (path) close(fd);
+    *len = n;
+    return buf;
+}
+
+static int batch_mode(const char *path, const primes_table_t *table, int nthreads) {
+    size_t len;
+    int mapped;
+    char *text = load_input(path, &len, &mapped);
+    if (!text) return 1;
+
+    // parse: every maximal run of digits is one number. Like parse_u64(),
+    // a run with a leading '-' or one that overflows 64 bits is rejected;
+    // it is reported and skipped rather than answered for another number.
+    size_t cap = len / 2 + 1, count = 0;
+    uint64_t *nums = malloc(sizeof(uint64_t) * cap);
+    if (!nums) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < len; ) {
+        if ((unsigned)(text[i] - '0') > 9) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        int negative = start > 0 && text[start - 1] == '-' &&
+                       (start == 1 || (unsigned)(text[start - 2] - '0') > 9);
+        int overflow = 0;
+        uint64_t v = 0;
+        for (; i < len && (unsigned)(text[i] - '0') <= 9; i++) {
+            uint64_t d = (uint64_t)(text[i] - '0');
+            if (v > (UINT64_MAX - d) / 10) overflow = 1;
+            v = v * 10 + d;
+        }
+        if (negative || overflow) {
+            fprintf(stderr, "Skipping invalid number %s%.*s%s\n", negative ? "-" : "",
+                    (int)(i - start > 40 ? 40 : i - start), text + start, i - start > 40 ? "..." : "");
+            continue;
+        }
+        nums[count++] = v;
+    }
+    if (mapped) munmap(text, len);
+    else free(text);
+
+    batch_job_t job;
+    job.nums = nums;
+    job.count = count;
+    job.table = table;
+    job.result = malloc(sizeof(uint64_t) * (count + 1));
+    atomic_init(&job.next, 0);
+    if (!job.result) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    pthread_t *tids = malloc(sizeof(pthread_t) * (size_t)nthreads);
+    int started = 0;
+    while (tids && started < nthreads && pthread_create(&tids[started], NULL, batch_worker, &job) == 0)
+        started++;
+    if (started == 0) batch_worker(&job);
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    free(tids);
+
+    // format into one buffer and write it in large pieces
+    size_t out_cap = 1 << 20, used = 0;
+    char *out = malloc(out_cap);
+    if (!out) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (out_cap - used < 64) {
+            fwrite(out, 1, used, stdout);
+            used = 0;
+        }
+        char tmp[24];
+        int l = 0;
+        uint64_t v = nums[i];
+        do { tmp[l++] = (char)('0' + v % 10); v /= 10; } while (v);
+        while (l) out[used++] = tmp[--l];
+        if (table) {
+            out[used++] = ' ';
+            v = job.result[i];
+            if (v == UINT64_MAX) {
+                memcpy(out + used, "above table limit", 17);
+                used += 17;
+            } else {
+                do { tmp[l++] = (char)('0' + v % 10); v /= 10; } while (v);
+                while (l) out[used++] = tmp[--l];
+            }
+            out[used++] = '\n';
+            continue;
+        }
+        const char *verdict = job.result[i] ? " prime\n" : " not prime\n";
+        size_t vl = strlen(verdict);
+        memcpy(out + used, verdict, vl);
+        used += vl;
+    }
+    fwrite(out, 1, used, stdout);
+    free(out);
+    free(nums);
+    free(job.result);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+
+// Decimal digits only: strtoull would also take leading spaces, '+' and '-'
+// (negated). Values past 2^64 - 1 are rejected with errno = ERANGE.
+static int parse_u64(const char *s, uint64_t *out) {
+    char *end;
+    if ((unsigned)(*s - '0') > 9) return 0;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (*end || errno == ERANGE) return 0;
+    *out = v;
+    return 1;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int range_mode(uint64_t lo, uint64_t hi, int list, const primes_table_t *table, int nthreads) {
+    uint64_t n;
+    if (lo > hi || hi > PRIMES_MAX) {
+        printf("Range must satisfy lo <= hi <= %llu\n", (unsigned long long)PRIMES_MAX);
+        return 1;
+    }
+    // the table answers anything up to its limit; past it we sieve
+    if (table && hi <= primes_table_limit(table))
+        n = list ? primes_table_list(table, lo, hi, nthreads, stdout) : primes_table_count(table, lo, hi);
+    else
+        n = list ? primes_list(lo, hi, nthreads, stdout) : primes_count(lo, hi, nthreads);
+    if (n == UINT64_MAX) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    if (!list)
+        printf("%llu primes in [%llu, %llu]\n", (unsigned long long)n,
+               (unsigned long long)lo, (unsigned long long)hi);
+    return 0;
+}
+
+static int build_mode(const char *path, uint64_t limit, uint64_t bitmap_limit, int nthreads) {
+    if (limit > PRIMES_MAX) {
+        printf("Table limit must be at most %llu\n", (unsigned long long)PRIMES_MAX);
+        return 1;
+    }
+    double t0 = now_sec();
+    if (primes_table_build(path, limit, bitmap_limit, nthreads) != 0) {
+        perror(path);
+        return 1;
+    }
+    double t1 = now_sec();
+    primes_table_t *table = primes_table_open(path);
+    if (!table) {
+        perror(path);
+        return 1;
+    }
+    double t2 = now_sec();
+    printf("Wrote %s: pi(%llu) = %llu, built in %.2f s, opens in %.1f us\n", path,
+           (unsigned long long)limit, (unsigned long long)primes_table_pi(table, limit),
+           t1 - t0, (t2 - t1) * 1e6);
+    primes_table_close(table);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int list = 0;
+    const char *mode = NULL;
+    uint64_t lo = 0, hi = 0, limit = 0, bitmap_limit = 0;
+    const char *file = NULL, *table_path = NULL, *build_path = NULL;
+    if (nthreads < 1) nthreads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+            if (nthreads < 1) nthreads = 1;
+        } else if (strcmp(argv[i], "-l") == 0) {
+            list = 1;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 2 < argc) {
+            mode = "range";
+            if (!parse_u64(argv[i + 1], &lo) || !parse_u64(argv[i + 2], &hi)) {
+                printf(errno == ERANGE ? "Range bound above %llu\n" : "Invalid range\n",
+                       (unsigned long long)UINT64_MAX);
+                return 1;
+            }
+            i += 2;
+        } else if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "-p") == 0) {
+            mode = argv[i][1] == 'b' ? "batch" : "pi";
+            if (i + 1 < argc && argv[i + 1][0] != '-') file = argv[++i];
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            table_path = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            mode = "build";
+            build_path = argv[++i];
+        } else if ((strcmp(argv[i], "-x") == 0 || strcmp(argv[i], "-B") == 0) && i + 1 < argc) {
+            if (!parse_u64(argv[i + 1], argv[i][1] == 'x' ? &limit : &bitmap_limit)) {
+                printf(errno == ERANGE ? "Limit above %llu\n" : "Invalid limit\n", (unsigned long long)UINT64_MAX);
+                return 1;
+            }
+            i++;
+        } else {
+            printf("Usage: %s [-t threads] [-T table] [-r lo hi [-l] | -b [file] | -p [file]]\n"
+                   "       %s [-t threads] -w table -x limit [-B bitmap_limit]\n", argv[0], argv[0]);
+            return 1;
+        }
     }
 
-    
-    int is_prime = 1; 
-    for (long long i = 2; i * i <= given_number; i++) {
-        if (given_number % i == 0) {
-            is_prime = 0;
-            break;
+    if (mode && strcmp(mode, "build") == 0) return build_mode(build_path, limit, bitmap_limit, nthreads);
+
+    primes_table_t *table = NULL;
+    if (table_path) {
+        table = primes_table_open(table_path);
+        if (!table) {
+            perror(table_path);
+            return 1;
         }
     }
+    if (mode && strcmp(mode, "pi") == 0 && !table) {
+        printf("-p needs a table (-T)\n");
+        return 1;
+    }
+    if (mode) {
+        int rc = strcmp(mode, "range") == 0 ? range_mode(lo, hi, list, table, nthreads)
+               : batch_mode(file, strcmp(mode, "pi") == 0 ? table : NULL, nthreads);
+        primes_table_close(table);
+        return rc;
+    }
+    primes_table_close(table);
+
+    char given_number[32];
+    uint64_t value;
 
+    // Read input using scanf; negative numbers are never prime
+    if (scanf("%31s", given_number) != 1) return 0;
+    if (given_number[0] == '-' && given_number[1] >= '0' && given_number[1] <= '9') {
+        value = 0;
+    } else if (!parse_u64(given_number, &value)) {
+        // If input is not an integer, exit
+        if (errno == ERANGE) printf("The number is too large to test (above %llu)\n", (unsigned long long)UINT64_MAX);
+        return 0;
+    }
 
-    if (is_prime) {
+    if (primes_is_prime(value)) {
         printf("The number is prime\n");
     } else {
         printf("The number is not prime\n");
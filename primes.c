@@ -0,0 +1,623 @@
+/* primes.c
+   Miller-Rabin, segmented wheel sieve and mmapped prime tables;
+   see primes.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "primes.h"
+
+#define SEGMENT_BYTES PRIMES_SEGMENT_BYTES
+#define SEGMENT_SPAN PRIMES_SEGMENT_SPAN
+#define SUB_BYTES 1024              // tables also count primes per 1 KB sub-block
+#define SUB_SPAN ((uint64_t)SUB_BYTES * 30)
+#define SUBS_PER_SEGMENT (SEGMENT_BYTES / SUB_BYTES)
+#define LIST_WAVE 8                 // segments per thread between ordered flushes
+#define LIST_TEXT_MAX(bytes) ((size_t)(bytes) * 8 * 21 + 1)  // 8 primes of <= 20 digits per byte
+
+// ---------------------------------------------------------------------------
+// Miller-Rabin with Montgomery multiplication
+// ---------------------------------------------------------------------------
+
+typedef unsigned __int128 u128;
+
+typedef struct {
+    uint64_t n;
+    uint64_t ninv;   // n^-1 mod 2^64
+    uint64_t r2;     // 2^128 mod n
+    uint64_t one;    // 2^64 mod n, i.e. 1 in Montgomery form
+} mont_t;
+
+static void mont_init(mont_t *m, uint64_t n) {
+    uint64_t inv = n; // Newton iteration: each step doubles the correct bits
+    for (int i = 0; i < 5; i++) inv *= 2 - n * inv;
+    m->n = n;
+    m->ninv = inv;
+    m->one = (uint64_t)(-n) % n;
+    m->r2 = (uint64_t)((u128)m->one * m->one % n);
+}
+
+// REDC of a*b: t - q*n is divisible by 2^64 when q = lo * n^-1, so only the
+// high halves need subtracting and nothing overflows even for n near 2^64.
+static inline uint64_t mont_mul(const mont_t *m, uint64_t a, uint64_t b) {
+    u128 t = (u128)a * b;
+    uint64_t q = (uint64_t)t * m->ninv;
+    uint64_t qn_hi = (uint64_t)(((u128)q * m->n) >> 64);
+    uint64_t t_hi = (uint64_t)(t >> 64);
+    return t_hi >= qn_hi ? t_hi - qn_hi : t_hi - qn_hi + m->n;
+}
+
+static inline uint64_t mont_to(const mont_t *m, uint64_t a) {
+    return mont_mul(m, a % m->n, m->r2);
+}
+
+static uint64_t mont_pow(const mont_t *m, uint64_t base, uint64_t e) {
+    uint64_t r = m->one;
+    while (e) {
+        if (e & 1) r = mont_mul(m, r, base);
+        base = mont_mul(m, base, base);
+        e >>= 1;
+    }
+    return r;
+}
+
+static const uint32_t small_primes[] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97
+};
+
+int primes_is_prime(uint64_t n) {
+    if (n < 2) return 0;
+    for (size_t i = 0; i < sizeof(small_primes) / sizeof(small_primes[0]); i++) {
+        if (n == small_primes[i]) return 1;
+        if (n % small_primes[i] == 0) return 0;
+    }
+    if (n < 97 * 97) return 1;
+
+    // these seven bases are exact for every n < 2^64
+    static const uint64_t bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+    uint64_t d = n - 1;
+    int s = __builtin_ctzll(d);
+    d >>= s;
+
+    mont_t m;
+    mont_init(&m, n);
+    uint64_t minus_one = m.n - m.one; // n-1 in Montgomery form
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        uint64_t a = bases[i] % n;
+        if (a == 0) continue;
+        uint64_t x = mont_pow(&m, mont_to(&m, a), d);
+        if (x == m.one || x == minus_one) continue;
+        int witness = 1;
+        for (int r = 1; r < s; r++) {
+            x = mont_mul(&m, x, x);
+            if (x == minus_one) {
+                witness = 0;
+                break;
+            }
+        }
+        if (witness) return 0;
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Segmented mod-30 wheel sieve
+// ---------------------------------------------------------------------------
+
+static const uint8_t wheel[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+static int8_t residue_bit[30];    // bit index for n % 30, or -1 if not coprime to 30
+static uint8_t next_coprime[30];  // distance from k to the next k' >= k coprime to 30
+static pthread_once_t wheel_once = PTHREAD_ONCE_INIT;
+
+static void wheel_init(void) {
+    for (int r = 0; r < 30; r++) residue_bit[r] = -1;
+    for (int b = 0; b < 8; b++) residue_bit[wheel[b]] = (int8_t)b;
+    for (int r = 0; r < 30; r++) {
+        int d = 0;
+        while (residue_bit[(r + d) % 30] < 0) d++;
+        next_coprime[r] = (uint8_t)d;
+    }
+}
+
+// 2, 3 and 5 are not on the wheel
+static uint64_t small_in_range(uint64_t lo, uint64_t hi, FILE *out) {
+    static const uint64_t tiny[] = { 2, 3, 5 };
+    uint64_t n = 0;
+    for (int i = 0; i < 3; i++) {
+        if (tiny[i] >= lo && tiny[i] <= hi) {
+            n++;
+            if (out) fprintf(out, "%llu\n", (unsigned long long)tiny[i]);
+        }
+    }
+    return n;
+}
+
+static uint64_t isqrt_ceil(uint64_t x) {
+    uint64_t root = 1;
+    while (root * root <= x) root++;
+    return root;
+}
+
+// Primes >= 7 up to limit with a plain odd-only sieve
+static uint32_t *base_primes(uint64_t limit, size_t *count) {
+    size_t half = (size_t)(limit / 2) + 1;
+    uint8_t *comp = calloc(half, 1);
+    uint32_t *primes = malloc(sizeof(uint32_t) * (half / 2 + 16));
+    size_t n = 0;
+    if (!comp || !primes) {
+        free(comp);
+        free(primes);
+        return NULL;
+    }
+    for (uint64_t i = 3; i * i <= limit; i += 2)
+        if (!comp[i / 2])
+            for (uint64_t j = i * i; j <= limit; j += 2 * i) comp[j / 2] = 1;
+    for (uint64_t i = 7; i <= limit; i += 2)
+        if (!comp[i / 2]) primes[n++] = (uint32_t)i;
+    free(comp);
+    *count = n;
+    return primes;
+}
+
+typedef struct {
+    uint64_t lo, hi;          // inclusive query range
+    uint64_t base;            // first segment starts at base, a multiple of 30
+    uint64_t nsegments;
+    const uint32_t *primes;
+    size_t nprimes;
+    _Atomic uint64_t next;    // next segment to hand out
+    int nthreads;
+    uint64_t *counts;         // per thread prime counts
+    uint64_t *seg_counts;     // optional: per segment counts instead
+    uint16_t *sub_counts;     // optional: per sub-block counts as well
+    uint8_t *bitmap;          // optional: sieved bytes of the first bitmap_segs segments
+    uint64_t bitmap_segs;
+    // list mode: one text buffer per segment of the current wave
+    int list;
+    uint64_t wave_start, wave_end;
+    char **texts;
+    size_t *text_len;
+} sieve_job_t;
+
+// Sieve [start, end) into bits[]; afterwards a set bit means prime
+static size_t sieve_span(const uint32_t *primes, size_t nprimes, uint64_t start, uint64_t end, uint8_t *bits) {
+    size_t bytes = (size_t)((end - start + 29) / 30);
+    memset(bits, 0xff, bytes);
+
+    for (size_t i = 0; i < nprimes; i++) {
+        uint64_t p = primes[i];
+        if (p * p >= end) break;
+        // first multiplier k >= p with p*k >= start and k coprime to 30
+        uint64_t k = (start + p - 1) / p;
+        if (k < p) k = p;
+        k += next_coprime[k % 30];
+        if (p * k >= end) continue;
+        // the 8 multipliers coprime to 30 starting at k hit 8 fixed
+        // (byte, bit) slots, and the pattern repeats every p bytes
+        uint64_t pos[8];
+        uint8_t mask[8];
+        for (int j = 0; j < 8; j++) {
+            uint64_t off = p * k - start;
+            pos[j] = off / 30;
+            mask[j] = (uint8_t)~(1u << residue_bit[off % 30]);
+            k += 1 + next_coprime[(k + 1) % 30];
+        }
+        for (;;) {
+            for (int j = 0; j < 8; j++) {
+                if (pos[j] >= bytes) goto next_prime;
+                bits[pos[j]] &= mask[j];
+                pos[j] += p;
+            }
+        }
+    next_prime:;
+    }
+    if (start == 0) bits[0] &= (uint8_t)~1u; // 1 is not prime
+    return bytes;
+}
+
+static size_t sieve_segment(const sieve_job_t *job, uint64_t seg, uint8_t *bits) {
+    uint64_t start = job->base + seg * SEGMENT_SPAN;
+    uint64_t end = start + SEGMENT_SPAN;               // exclusive
+    if (end > job->hi + 1) end = job->hi + 1;
+    return sieve_span(job->primes, job->nprimes, start, end, bits);
+}
+
+// Number of set bits in bits[0, bytes) (byte 0 stands for start..start+29)
+// whose values fall in [lo, hi]
+static uint64_t count_bits(const uint8_t *bits, size_t bytes, uint64_t start, uint64_t lo, uint64_t hi) {
+    uint64_t c = 0;
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t w;
+        memcpy(&w, bits + i, 8);
+        c += (uint64_t)__builtin_popcountll(w);
+    }
+    for (; i < bytes; i++) c += (uint64_t)__builtin_popcount(bits[i]);
+    // drop wheel positions outside [lo, hi] in the first and last bytes
+    for (int edge = 0; edge < 2; edge++) {
+        size_t b = edge == 0 ? 0 : bytes - 1;
+        if (edge == 1 && bytes == 1) break;
+        for (int k = 0; k < 8; k++) {
+            uint64_t v = start + b * 30 + wheel[k];
+            if ((bits[b] >> k & 1) && (v < lo || v > hi)) c--;
+        }
+    }
+    return c;
+}
+
+static size_t list_bits(const uint8_t *bits, size_t bytes, uint64_t start, uint64_t lo, uint64_t hi,
+                        char *out, uint64_t *count) {
+    char *p = out;
+    for (size_t b = 0; b < bytes; b++) {
+        uint8_t byte = bits[b];
+        while (byte) {
+            int k = __builtin_ctz(byte);
+            byte &= (uint8_t)(byte - 1);
+            uint64_t v = start + b * 30 + wheel[k];
+            if (v < lo || v > hi) continue;
+            char tmp[24];
+            int len = 0;
+            do { tmp[len++] = (char)('0' + v % 10); v /= 10; } while (v);
+            while (len) *p++ = tmp[--len];
+            *p++ = '\n';
+            (*count)++;
+        }
+    }
+    return (size_t)(p - out);
+}
+
+typedef struct {
+    sieve_job_t *job;
+    int tid;
+} sieve_arg_t;
+
+static void *sieve_worker(void *arg) {
+    sieve_arg_t *sa = (sieve_arg_t *)arg;
+    sieve_job_t *job = sa->job;
+    uint8_t *bits = malloc(SEGMENT_BYTES);
+    if (!bits) return NULL;
+
+    uint64_t limit = job->list ? job->wave_end : job->nsegments;
+    for (;;) {
+        uint64_t seg = atomic_fetch_add(&job->next, 1);
+        if (seg >= limit) break;
+        uint64_t start = job->base + seg * SEGMENT_SPAN;
+        size_t bytes = sieve_segment(job, seg, bits);
+        if (job->list) {
+            size_t slot = (size_t)(seg - job->wave_start);
+            uint64_t n = 0;
+            job->texts[slot] = malloc(LIST_TEXT_MAX(bytes));
+            job->text_len[slot] = job->texts[slot] ? list_bits(bits, bytes, start, job->lo, job->hi, job->texts[slot], &n) : 0;
+            job->counts[sa->tid] += n;
+            continue;
+        }
+        uint64_t n;
+        if (job->sub_counts) {
+            // at most 8 primes per byte, so a sub-block count fits 16 bits
+            uint16_t *sub = job->sub_counts + seg * SUBS_PER_SEGMENT;
+            n = 0;
+            for (size_t b = 0; b * SUB_BYTES < bytes; b++) {
+                size_t len = bytes - b * SUB_BYTES < SUB_BYTES ? bytes - b * SUB_BYTES : SUB_BYTES;
+                sub[b] = (uint16_t)count_bits(bits + b * SUB_BYTES, len, start + b * SUB_SPAN, job->lo, job->hi);
+                n += sub[b];
+            }
+        } else {
+            n = count_bits(bits, bytes, start, job->lo, job->hi);
+        }
+        if (job->seg_counts) job->seg_counts[seg] = n;
+        else job->counts[sa->tid] += n;
+        if (job->bitmap && seg < job->bitmap_segs)
+            memcpy(job->bitmap + seg * SEGMENT_BYTES, bits, bytes);
+    }
+    free(bits);
+    return NULL;
+}
+
+static void run_workers(sieve_job_t *job) {
+    int nthreads = job->nthreads;
+    pthread_t *tids = malloc(sizeof(pthread_t) * (size_t)nthreads);
+    sieve_arg_t *args = malloc(sizeof(sieve_arg_t) * (size_t)nthreads);
+    int started = 0;
+    if (tids && args) {
+        for (; started < nthreads; started++) {
+            args[started].job = job;
+            args[started].tid = started;
+            if (pthread_create(&tids[started], NULL, sieve_worker, &args[started]) != 0) break;
+        }
+    }
+    if (started == 0) { // no threads: do the work here
+        sieve_arg_t self = { job, 0 };
+        sieve_worker(&self);
+    }
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    free(tids);
+    free(args);
+}
+
+static int job_init(sieve_job_t *job, uint64_t lo, uint64_t hi, int nthreads) {
+    pthread_once(&wheel_once, wheel_init);
+    memset(job, 0, sizeof(*job));
+    if (hi > PRIMES_MAX || lo > hi) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (nthreads < 1) nthreads = 1;
+    job->lo = lo;
+    job->hi = hi;
+    job->nthreads = nthreads;
+    job->base = lo - lo % 30;
+    job->nsegments = (hi - job->base) / SEGMENT_SPAN + 1;
+    job->primes = base_primes(isqrt_ceil(hi), &job->nprimes);
+    job->counts = calloc((size_t)nthreads, sizeof(uint64_t));
+    if (!job->primes || !job->counts) {
+        free((void *)job->primes);
+        free(job->counts);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t job_total(const sieve_job_t *job) {
+    uint64_t total = 0;
+    for (int i = 0; i < job->nthreads; i++) total += job->counts[i];
+    return total;
+}
+
+static void job_free(sieve_job_t *job) {
+    free((void *)job->primes);
+    free(job->counts);
+}
+
+uint64_t primes_count(uint64_t lo, uint64_t hi, int nthreads) {
+    sieve_job_t job;
+    if (job_init(&job, lo, hi, nthreads) != 0) return UINT64_MAX;
+    run_workers(&job);
+    uint64_t total = small_in_range(lo, hi, NULL) + job_total(&job);
+    job_free(&job);
+    return total;
+}
+
+uint64_t primes_list(uint64_t lo, uint64_t hi, int nthreads, FILE *out) {
+    sieve_job_t job;
+    if (job_init(&job, lo, hi, nthreads) != 0) return UINT64_MAX;
+
+    // sieve a wave of segments in parallel, then write them out in order
+    uint64_t wave = (uint64_t)job.nthreads * LIST_WAVE;
+    job.list = 1;
+    job.texts = calloc((size_t)wave, sizeof(char *));
+    job.text_len = calloc((size_t)wave, sizeof(size_t));
+    if (!job.texts || !job.text_len) {
+        free(job.texts);
+        free(job.text_len);
+        job_free(&job);
+        errno = ENOMEM;
+        return UINT64_MAX;
+    }
+    uint64_t total = small_in_range(lo, hi, out);
+    for (uint64_t w = 0; w < job.nsegments; w += wave) {
+        job.wave_start = w;
+        job.wave_end = w + wave < job.nsegments ? w + wave : job.nsegments;
+        atomic_store(&job.next, w);
+        run_workers(&job);
+        for (uint64_t s = 0; s < job.wave_end - w; s++) {
+            if (job.texts[s]) fwrite(job.texts[s], 1, job.text_len[s], out);
+            free(job.texts[s]);
+            job.texts[s] = NULL;
+        }
+    }
+    total += job_total(&job);
+    free(job.texts);
+    free(job.text_len);
+    job_free(&job);
+    return total;
+}
+
+// ---------------------------------------------------------------------------
+// Precomputed tables
+// ---------------------------------------------------------------------------
+
+#define TABLE_MAGIC "PRIMTAB1"
+
+// File layout: header, uint64_t cum[nblocks + 1] with cum[i] = number of
+// primes below i * span, uint16_t sub[nblocks * SUBS_PER_SEGMENT] with the
+// count of each sub-block, then bitmap_bytes of wheel bytes starting at 0.
+typedef struct {
+    char magic[8];
+    uint64_t limit;
+    uint64_t span;
+    uint64_t sub_span;
+    uint64_t nblocks;
+    uint64_t bitmap_end;      // bitmap covers values below this
+    uint64_t bitmap_bytes;
+} table_header_t;
+
+struct primes_table {
+    void *map;
+    size_t map_bytes;
+    const table_header_t *hdr;
+    const uint64_t *cum;
+    const uint16_t *sub;
+    const uint8_t *bitmap;
+    uint32_t *primes;         // base primes up to sqrt(limit) for residual sieves
+    size_t nprimes;
+};
+
+static size_t table_bytes(uint64_t nblocks, uint64_t bitmap_bytes) {
+    return sizeof(table_header_t) + sizeof(uint64_t) * (size_t)(nblocks + 1) +
+           sizeof(uint16_t) * (size_t)nblocks * SUBS_PER_SEGMENT + (size_t)bitmap_bytes;
+}
+
+int primes_table_build(const char *path, uint64_t limit, uint64_t bitmap_limit, int nthreads) {
+    sieve_job_t job;
+    if (job_init(&job, 0, limit, nthreads) != 0) return -1;
+
+    uint64_t nblocks = job.nsegments;
+    uint64_t bitmap_segs = bitmap_limit ? (bitmap_limit - 1) / SEGMENT_SPAN + 1 : 0;
+    if (bitmap_segs > nblocks) bitmap_segs = nblocks;
+    uint64_t bitmap_bytes = bitmap_segs * SEGMENT_BYTES;
+    size_t bytes = table_bytes(nblocks, bitmap_bytes);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        job_free(&job);
+        return -1;
+    }
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)bytes) == 0)
+        map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int saved = errno;
+        close(fd);
+        unlink(path);
+        job_free(&job);
+        errno = saved;
+        return -1;
+    }
+    table_header_t *hdr = map;
+    uint64_t *cum = (uint64_t *)(hdr + 1);
+
+    uint16_t *sub = (uint16_t *)(cum + nblocks + 1);
+
+    // the workers leave per segment counts in cum[1..] and sub[], and copy
+    // their sieved bytes straight into the mapped bitmap
+    job.seg_counts = cum + 1;
+    job.sub_counts = sub;
+    job.bitmap = (uint8_t *)(sub + nblocks * SUBS_PER_SEGMENT);
+    job.bitmap_segs = bitmap_segs;
+    run_workers(&job);
+    job_free(&job);
+
+    cum[0] = 0;
+    cum[1] += small_in_range(0, limit, NULL);
+    for (uint64_t i = 1; i <= nblocks; i++) cum[i] += cum[i - 1];
+
+    hdr->limit = limit;
+    hdr->span = SEGMENT_SPAN;
+    hdr->sub_span = SUB_SPAN;
+    hdr->nblocks = nblocks;
+    hdr->bitmap_end = bitmap_segs * SEGMENT_SPAN < limit + 1 ? bitmap_segs * SEGMENT_SPAN : limit + 1;
+    hdr->bitmap_bytes = bitmap_bytes;
+    // magic last, so an interrupted build never looks like a valid table
+    memcpy(hdr->magic, TABLE_MAGIC, sizeof(hdr->magic));
+
+    int rc = msync(map, bytes, MS_SYNC);
+    int saved = errno;
+    munmap(map, bytes);
+    close(fd);
+    errno = saved;
+    return rc;
+}
+
+primes_table_t *primes_table_open(const char *path) {
+    pthread_once(&wheel_once, wheel_init);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(table_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const table_header_t *hdr = map;
+    if (memcmp(hdr->magic, TABLE_MAGIC, sizeof(hdr->magic)) != 0 || hdr->span != SEGMENT_SPAN ||
+        hdr->sub_span != SUB_SPAN ||
+        hdr->limit > PRIMES_MAX || hdr->nblocks != hdr->limit / SEGMENT_SPAN + 1 ||
+        table_bytes(hdr->nblocks, hdr->bitmap_bytes) != (size_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    primes_table_t *t = calloc(1, sizeof(*t));
+    if (t) t->primes = base_primes(isqrt_ceil(hdr->limit), &t->nprimes);
+    if (!t || !t->primes) {
+        free(t);
+        munmap(map, (size_t)st.st_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    t->map = map;
+    t->map_bytes = (size_t)st.st_size;
+    t->hdr = hdr;
+    t->cum = (const uint64_t *)(hdr + 1);
+    t->sub = (const uint16_t *)(t->cum + hdr->nblocks + 1);
+    t->bitmap = (const uint8_t *)(t->sub + hdr->nblocks * SUBS_PER_SEGMENT);
+    madvise(map, t->map_bytes, MADV_RANDOM);
+    return t;
+}
+
+void primes_table_close(primes_table_t *t) {
+    if (!t) return;
+    munmap(t->map, t->map_bytes);
+    free(t->primes);
+    free(t);
+}
+
+uint64_t primes_table_limit(const primes_table_t *t) {
+    return t->hdr->limit;
+}
+
+uint64_t primes_table_pi(const primes_table_t *t, uint64_t x) {
+    if (x > t->hdr->limit) return UINT64_MAX;
+    uint64_t seg = x / SEGMENT_SPAN;
+    uint64_t sb = x / SUB_SPAN;
+    uint64_t start = sb * SUB_SPAN;
+    uint64_t n = t->cum[seg];
+    if (seg == 0) n += small_in_range(0, x, NULL);
+    for (uint64_t i = seg * SUBS_PER_SEGMENT; i < sb; i++) n += t->sub[i];
+
+    if (x < t->hdr->bitmap_end) {
+        const uint8_t *bits = t->bitmap + sb * SUB_BYTES;
+        return n + count_bits(bits, (size_t)((x - start) / 30 + 1), start, start, x);
+    }
+    // above the bitmap: sieve the partial sub-block
+    uint8_t bits[SUB_BYTES];
+    size_t bytes = sieve_span(t->primes, t->nprimes, start, x + 1, bits);
+    return n + count_bits(bits, bytes, start, start, x);
+}
+
+uint64_t primes_table_count(const primes_table_t *t, uint64_t lo, uint64_t hi) {
+    if (lo > hi || hi > t->hdr->limit) return UINT64_MAX;
+    return primes_table_pi(t, hi) - (lo ? primes_table_pi(t, lo - 1) : 0);
+}
+
+uint64_t primes_table_list(const primes_table_t *t, uint64_t lo, uint64_t hi, int nthreads, FILE *out) {
+    uint64_t end = t->hdr->bitmap_end;
+    if (lo > hi) return UINT64_MAX;
+    if (lo >= end) return primes_list(lo, hi, nthreads, out);
+
+    char *text = malloc(LIST_TEXT_MAX(SEGMENT_BYTES));
+    if (!text) return UINT64_MAX;
+    uint64_t total = small_in_range(lo, hi, out);
+    uint64_t top = hi < end ? hi : end - 1;
+    for (uint64_t seg = lo / SEGMENT_SPAN; seg <= top / SEGMENT_SPAN; seg++) {
+        uint64_t start = seg * SEGMENT_SPAN;
+        uint64_t last = start + SEGMENT_SPAN - 1 < top ? start + SEGMENT_SPAN - 1 : top;
+        size_t len = list_bits(t->bitmap + seg * SEGMENT_BYTES, (size_t)((last - start) / 30 + 1),
+                               start, lo, last, text, &total);
+        fwrite(text, 1, len, out);
+    }
+    free(text);
+    if (hi >= end) {
+        uint64_t rest = primes_list(end, hi, nthreads, out);
+        if (rest == UINT64_MAX) return UINT64_MAX;
+        total += rest;
+    }
+    return total;
+}
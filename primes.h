@@ -0,0 +1,68 @@
+/* primes.h
+   Primality testing, segmented-sieve prime counting/enumeration and
+   precomputed prime tables.
+   Used by prime.c; compile primes.c alongside it:
+       gcc -O2 -Wall prime.c primes.c -lpthread -o prime
+*/
+
+#ifndef PRIMES_H
+#define PRIMES_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Largest hi accepted by the sieve (base primes up to 1e8) */
+#define PRIMES_MAX 10000000000000000ULL
+
+/* Numbers covered by one sieve segment: 32 KB of mod-30 wheel bytes */
+#define PRIMES_SEGMENT_BYTES (32 * 1024)
+#define PRIMES_SEGMENT_SPAN ((uint64_t)PRIMES_SEGMENT_BYTES * 30)
+
+/* Deterministic Miller-Rabin, exact for every 64-bit n */
+int primes_is_prime(uint64_t n);
+
+/* ---- segmented sieve ---- */
+
+/* Number of primes in [lo, hi] using nthreads sieving threads.
+   Returns UINT64_MAX if hi > PRIMES_MAX or memory runs out. */
+uint64_t primes_count(uint64_t lo, uint64_t hi, int nthreads);
+
+/* Write the primes in [lo, hi] to out, one per line and in order.
+   Returns the number written, or UINT64_MAX on error. */
+uint64_t primes_list(uint64_t lo, uint64_t hi, int nthreads, FILE *out);
+
+/* ---- precomputed tables ----
+   A table file holds π at every segment boundary up to its limit, a 16-bit
+   prime count for every 30720-number sub-block and, optionally, the sieved
+   wheel bitmap of [0, bitmap_limit). It is mmapped read-only, so opening is
+   O(1) and the kernel shares the pages between processes. π(x) is then one
+   lookup, at most 31 small adds and either a popcount of at most 1 KB of
+   bitmap or a residual sieve of at most one sub-block. A 1e12 table without
+   bitmap is about 73 MB; the bitmap costs 1/30 byte per number (33 MB per
+   1e9). */
+
+typedef struct primes_table primes_table_t;
+
+/* Sieve [0, limit] with nthreads threads and write the table to path.
+   bitmap_limit is clamped to limit. Returns 0 or -1 with errno set. */
+int primes_table_build(const char *path, uint64_t limit, uint64_t bitmap_limit, int nthreads);
+
+/* Map a table written by primes_table_build(); NULL with errno set if the
+   file is missing or not a valid table. */
+primes_table_t *primes_table_open(const char *path);
+void primes_table_close(primes_table_t *t);
+
+/* Largest x the table can answer for */
+uint64_t primes_table_limit(const primes_table_t *t);
+
+/* π(x), the number of primes <= x; UINT64_MAX if x is above the limit */
+uint64_t primes_table_pi(const primes_table_t *t, uint64_t x);
+
+/* Primes in [lo, hi]: π(hi) - π(lo - 1) */
+uint64_t primes_table_count(const primes_table_t *t, uint64_t lo, uint64_t hi);
+
+/* Like primes_list(), reading bits straight from the table's bitmap where
+   it covers the range and sieving the rest */
+uint64_t primes_table_list(const primes_table_t *t, uint64_t lo, uint64_t hi, int nthreads, FILE *out);
+
+#endif
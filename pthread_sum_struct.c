@@ -1,104 +1,545 @@
 /* pthread_sum_struct.c
    Modified pthread_sum.c to use a per-thread structure passed to each thread.
    Removes global variables a, sum, N, size.
-   Compile: gcc -O -Wall pthread_sum_struct.c -lpthread -o pthread_sum_struct
-   Run: ./pthread_sum_struct <# elements> <# threads>
+   Compile: gcc -O2 -Wall pthread_sum_struct.c parallel.c trace.c -lpthread -o pthread_sum_struct
+   Run: ./pthread_sum_struct [-o sum|min|max|dot] [-m naive|kahan|pairwise] [-s steal|static]
+                             [-p] [-H none|thp|hugetlb] [-P] <# elements> <# threads>
+        ./pthread_sum_struct -b [-p] [-H ...] <# elements> [max threads]   (scaling benchmark)
+        ./pthread_sum_struct -L <# elements> [# threads]                  (tail latency)
+        ./pthread_sum_struct -S [-k inclusive|exclusive] <# elements> [max threads]   (scans)
+   -p pins threads across NUMA nodes, -H picks the page size, -P prints page placement.
+   TRACE_FILE=out.json records every pool task, join and steal (see trace.h).
 */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
 #include <unistd.h>
+#include <pthread.h>
+
+#include "parallel.h"
+#include "trace.h"
+
+#define BENCH_REPS 5
+#define PLACEMENT_SAMPLES 65536
+#define PLACEMENT_NODES 64
+#define LATENCY_RUNS 200
+#define SCAN_SEGMENT 1024       // mean segment length for the segmented scans
+
+// allocation options shared by the normal run and the benchmark
+typedef struct {
+    int pin;
+    par_pages_t pages;
+    int show_placement;
+    par_schedule_t schedule;
+} alloc_opts_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a[i] = i + 1, written by the thread that owns [start, end)
+static void init_range(double *a, size_t start, size_t end, void *arg) {
+    (void)arg;
+    for (size_t i = start; i < end; i++)
+        a[i] = (double)(i + 1);
+}
+
+static const char *pages_name(par_pages_t p) {
+    return p == PAR_PAGES_HUGETLB ? "hugetlb" : p == PAR_PAGES_THP ? "thp" : "4k";
+}
+
+// Create a pool of nthreads, pinned if asked
+static par_pool_t *make_pool(const alloc_opts_t *opts, int nthreads) {
+    par_pool_t *pool = par_pool_create(nthreads);
+    if (pool == NULL) {
+        printf("Failed to create %d threads.\n", nthreads);
+        return NULL;
+    }
+    if (opts->pin && par_pool_pin(pool) != 0)
+        printf("Warning: could not pin every thread\n");
+    par_pool_set_schedule(pool, opts->schedule);
+    return pool;
+}
+
+// Create a pool of nthreads and first-touch a new array with it
+static par_pool_t *setup(const alloc_opts_t *opts, int nthreads, long N, par_array_t *arr) {
+    par_pool_t *pool = make_pool(opts, nthreads);
+    if (pool == NULL)
+        return NULL;
+    TRACE_BEGIN("first touch");
+    int rc = par_array_alloc(arr, pool, (size_t)N, opts->pages, init_range, NULL);
+    TRACE_END("first touch");
+    if (rc != 0) {
+        printf("Failed to allocate %ld elements.\n", N);
+        par_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+static void print_placement(const par_array_t *arr) {
+    long nodes[PLACEMENT_NODES];
+    long huge_kb = -1;
+    long sampled = par_array_placement(arr, nodes, PLACEMENT_NODES, PLACEMENT_SAMPLES, &huge_kb);
+    printf("Pages: %s, huge-page backed %ld kB of %zu kB\n", pages_name(arr->pages),
+           huge_kb, arr->n * sizeof(double) / 1024);
+    if (sampled <= 0) {
+        printf("Page placement unavailable\n");
+        return;
+    }
+    printf("Page placement (%ld pages sampled):", sampled);
+    for (int i = 0; i < PLACEMENT_NODES; i++)
+        if (nodes[i]) printf(" node%d=%.1f%%", i, 100.0 * nodes[i] / sampled);
+    printf("\n");
+}
+
+// expected answer for a[i] = i + 1
+static double expected(par_op_t op, long N) {
+    double n = (double)N;
+    switch (op) {
+    case PAR_MIN: return 1.0;
+    case PAR_MAX: return n;
+    case PAR_DOT: return n * (n + 1) * (2 * n + 1) / 6;
+    default:      return n * (n + 1) / 2;
+    }
+}
+
+// Read-bandwidth probe: XOR-fold the array as integers so nothing but memory
+// limits the loop. Gives the ceiling the reductions are compared against.
+typedef struct {
+    const unsigned long long *p;
+    size_t n;
+    unsigned long long sink[256];
+} touch_job_t;
+
+static void touch_task(void *arg, int tid, int nthreads) {
+    touch_job_t *job = (touch_job_t *)arg;
+    size_t start, end;
+    par_partition(job->n, tid, nthreads, &start, &end);
+    unsigned long long x0 = 0, x1 = 0, x2 = 0, x3 = 0;
+    size_t i = start;
+    for (; i + 4 <= end; i += 4) {
+        x0 ^= job->p[i];
+        x1 ^= job->p[i + 1];
+        x2 ^= job->p[i + 2];
+        x3 ^= job->p[i + 3];
+    }
+    for (; i < end; i++) x0 ^= job->p[i];
+    job->sink[tid % 256] = x0 ^ x1 ^ x2 ^ x3;
+}
+
+// best-of-BENCH_REPS time for one reduction on pool
+static double time_reduce(par_pool_t *pool, par_op_t op, par_accuracy_t acc,
+                          const double *a, long N) {
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPS; r++) {
+        double t0 = now_sec();
+        volatile double v = par_reduce(pool, op, acc, a, op == PAR_DOT ? a : NULL, (size_t)N);
+        (void)v;
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+// min/max skip NaNs wherever they are. Copies a into tmp with NaNs over the
+// first eight elements (the ones that seed the vector lanes) and every 4099th
+// after them, and compares par_reduce() with a serial loop; an all-NaN array
+// must give NaN. Returns 0 if everything matches.
+static int check_minmax_nan(par_pool_t *pool, const double *a, double *tmp, long N) {
+    double lo = NAN, hi = NAN;
+    for (long i = 0; i < N; i++) {
+        tmp[i] = (i < 8 || i % 4099 == 0) ? NAN : a[i];
+        if (!isnan(tmp[i]) && (isnan(lo) || tmp[i] < lo)) lo = tmp[i];
+        if (!isnan(tmp[i]) && (isnan(hi) || tmp[i] > hi)) hi = tmp[i];
+    }
+    double pmin = par_reduce(pool, PAR_MIN, PAR_NAIVE, tmp, NULL, (size_t)N);
+    double pmax = par_reduce(pool, PAR_MAX, PAR_NAIVE, tmp, NULL, (size_t)N);
+    int bad = !(pmin == lo || (isnan(pmin) && isnan(lo))) || !(pmax == hi || (isnan(pmax) && isnan(hi)));
+    long n = N < 64 ? N : 64;
+    for (long i = 0; i < n; i++) tmp[i] = NAN;
+    bad |= !isnan(par_reduce(pool, PAR_MIN, PAR_NAIVE, tmp, NULL, (size_t)n));
+    bad |= !isnan(par_reduce(pool, PAR_MAX, PAR_NAIVE, tmp, NULL, (size_t)n));
+    return bad;
+}
+
+// Sweep 1, 2, 4, ... up to max_threads (and max_threads itself), printing
+// time, GB/s and speedup for each operation next to the read-bandwidth probe.
+// Every thread count also runs check_minmax_nan().
+static int run_benchmark(const alloc_opts_t *opts, long N, int max_threads) {
+    static const struct { par_op_t op; par_accuracy_t acc; const char *name; } cases[] = {
+        { PAR_SUM, PAR_NAIVE,    "sum/naive" },
+        { PAR_SUM, PAR_KAHAN,    "sum/kahan" },
+        { PAR_SUM, PAR_PAIRWISE, "sum/pairwise" },
+        { PAR_MIN, PAR_NAIVE,    "min" },
+        { PAR_MAX, PAR_NAIVE,    "max" },
+        { PAR_DOT, PAR_NAIVE,    "dot" },
+    };
+    const int ncases = (int)(sizeof(cases) / sizeof(cases[0]));
+    double base[sizeof(cases) / sizeof(cases[0])];
+    double bytes = (double)N * sizeof(double);
+    int nan_bad = 0;
+    double *tmp = malloc(sizeof(double) * (size_t)N);
+    if (!tmp) {
+        printf("Failed to allocate %ld elements.\n", N);
+        return 1;
+    }
 
-typedef struct thread_info {
-    double *a;               // pointer to array elements
-    double *global_sum;      // pointer to shared sum
-    int N;                   // total number of elements
-    int size;                // number of threads
-    long tid;                // thread index
-    pthread_mutex_t *mutex;  // pointer to shared mutex
-} thread_info_t;
-
-void *compute(void *arg) {
-    thread_info_t *tinfo = (thread_info_t *)arg;
-    int myStart, myEnd, myN, i;
-    long tid = tinfo->tid;
-
-    // determine start and end of the work for this thread
-    myN = tinfo->N / tinfo->size;
-    myStart = tid * myN;
-    myEnd = myStart + myN;
-
-    if (tid == tinfo->size - 1)
-        myEnd = tinfo->N; // last thread gets leftovers
-
-    // compute partial sum
-    double mysum = 0.0;
-    for (i = myStart; i < myEnd; i++)
-        mysum += tinfo->a[i];
-
-    // update global sum with mutex
-    pthread_mutex_lock(tinfo->mutex);
-    *(tinfo->global_sum) += mysum;
-    pthread_mutex_unlock(tinfo->mutex);
-
-    // free the per-thread struct
-    free(tinfo);
+    printf("%-8s %-14s %12s %10s %8s %8s\n", "threads", "op", "time(ms)", "GB/s", "speedup", "%read");
+    for (int t = 1; t <= max_threads; t = (t * 2 > max_threads && t != max_threads) ? max_threads : t * 2) {
+        // fresh array per thread count so each page is first touched by its reader
+        par_array_t arr;
+        par_pool_t *pool = setup(opts, t, N, &arr);
+        if (!pool) {
+            free(tmp);
+            return 1;
+        }
+        const double *a = arr.data;
+        if (opts->show_placement) print_placement(&arr);
 
+        touch_job_t touch = { (const unsigned long long *)a, (size_t)N, {0} };
+        double read_best = 1e30;
+        for (int r = 0; r < BENCH_REPS; r++) {
+            double t0 = now_sec();
+            par_pool_run(pool, touch_task, &touch);
+            double dt = now_sec() - t0;
+            if (dt < read_best) read_best = dt;
+        }
+        double read_gbs = bytes / read_best / 1e9;
+        printf("%-8d %-14s %12.3f %10.2f %8s %8s\n", t, "read-probe", read_best * 1e3, read_gbs, "-", "100");
+
+        for (int c = 0; c < ncases; c++) {
+            TRACE_BEGIN(cases[c].name);
+            double dt = time_reduce(pool, cases[c].op, cases[c].acc, a, N);
+            TRACE_END(cases[c].name);
+            // dot streams a twice from the same pointer, but only N doubles hit memory
+            double gbs = bytes / dt / 1e9;
+            if (t == 1) base[c] = dt;
+            printf("%-8d %-14s %12.3f %10.2f %8.2f %8.0f\n", t, cases[c].name, dt * 1e3, gbs,
+                   base[c] / dt, 100.0 * gbs / read_gbs);
+        }
+        nan_bad |= check_minmax_nan(pool, a, tmp, N);
+        par_array_free(&arr);
+        par_pool_destroy(pool);
+        if (t == max_threads) break;
+    }
+    free(tmp);
+    printf(nan_bad ? "min/max did not skip NaNs\n" : "min/max skip NaNs at every thread count\n");
+    return nan_bad;
+}
+
+// Background load: busy threads that compete with the pool for CPUs, like
+// other tenants on a shared production host.
+static volatile int load_stop;
+
+static void *busy_thread(void *arg) {
+    (void)arg;
+    volatile unsigned long x = 0;
+    while (!load_stop) x++;
     return NULL;
 }
 
+static int cmp_double(const void *x, const void *y) {
+    double a = *(const double *)x, b = *(const double *)y;
+    return (a > b) - (a < b);
+}
+
+// Time LATENCY_RUNS sums per schedule, first on a quiet machine and then with
+// one busy thread per pool thread, and print the latency distribution.
+static int run_latency(const alloc_opts_t *opts, long N, int nthreads) {
+    double *times = malloc(sizeof(double) * LATENCY_RUNS);
+    pthread_t *load = malloc(sizeof(pthread_t) * (size_t)nthreads);
+    if (!times || !load) {
+        free(times);
+        free(load);
+        return 1;
+    }
+
+    printf("%-8s %-6s %10s %10s %10s %10s (ms)\n", "sched", "load", "p50", "p90", "p99", "max");
+    for (int loaded = 0; loaded <= 1; loaded++) {
+        int nload = 0;
+        if (loaded) {
+            load_stop = 0;
+            for (; nload < nthreads; nload++)
+                if (pthread_create(&load[nload], NULL, busy_thread, NULL) != 0) break;
+        }
+        for (int sched = 0; sched <= 1; sched++) {
+            alloc_opts_t o = *opts;
+            o.schedule = sched == 0 ? PAR_STATIC : PAR_STEAL;
+            par_array_t arr;
+            par_pool_t *pool = setup(&o, nthreads, N, &arr);
+            if (!pool) break;
+            for (int r = 0; r < LATENCY_RUNS; r++) {
+                double t0 = now_sec();
+                volatile double v = par_reduce(pool, PAR_SUM, PAR_NAIVE, arr.data, NULL, (size_t)N);
+                (void)v;
+                times[r] = (now_sec() - t0) * 1e3;
+            }
+            qsort(times, LATENCY_RUNS, sizeof(double), cmp_double);
+            printf("%-8s %-6s %10.3f %10.3f %10.3f %10.3f\n", sched == 0 ? "static" : "steal",
+                   loaded ? "busy" : "none", times[LATENCY_RUNS / 2], times[LATENCY_RUNS * 9 / 10],
+                   times[LATENCY_RUNS * 99 / 100], times[LATENCY_RUNS - 1]);
+            par_array_free(&arr);
+            par_pool_destroy(pool);
+        }
+        load_stop = 1;
+        for (int i = 0; i < nload; i++) pthread_join(load[i], NULL);
+    }
+    free(times);
+    free(load);
+    return 0;
+}
+
+// Scan inputs are integers, so every partial sum of the doubles is exact and
+// a correct parallel scan matches the serial loop bit for bit. The int64
+// values use all 64 bits and wrap.
+static unsigned long long mix(unsigned long long i) {
+    i *= 0x9e3779b97f4a7c15ull;
+    return i ^ (i >> 29);
+}
+
+static void init_scan_double(double *a, size_t start, size_t end, void *arg) {
+    (void)arg;
+    for (size_t i = start; i < end; i++)
+        a[i] = (double)(long long)(mix(i) % 2001) - 1000;
+}
+
+// par_array_alloc() hands out untyped memory; this array is only ever used as long long
+static void init_scan_int64(double *a, size_t start, size_t end, void *arg) {
+    long long *p = (long long *)a;
+    (void)arg;
+    for (size_t i = start; i < end; i++)
+        p[i] = (long long)mix(i);
+}
+
+// Serial reference scans; heads == NULL for a plain scan
+static void serial_scan_double(const double *a, const unsigned char *heads, double *out, long N, int exclusive) {
+    double c = 0;
+    for (long i = 0; i < N; i++) {
+        if (heads && heads[i]) c = 0;
+        double x = a[i];
+        out[i] = exclusive ? c : c + x;
+        c += x;
+    }
+}
+
+static void serial_scan_int64(const long long *a, const unsigned char *heads, long long *out, long N, int exclusive) {
+    unsigned long long c = 0;
+    for (long i = 0; i < N; i++) {
+        if (heads && heads[i]) c = 0;
+        unsigned long long x = (unsigned long long)a[i];
+        out[i] = (long long)(exclusive ? c : c + x);
+        c += x;
+    }
+}
+
+// First i where out differs from the serial scan, or -1
+static long check_scan_double(const double *a, const unsigned char *heads, const double *out, long N, int exclusive) {
+    double c = 0;
+    for (long i = 0; i < N; i++) {
+        if (heads && heads[i]) c = 0;
+        if (out[i] != (exclusive ? c : c + a[i])) return i;
+        c += a[i];
+    }
+    return -1;
+}
+
+static long check_scan_int64(const long long *a, const unsigned char *heads, const long long *out, long N, int exclusive) {
+    unsigned long long c = 0;
+    for (long i = 0; i < N; i++) {
+        if (heads && heads[i]) c = 0;
+        unsigned long long x = (unsigned long long)a[i];
+        if ((unsigned long long)out[i] != (exclusive ? c : c + x)) return i;
+        c += x;
+    }
+    return -1;
+}
+
+// Best-of-BENCH_REPS time of scan case c (0 scan/f64, 1 scan/i64,
+// 2 segscan/f64, 3 segscan/i64); pool == NULL times the serial loop
+static double time_scan(par_pool_t *pool, int c, par_scan_t kind, const double *ad, const long long *al,
+                        const unsigned char *heads, double *outd, long long *outl, long N) {
+    const unsigned char *h = c >= 2 ? heads : NULL;
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPS; r++) {
+        double t0 = now_sec();
+        if (!pool && c % 2 == 0) serial_scan_double(ad, h, outd, N, kind == PAR_EXCLUSIVE);
+        else if (!pool) serial_scan_int64(al, h, outl, N, kind == PAR_EXCLUSIVE);
+        else if (c == 0) par_scan_double(pool, kind, ad, outd, (size_t)N);
+        else if (c == 1) par_scan_int64(pool, kind, al, outl, (size_t)N);
+        else if (c == 2) par_segscan_double(pool, kind, ad, heads, outd, (size_t)N);
+        else par_segscan_int64(pool, kind, al, heads, outl, (size_t)N);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+// Sweep thread counts like run_benchmark() over the four scans, after a row
+// for the serial loop. GB/s counts the bytes a scan must move: the input and
+// output (and the head flags for segmented scans), not the input's second
+// read by the block-sum pass. Every result is checked against the serial loop.
+static int run_scan_benchmark(const alloc_opts_t *opts, long N, int max_threads, par_scan_t kind) {
+    static const char *names[] = { "scan/f64", "scan/i64", "segscan/f64", "segscan/i64" };
+    double base[4];
+    int failed = 0;
+    unsigned char *heads = malloc((size_t)N);
+    if (!heads) {
+        printf("Failed to allocate %ld elements.\n", N);
+        return 1;
+    }
+    for (long i = 0; i < N; i++)
+        heads[i] = mix((unsigned long long)i + 0x5bd1e995ull) % SCAN_SEGMENT == 0;
+
+    printf("%s scans, %ld elements, segments of ~%d\n", kind == PAR_EXCLUSIVE ? "Exclusive" : "Inclusive",
+           N, SCAN_SEGMENT);
+    printf("%-8s %-14s %12s %10s %8s %8s\n", "threads", "op", "time(ms)", "GB/s", "speedup", "check");
+    // t == 0 is the serial loop, on arrays first touched by a single thread
+    for (int t = 0; t <= max_threads; t = t == 0 ? 1 : (t * 2 > max_threads && t != max_threads) ? max_threads : t * 2) {
+        par_array_t ad = { 0 }, al = { 0 }, outd = { 0 }, outl = { 0 };
+        par_pool_t *pool = make_pool(opts, t ? t : 1);
+        if (!pool) {
+            free(heads);
+            return 1;
+        }
+        int ok = par_array_alloc(&ad, pool, (size_t)N, opts->pages, init_scan_double, NULL) == 0;
+        ok = ok && par_array_alloc(&al, pool, (size_t)N, opts->pages, init_scan_int64, NULL) == 0;
+        ok = ok && par_array_alloc(&outd, pool, (size_t)N, opts->pages, NULL, NULL) == 0;
+        ok = ok && par_array_alloc(&outl, pool, (size_t)N, opts->pages, NULL, NULL) == 0;
+        if (!ok) {
+            printf("Failed to allocate %ld elements.\n", N);
+            par_array_free(&ad);
+            par_array_free(&al);
+            par_array_free(&outd);
+            par_array_free(&outl);
+            par_pool_destroy(pool);
+            free(heads);
+            return 1;
+        }
+        const long long *a64 = (const long long *)al.data;
+        long long *o64 = (long long *)outl.data;
+
+        for (int c = 0; c < 4; c++) {
+            const unsigned char *h = c >= 2 ? heads : NULL;
+            TRACE_BEGIN(names[c]);
+            double dt = time_scan(t ? pool : NULL, c, kind, ad.data, a64, heads, outd.data, o64, N);
+            TRACE_END(names[c]);
+            long bad = c % 2 == 0 ? check_scan_double(ad.data, h, outd.data, N, kind == PAR_EXCLUSIVE)
+                                  : check_scan_int64(a64, h, o64, N, kind == PAR_EXCLUSIVE);
+            double gbs = (2.0 * sizeof(double) + (h ? 1 : 0)) * N / dt / 1e9;
+            char check[32];
+            if (bad < 0) snprintf(check, sizeof(check), "ok");
+            else snprintf(check, sizeof(check), "BAD@%ld", bad);
+            failed |= bad >= 0;
+            if (t == 0) {
+                printf("%-8s %-14s %12.3f %10.2f %8s %8s\n", "serial", names[c], dt * 1e3, gbs, "-", check);
+                continue;
+            }
+            if (t == 1) base[c] = dt;
+            printf("%-8d %-14s %12.3f %10.2f %8.2f %8s\n", t, names[c], dt * 1e3, gbs, base[c] / dt, check);
+        }
+        par_array_free(&ad);
+        par_array_free(&al);
+        par_array_free(&outd);
+        par_array_free(&outl);
+        par_pool_destroy(pool);
+        if (t == max_threads) break;
+    }
+    free(heads);
+    printf(failed ? "Scan results differ from the serial reference\n"
+                  : "All scans match the serial reference\n");
+    return failed;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [-o sum|min|max|dot] [-m naive|kahan|pairwise] [-s steal|static]\n"
+           "           [-p] [-H none|thp|hugetlb] [-P] <# elements> <# threads>\n"
+           "       %s -b [-s steal|static] [-p] [-H none|thp|hugetlb] [-P] <# elements> [max threads]\n"
+           "       %s -L [-p] <# elements> [# threads]\n"
+           "       %s -S [-k inclusive|exclusive] [-p] [-H none|thp|hugetlb] <# elements> [max threads]\n",
+           prog, prog, prog, prog);
+}
+
 int main(int argc, char **argv) {
-    long i;
-    pthread_t *tid;
-    double *a;
-    double sum = 0.0;
-    int N, size;
-    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-
-    if (argc != 3) {
-        printf("Usage: %s <# elements> <# threads>\n", argv[0]);
+    long N;
+    int size;
+    int op = PAR_SUM, acc = PAR_NAIVE, bench = 0, latency = 0, pages = PAR_PAGES_DEFAULT, opt;
+    int scan = 0, kind = PAR_INCLUSIVE;
+    int sched = PAR_STEAL;
+    alloc_opts_t opts = { 0, PAR_PAGES_DEFAULT, 0, PAR_STEAL };
+
+    while ((opt = getopt(argc, argv, "o:m:bpH:Ps:LSk:")) != -1) {
+        switch (opt) {
+        case 'o': op = par_op_parse(optarg); break;
+        case 'm': acc = par_accuracy_parse(optarg); break;
+        case 'b': bench = 1; break;
+        case 'p': opts.pin = 1; break;
+        case 'H': pages = par_pages_parse(optarg); break;
+        case 'P': opts.show_placement = 1; break;
+        case 's': sched = par_schedule_parse(optarg); break;
+        case 'L': latency = 1; break;
+        case 'S': scan = 1; break;
+        case 'k': kind = par_scan_parse(optarg); break;
+        default: usage(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+    if (op < 0 || acc < 0 || pages < 0 || sched < 0 || kind < 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (argc - optind != 2 && !((bench || latency || scan) && argc - optind == 1)) {
+        usage(argv[0]);
         exit(EXIT_FAILURE);
     }
 
-    N = atoi(argv[1]);
-    size = atoi(argv[2]);
+    N = atol(argv[optind]);
+    size = (argc - optind == 2) ? atoi(argv[optind + 1]) : par_num_cpus();
 
     if (N <= 0 || size <= 0) {
         printf("Both arguments must be positive integers.\n");
         exit(EXIT_FAILURE);
     }
 
-    // allocate array and initialize
-    tid = (pthread_t *)malloc(sizeof(pthread_t) * size);
-    a = (double *)malloc(sizeof(double) * N);
-
-    for (i = 0; i < N; i++)
-        a[i] = (double)(i + 1);
+    opts.pages = (par_pages_t)pages;
+    opts.schedule = (par_schedule_t)sched;
+    if (trace_init("pthread_sum_struct")) trace_thread_name("main");
 
-    // create threads
-    for (i = 0; i < size; i++) {
-        thread_info_t *tinfo = malloc(sizeof(thread_info_t));
-        tinfo->a = a;
-        tinfo->global_sum = &sum;
-        tinfo->N = N;
-        tinfo->size = size;
-        tinfo->tid = i;
-        tinfo->mutex = &mutex;
+    if (bench)
+        return run_benchmark(&opts, N, size);
+    if (latency)
+        return run_latency(&opts, N, size);
+    if (scan)
+        return run_scan_benchmark(&opts, N, size, (par_scan_t)kind);
 
-        pthread_create(&tid[i], NULL, compute, (void *)tinfo);
-    }
+    // create the pool once; it first-touches the array and par_reduce splits
+    // the array across the same threads in the same way
+    par_array_t arr;
+    par_pool_t *pool = setup(&opts, size, N, &arr);
+    if (pool == NULL)
+        exit(EXIT_FAILURE);
+    const double *a = arr.data;
+    if (opts.show_placement)
+        print_placement(&arr);
 
-    // join threads
-    for (i = 0; i < size; i++)
-        pthread_join(tid[i], NULL);
+    TRACE_BEGIN("reduce");
+    double result = par_reduce(pool, (par_op_t)op, (par_accuracy_t)acc, a,
+                               op == PAR_DOT ? a : NULL, (size_t)N);
+    TRACE_END("reduce");
 
-    printf("The total is %g, it should be equal to %g\n",
-        sum, ((double)N * (N + 1)) / 2);
+    if (op == PAR_SUM)
+        printf("The total is %g, it should be equal to %g\n", result, expected(PAR_SUM, N));
+    else
+        printf("The result is %.17g, it should be equal to %.17g\n", result, expected((par_op_t)op, N));
 
-    free(a);
-    free(tid);
-    pthread_mutex_destroy(&mutex);
+    par_array_free(&arr);
+    par_pool_destroy(pool);
 
     return 0;
 }
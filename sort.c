@@ -0,0 +1,397 @@
+/* sort.c
+   Introsort, LSD radix sort and parallel merge sort for int arrays;
+   see sort.h.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sort.h"
+
+#define INSERTION_MAX 24        // partitions this small go to insertion sort
+#define NINTHER_MIN 128         // use Tukey's ninther pivot above this size
+#define PARTIAL_INSERTION_MOVES 8
+#define RADIX_MIN 2048          // below this introsort beats four radix passes
+#define PARALLEL_MIN (1 << 18)  // below this thread wakeups outweigh the merge
+#define NEARLY_SORTED_DIV 256   // <= n/256 descents counts as nearly sorted
+#define SIGN_FLIP 0x80000000u   // maps int order onto unsigned key order
+
+static inline void swap_int(int *a, int *b) {
+    int t = *a;
+    *a = *b;
+    *b = t;
+}
+
+void sort_insertion(int *a, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        int key = a[i];
+        size_t j = i;
+
+        // Move elements greater than key to one position ahead
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = key;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Introsort
+// ---------------------------------------------------------------------------
+
+// Insertion sort that gives up after a few element moves; 1 if a ends sorted
+static int partial_insertion(int *a, size_t n) {
+    size_t moves = 0;
+    for (size_t i = 1; i < n; i++) {
+        if (a[i - 1] <= a[i]) continue;
+        int key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = key;
+        moves += i - j;
+        if (moves > PARTIAL_INSERTION_MOVES) return 0;
+    }
+    return 1;
+}
+
+static void sift_down(int *a, size_t i, size_t n) {
+    int v = a[i];
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && a[c + 1] > a[c]) c++;
+        if (a[c] <= v) break;
+        a[i] = a[c];
+        i = c;
+    }
+    a[i] = v;
+}
+
+static void heap_sort(int *a, size_t n) {
+    for (size_t i = n / 2; i-- > 0; ) sift_down(a, i, n);
+    for (size_t end = n - 1; end > 0; end--) {
+        swap_int(&a[0], &a[end]);
+        sift_down(a, 0, end);
+    }
+}
+
+static size_t median3(const int *a, size_t i, size_t j, size_t k) {
+    if (a[i] < a[j]) {
+        if (a[j] < a[k]) return j;
+        return a[i] < a[k] ? k : i;
+    }
+    if (a[i] < a[k]) return i;
+    return a[j] < a[k] ? k : j;
+}
+
+// Partition around a[0]: [0, pos) < pivot, (pos, n) >= pivot, pivot at pos.
+// *swapped is 0 if the input was already partitioned.
+static size_t partition_right(int *a, size_t n, int *swapped) {
+    int pivot = a[0];
+    size_t i = 1, j = n - 1;
+    *swapped = 0;
+    for (;;) {
+        while (i <= j && a[i] < pivot) i++;
+        while (i <= j && a[j] >= pivot) j--;
+        if (i > j) break;
+        swap_int(&a[i], &a[j]);
+        *swapped = 1;
+        i++;
+        j--;
+    }
+    swap_int(&a[0], &a[i - 1]);
+    return i - 1;
+}
+
+// Partition around a[0] with keys equal to the pivot going left
+static size_t partition_left(int *a, size_t n) {
+    int pivot = a[0];
+    size_t i = 1, j = n - 1;
+    for (;;) {
+        while (i <= j && a[i] <= pivot) i++;
+        while (i <= j && a[j] > pivot) j--;
+        if (i > j) break;
+        swap_int(&a[i], &a[j]);
+        i++;
+        j--;
+    }
+    swap_int(&a[0], &a[i - 1]);
+    return i - 1;
+}
+
+// leftmost is 0 when a[-1] holds an earlier pivot, which is <= all of a
+static void intro_loop(int *a, size_t n, int bad_allowed, int leftmost) {
+    while (n > INSERTION_MAX) {
+        size_t mid = n / 2, p;
+        if (n > NINTHER_MIN) {
+            size_t s = n / 8;
+            p = median3(a, median3(a, 0, s, 2 * s), median3(a, mid - s, mid, mid + s),
+                        median3(a, n - 1 - 2 * s, n - 1 - s, n - 1));
+        } else {
+            p = median3(a, 0, mid, n - 1);
+        }
+        swap_int(&a[0], &a[p]);
+
+        // the pivot equals the earlier one, so everything <= it is equal to it
+        if (!leftmost && a[-1] == a[0]) {
+            size_t pos = partition_left(a, n);
+            a += pos + 1;
+            n -= pos + 1;
+            continue;
+        }
+
+        int swapped;
+        size_t pos = partition_right(a, n, &swapped);
+        size_t ln = pos, rn = n - pos - 1;
+        if (ln < n / 8 || rn < n / 8) {
+            // unbalanced: fall back to heapsort eventually, and shuffle a
+            // few elements so patterned input doesn't repeat the bad split
+            if (--bad_allowed == 0) {
+                heap_sort(a, n);
+                return;
+            }
+            if (ln >= INSERTION_MAX) {
+                swap_int(&a[0], &a[ln / 4]);
+                swap_int(&a[ln - 1], &a[ln - ln / 4]);
+            }
+            if (rn >= INSERTION_MAX) {
+                swap_int(&a[pos + 1], &a[pos + 1 + rn / 4]);
+                swap_int(&a[n - 1], &a[n - rn / 4]);
+            }
+        } else if (!swapped && partial_insertion(a, ln) && partial_insertion(a + pos + 1, rn)) {
+            return;
+        }
+
+        // recurse into the smaller side, loop on the larger one
+        if (ln < rn) {
+            intro_loop(a, ln, bad_allowed, leftmost);
+            a += pos + 1;
+            n = rn;
+            leftmost = 0;
+        } else {
+            intro_loop(a + pos + 1, rn, bad_allowed, 0);
+            n = ln;
+        }
+    }
+    sort_insertion(a, n);
+}
+
+void sort_intro(int *a, size_t n) {
+    if (n < 2) return;
+    int log2n = 0;
+    while ((n >> log2n) > 1) log2n++;
+    intro_loop(a, n, log2n, 1);
+}
+
+// ---------------------------------------------------------------------------
+// LSD radix sort
+// ---------------------------------------------------------------------------
+
+// Sort a using tmp (same length) as the other half of each pass
+static void radix_sort_buf(int *a, int *tmp, size_t n) {
+    size_t count[4][256];
+    memset(count, 0, sizeof(count));
+    for (size_t i = 0; i < n; i++) {
+        uint32_t k = (uint32_t)a[i] ^ SIGN_FLIP;
+        count[0][k & 255]++;
+        count[1][k >> 8 & 255]++;
+        count[2][k >> 16 & 255]++;
+        count[3][k >> 24]++;
+    }
+
+    int *src = a, *dst = tmp;
+    for (int pass = 0; pass < 4; pass++) {
+        size_t *c = count[pass];
+        int shift = pass * 8;
+        if (c[((uint32_t)src[0] ^ SIGN_FLIP) >> shift & 255] == n) continue;
+        size_t sum = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t t = c[b];
+            c[b] = sum;
+            sum += t;
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint32_t k = (uint32_t)src[i] ^ SIGN_FLIP;
+            dst[c[k >> shift & 255]++] = src[i];
+        }
+        int *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != a) memcpy(a, src, n * sizeof(int));
+}
+
+void sort_radix(int *a, size_t n) {
+    if (n < 2) return;
+    int *tmp = malloc(n * sizeof(int));
+    if (!tmp) {
+        sort_intro(a, n);
+        return;
+    }
+    radix_sort_buf(a, tmp, n);
+    free(tmp);
+}
+
+// ---------------------------------------------------------------------------
+// Parallel merge sort
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int *a, *tmp;
+    size_t n;
+    size_t *bounds;     // run i is [bounds[i], bounds[i + 1])
+    int nruns;
+    const int *src;     // current merge round: src runs -> dst
+    int *dst;
+} psort_job_t;
+
+// Number of elements taken from A among the first k outputs of the stable
+// merge of A (m elements) and B (n elements)
+static size_t co_rank(size_t k, const int *A, size_t m, const int *B, size_t n) {
+    size_t lo = k > n ? k - n : 0, hi = k < m ? k : m;
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2, j = k - i;
+        if (i < m && j > 0 && A[i] <= B[j - 1]) lo = i + 1;
+        else hi = i;
+    }
+    return lo;
+}
+
+static void merge_into(const int *A, size_t m, const int *B, size_t n, int *out) {
+    size_t i = 0, j = 0;
+    while (i < m && j < n) *out++ = B[j] < A[i] ? B[j++] : A[i++];
+    memcpy(out, A + i, (m - i) * sizeof(int));
+    memcpy(out + (m - i), B + j, (n - j) * sizeof(int));
+}
+
+static void psort_runs_task(void *arg, int tid, int nthreads) {
+    psort_job_t *job = (psort_job_t *)arg;
+    size_t s, e;
+    par_partition(job->n, tid, nthreads, &s, &e);
+    if (e - s > 1) radix_sort_buf(job->a + s, job->tmp + s, e - s);
+}
+
+// Every thread writes the same share of the output, whichever pairs of
+// runs it falls in; co_rank() finds where that share starts in each run.
+static void psort_merge_task(void *arg, int tid, int nthreads) {
+    psort_job_t *job = (psort_job_t *)arg;
+    size_t s = job->n * (size_t)tid / (size_t)nthreads;
+    size_t e = job->n * (size_t)(tid + 1) / (size_t)nthreads;
+
+    for (int r = 0; r < job->nruns; r += 2) {
+        size_t L = job->bounds[r];
+        size_t M = job->bounds[r + 1];
+        size_t H = r + 2 <= job->nruns ? job->bounds[r + 2] : M;
+        if (H <= s) continue;
+        if (L >= e) break;
+        size_t lo = s > L ? s : L, hi = e < H ? e : H;
+        const int *A = job->src + L, *B = job->src + M;
+        size_t m = M - L, n = H - M;
+        size_t i0 = co_rank(lo - L, A, m, B, n), i1 = co_rank(hi - L, A, m, B, n);
+        size_t j0 = lo - L - i0, j1 = hi - L - i1;
+        merge_into(A + i0, i1 - i0, B + j0, j1 - j0, job->dst + lo);
+    }
+}
+
+void sort_parallel(int *a, size_t n, par_pool_t *pool) {
+    int nthreads = pool ? par_pool_size(pool) : 1;
+    if (nthreads < 2 || n < (size_t)nthreads * 2) {
+        sort_radix(a, n);
+        return;
+    }
+    psort_job_t job;
+    job.a = a;
+    job.n = n;
+    job.tmp = malloc(n * sizeof(int));
+    job.bounds = malloc(sizeof(size_t) * (size_t)(nthreads + 1));
+    if (!job.tmp || !job.bounds) {
+        free(job.tmp);
+        free(job.bounds);
+        sort_radix(a, n);
+        return;
+    }
+
+    // sorted runs, one per thread, left in a
+    par_pool_run(pool, psort_runs_task, &job);
+    job.nruns = nthreads;
+    for (int i = 0; i < nthreads; i++) {
+        size_t e;
+        par_partition(n, i, nthreads, &job.bounds[i], &e);
+    }
+    job.bounds[nthreads] = n;
+
+    // merge pairs of runs until one is left, ping-ponging between buffers
+    job.src = a;
+    job.dst = job.tmp;
+    while (job.nruns > 1) {
+        par_pool_run(pool, psort_merge_task, &job);
+        int k = 0;
+        for (int r = 0; r < job.nruns; r += 2) job.bounds[k++] = job.bounds[r];
+        job.bounds[k] = n;
+        job.nruns = k;
+        int *t = (int *)job.src;
+        job.src = job.dst;
+        job.dst = t;
+    }
+    if (job.src != a) memcpy(a, job.src, n * sizeof(int));
+    free(job.tmp);
+    free(job.bounds);
+}
+
+// ---------------------------------------------------------------------------
+// Selection
+// ---------------------------------------------------------------------------
+
+sort_algo_t sort_choose(const int *a, size_t n, const par_pool_t *pool, int *reversed) {
+    size_t desc = 0, asc = 0;
+    *reversed = 0;
+    if (n <= INSERTION_MAX) return SORT_INSERTION;
+    for (size_t i = 1; i < n; i++) {
+        desc += a[i] < a[i - 1];
+        asc += a[i] > a[i - 1];
+    }
+    if (desc == 0) return SORT_INSERTION;  // already sorted: one pass, no moves
+    if (asc == 0) {
+        *reversed = 1;
+        return SORT_INSERTION;
+    }
+    if (n < RADIX_MIN || desc <= n / NEARLY_SORTED_DIV) return SORT_INTRO;
+    if (pool && par_pool_size(pool) > 1 && n >= PARALLEL_MIN) return SORT_PARALLEL;
+    return SORT_RADIX;
+}
+
+sort_algo_t sort_ints(int *a, size_t n, sort_algo_t algo, par_pool_t *pool) {
+    if (algo == SORT_AUTO) {
+        int reversed;
+        algo = sort_choose(a, n, pool, &reversed);
+        if (reversed) {
+            for (size_t i = 0, j = n - 1; i < j; i++, j--) swap_int(&a[i], &a[j]);
+            return algo;
+        }
+    }
+    switch (algo) {
+    case SORT_INSERTION: sort_insertion(a, n); break;
+    case SORT_INTRO: sort_intro(a, n); break;
+    case SORT_RADIX: sort_radix(a, n); break;
+    case SORT_PARALLEL: sort_parallel(a, n, pool); break;
+    case SORT_AUTO: break;
+    }
+    return algo;
+}
+
+static const char *algo_names[] = { "auto", "insertion", "intro", "radix", "parallel" };
+
+const char *sort_algo_name(sort_algo_t algo) {
+    return algo_names[algo];
+}
+
+int sort_algo_parse(const char *s) {
+    for (int i = 0; i < (int)(sizeof(algo_names) / sizeof(algo_names[0])); i++)
+        if (strcmp(s, algo_names[i]) == 0) return i;
+    return -1;
+}
@@ -0,0 +1,61 @@
+/* sort.h
+   Sorting engine for int arrays: pattern-defeating introsort, LSD radix
+   sort, a parallel merge sort on the parallel.h pool, and automatic
+   selection between them.
+   Used by insertion.c; compile sort.c and parallel.c alongside it:
+       gcc -O2 -Wall insertion.c sort.c parallel.c trace.c -lpthread -lm -o insertion
+*/
+
+#ifndef SORT_H
+#define SORT_H
+
+#include <stddef.h>
+
+#include "parallel.h"
+
+typedef enum {
+    SORT_AUTO,       /* pick one of the below from size and presortedness */
+    SORT_INSERTION,  /* O(n^2) insertion sort, only sensible for tiny or sorted input */
+    SORT_INTRO,      /* in-place introsort with pdqsort's pattern handling */
+    SORT_RADIX,      /* LSD radix sort on 32-bit keys, n ints of scratch */
+    SORT_PARALLEL    /* per-thread radix sort, then merge-path parallel merges */
+} sort_algo_t;
+
+void sort_insertion(int *a, size_t n);
+
+/* Quicksort with ninther pivots, insertion sort below 24 elements and a
+   heapsort fallback, so O(n log n) worst case. Runs of keys equal to an
+   earlier pivot are split off in one pass, and partitions that needed no
+   swaps get a bounded insertion sort first, so sorted, reversed and
+   few-unique inputs run in near linear time. */
+void sort_intro(int *a, size_t n);
+
+/* Four 8-bit passes over the key with the sign bit flipped; passes where
+   every key has the same digit are skipped. Falls back to sort_intro()
+   if the scratch buffer can't be allocated. */
+void sort_radix(int *a, size_t n);
+
+/* Each pool thread radix sorts one par_partition() slice; the sorted runs
+   are then merged pairwise, every round split across all threads by
+   output position (merge path), so each thread writes an equal share.
+   Falls back to sort_radix() with a NULL or single-thread pool or when
+   the scratch buffer can't be allocated. */
+void sort_parallel(int *a, size_t n, par_pool_t *pool);
+
+/* What SORT_AUTO would run for a: insertion for tiny or already sorted
+   input, introsort for small or nearly sorted input, radix above that and
+   the parallel sort for large inputs when pool has more than one thread.
+   One O(n) scan counts descents; *reversed is set when a is strictly
+   decreasing, which sort_ints() turns into a reversal. */
+sort_algo_t sort_choose(const int *a, size_t n, const par_pool_t *pool, int *reversed);
+
+/* Sort a with algo (SORT_AUTO resolved by sort_choose()); pool may be
+   NULL. Returns the algorithm actually run. */
+sort_algo_t sort_ints(int *a, size_t n, sort_algo_t algo, par_pool_t *pool);
+
+const char *sort_algo_name(sort_algo_t algo);
+
+/* Parse "auto"/"insertion"/"intro"/"radix"/"parallel"; -1 if unknown */
+int sort_algo_parse(const char *s);
+
+#endif
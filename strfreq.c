@@ -0,0 +1,340 @@
+/* strfreq.c
+   Exact and approximate string frequency counting; see strfreq.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "strfreq.h"
+
+#define TABLE_MIN 1024
+#define SKETCH_DEPTH 4
+#define SKETCH_MIN_WIDTH 1024
+#define HLL_BITS 14
+#define HLL_REGS (1 << HLL_BITS)
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// murmur3 finalizer
+static inline uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t str_hash(const char *s, size_t len) {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ (len * 0xff51afd7ed558ccdull);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        h = rotl64(h ^ (w * 0x87c37b91114253d5ull), 31) * 0x4cf5ad432745937full;
+    }
+    if (i < len) {
+        uint64_t w = 0;
+        memcpy(&w, s + i, len - i);
+        h = rotl64(h ^ (w * 0x87c37b91114253d5ull), 31) * 0x4cf5ad432745937full;
+    }
+    return mix64(h);
+}
+
+// ---------------------------------------------------------------------------
+// Exact table
+// ---------------------------------------------------------------------------
+
+int str_table_init(str_table_t *t, const str_arena_t *arena, size_t expected) {
+    size_t cap = TABLE_MIN;
+    while (cap < expected * 2) cap *= 2;
+    memset(t, 0, sizeof(*t));
+    t->slots = calloc(cap, sizeof(str_count_t));
+    if (!t->slots) return -1;
+    t->arena = arena;
+    t->cap = cap;
+    return 0;
+}
+
+void str_table_free(str_table_t *t) {
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+static int str_table_grow(str_table_t *t) {
+    size_t cap = t->cap * 2, mask = cap - 1;
+    str_count_t *slots = calloc(cap, sizeof(str_count_t));
+    if (!slots) return -1;
+    // the stored hashes place every entry without touching the strings
+    for (size_t i = 0; i < t->cap; i++) {
+        if (!t->slots[i].count) continue;
+        size_t j = t->slots[i].hash & mask;
+        while (slots[j].count) j = (j + 1) & mask;
+        slots[j] = t->slots[i];
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->cap = cap;
+    return 0;
+}
+
+static inline int same_string(const str_arena_t *a, str_ref_t x, str_ref_t y) {
+    return x.len == y.len && memcmp(str_ptr(a, x), str_ptr(a, y), x.len) == 0;
+}
+
+int str_table_add(str_table_t *t, str_ref_t ref, uint64_t hash) {
+    if ((t->distinct + 1) * 2 > t->cap && str_table_grow(t) != 0) return -1;
+    size_t mask = t->cap - 1, i = hash & mask;
+    t->total++;
+    for (;;) {
+        str_count_t *s = &t->slots[i];
+        if (!s->count) {
+            s->hash = hash;
+            s->count = 1;
+            s->ref = ref;
+            t->distinct++;
+            return 0;
+        }
+        if (s->hash == hash && same_string(t->arena, s->ref, ref)) {
+            s->count++;
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+uint64_t str_table_get(const str_table_t *t, str_ref_t ref, uint64_t hash) {
+    size_t mask = t->cap - 1, i = hash & mask;
+    for (;; i = (i + 1) & mask) {
+        const str_count_t *s = &t->slots[i];
+        if (!s->count) return 0;
+        if (s->hash == hash && same_string(t->arena, s->ref, ref)) return s->count;
+    }
+}
+
+static int cmp_refs(const str_arena_t *a, str_ref_t x, str_ref_t y) {
+    int c = memcmp(str_ptr(a, x), str_ptr(a, y), x.len < y.len ? x.len : y.len);
+    if (c) return c;
+    return (x.len > y.len) - (x.len < y.len);
+}
+
+// x ranks below y: lower count, or the same count and later in strcmp order
+static int ranks_below(const str_arena_t *a, const str_count_t *x, const str_count_t *y) {
+    if (x->count != y->count) return x->count < y->count;
+    return cmp_refs(a, x->ref, y->ref) > 0;
+}
+
+static void heap_down(const str_arena_t *a, str_count_t *h, size_t n, size_t i) {
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= n) return;
+        if (c + 1 < n && ranks_below(a, &h[c + 1], &h[c])) c++;
+        if (!ranks_below(a, &h[c], &h[i])) return;
+        str_count_t tmp = h[i];
+        h[i] = h[c];
+        h[c] = tmp;
+        i = c;
+    }
+}
+
+size_t str_table_top(const str_table_t *t, size_t k, str_count_t *out) {
+    size_t n = 0;
+    if (k == 0) return 0;
+    // out is a min-heap of the best k seen so far; its root is the weakest
+    for (size_t i = 0; i < t->cap; i++) {
+        const str_count_t *s = &t->slots[i];
+        if (!s->count) continue;
+        if (n < k) {
+            out[n] = *s;
+            for (size_t j = n++; j > 0 && ranks_below(t->arena, &out[j], &out[(j - 1) / 2]); j = (j - 1) / 2) {
+                str_count_t tmp = out[j];
+                out[j] = out[(j - 1) / 2];
+                out[(j - 1) / 2] = tmp;
+            }
+        } else if (ranks_below(t->arena, &out[0], s)) {
+            out[0] = *s;
+            heap_down(t->arena, out, n, 0);
+        }
+    }
+    // popping the root to the back leaves the best first
+    for (size_t m = n; m > 1; m--) {
+        str_count_t tmp = out[0];
+        out[0] = out[m - 1];
+        out[m - 1] = tmp;
+        heap_down(t->arena, out, m - 1, 0);
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Sketch
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t hash;
+    uint64_t count;
+    char *s;
+    uint32_t len;
+    uint32_t cap;
+} hitter_t;
+
+struct str_sketch {
+    uint32_t *cm;           // SKETCH_DEPTH rows of width counters
+    size_t width;
+    uint64_t total;
+    uint8_t hll[HLL_REGS];
+    hitter_t *heap;         // min-heap by count of the tracked candidates
+    size_t n, k;
+};
+
+str_sketch_t *str_sketch_create(size_t memory, size_t k) {
+    str_sketch_t *sk = calloc(1, sizeof(*sk));
+    if (!sk) return NULL;
+    size_t width = SKETCH_MIN_WIDTH;
+    while (width * 2 * SKETCH_DEPTH * sizeof(uint32_t) <= memory) width *= 2;
+    sk->width = width;
+    sk->k = k ? k : 1;
+    sk->cm = calloc(width * SKETCH_DEPTH, sizeof(uint32_t));
+    sk->heap = calloc(sk->k, sizeof(hitter_t));
+    if (!sk->cm || !sk->heap) {
+        str_sketch_free(sk);
+        return NULL;
+    }
+    return sk;
+}
+
+void str_sketch_free(str_sketch_t *sk) {
+    if (!sk) return;
+    if (sk->heap)
+        for (size_t i = 0; i < sk->n; i++) free(sk->heap[i].s);
+    free(sk->heap);
+    free(sk->cm);
+    free(sk);
+}
+
+static void hitter_down(hitter_t *h, size_t n, size_t i) {
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= n) return;
+        if (c + 1 < n && h[c + 1].count < h[c].count) c++;
+        if (h[c].count >= h[i].count) return;
+        hitter_t tmp = h[i];
+        h[i] = h[c];
+        h[c] = tmp;
+        i = c;
+    }
+}
+
+static int hitter_set(hitter_t *h, const char *s, size_t len, uint64_t hash, uint64_t count) {
+    if (len > h->cap) {
+        char *bigger = realloc(h->s, len);
+        if (!bigger) return -1;
+        h->s = bigger;
+        h->cap = (uint32_t)len;
+    }
+    memcpy(h->s, s, len);
+    h->len = (uint32_t)len;
+    h->hash = hash;
+    h->count = count;
+    return 0;
+}
+
+int str_sketch_add(str_sketch_t *sk, const char *s, size_t len) {
+    uint64_t h = str_hash(s, len);
+    sk->total++;
+
+    // HyperLogLog: top bits pick the register, the rest give the rank
+    uint8_t rank = (uint8_t)(__builtin_clzll((h << HLL_BITS) | (1ull << (HLL_BITS - 1))) + 1);
+    uint8_t *reg = &sk->hll[h >> (64 - HLL_BITS)];
+    if (rank > *reg) *reg = rank;
+
+    // Count-Min with conservative update: only raise the counters that
+    // hold the minimum, which keeps overestimates far smaller
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    size_t idx[SKETCH_DEPTH];
+    uint32_t min = UINT32_MAX;
+    for (int d = 0; d < SKETCH_DEPTH; d++) {
+        idx[d] = d * sk->width + ((h1 + (uint32_t)d * h2) & (sk->width - 1));
+        if (sk->cm[idx[d]] < min) min = sk->cm[idx[d]];
+    }
+    uint32_t est = min == UINT32_MAX ? min : min + 1;
+    for (int d = 0; d < SKETCH_DEPTH; d++)
+        if (sk->cm[idx[d]] < est) sk->cm[idx[d]] = est;
+
+    // a tracked string always beats the heap minimum again (its counters
+    // only grow), so only strings above the minimum need a lookup
+    if (sk->n == sk->k && est <= sk->heap[0].count) return 0;
+    for (size_t i = 0; i < sk->n; i++) {
+        hitter_t *t = &sk->heap[i];
+        if (t->hash == h && t->len == len && memcmp(t->s, s, len) == 0) {
+            t->count = est;
+            hitter_down(sk->heap, sk->n, i);
+            return 0;
+        }
+    }
+    if (sk->n < sk->k) {
+        size_t j = sk->n++;
+        memset(&sk->heap[j], 0, sizeof(hitter_t));
+        if (hitter_set(&sk->heap[j], s, len, h, est) != 0) {
+            sk->n--;
+            return -1;
+        }
+        for (; j > 0 && sk->heap[j].count < sk->heap[(j - 1) / 2].count; j = (j - 1) / 2) {
+            hitter_t tmp = sk->heap[j];
+            sk->heap[j] = sk->heap[(j - 1) / 2];
+            sk->heap[(j - 1) / 2] = tmp;
+        }
+        return 0;
+    }
+    // evict the weakest candidate, reusing its buffer
+    if (hitter_set(&sk->heap[0], s, len, h, est) != 0) return -1;
+    hitter_down(sk->heap, sk->n, 0);
+    return 0;
+}
+
+uint64_t str_sketch_total(const str_sketch_t *sk) {
+    return sk->total;
+}
+
+double str_sketch_distinct(const str_sketch_t *sk) {
+    double m = HLL_REGS, sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGS; i++) {
+        sum += ldexp(1.0, -sk->hll[i]);
+        zeros += sk->hll[i] == 0;
+    }
+    double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (e <= 2.5 * m && zeros) e = m * log(m / zeros);  // linear counting for small sets
+    return e;
+}
+
+uint64_t str_sketch_error(const str_sketch_t *sk) {
+    return (uint64_t)ceil((double)sk->total * M_E / (double)sk->width);
+}
+
+static int cmp_hitters(const void *x, const void *y) {
+    const str_hitter_t *a = x, *b = y;
+    if (a->count != b->count) return a->count < b->count ? 1 : -1;
+    int c = memcmp(a->s, b->s, a->len < b->len ? a->len : b->len);
+    if (c) return c;
+    return (a->len > b->len) - (a->len < b->len);
+}
+
+size_t str_sketch_top(const str_sketch_t *sk, str_hitter_t *out, size_t k) {
+    str_hitter_t *all = malloc((sk->n + 1) * sizeof(str_hitter_t));
+    if (!all) return 0;
+    for (size_t i = 0; i < sk->n; i++) {
+        all[i].s = sk->heap[i].s;
+        all[i].len = sk->heap[i].len;
+        all[i].count = sk->heap[i].count;
+    }
+    qsort(all, sk->n, sizeof(str_hitter_t), cmp_hitters);
+    size_t n = k < sk->n ? k : sk->n;
+    memcpy(out, all, n * sizeof(str_hitter_t));
+    free(all);
+    return n;
+}
@@ -0,0 +1,80 @@
+/* strfreq.h
+   String frequency counting: an exact open-addressing table over arena
+   strings, and a bounded-memory sketch (Count-Min, HyperLogLog and a
+   heavy-hitter heap) for streams too large to keep.
+   Used by hwins.c together with strsort.h.
+*/
+
+#ifndef STRFREQ_H
+#define STRFREQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "strsort.h"
+
+/* 64-bit hash of s[0, len), eight bytes per step */
+uint64_t str_hash(const char *s, size_t len);
+
+/* ---- exact counts ---- */
+
+typedef struct {
+    uint64_t hash;      /* str_hash() of the string, kept to skip compares and rehash */
+    uint64_t count;     /* 0 marks an empty slot */
+    str_ref_t ref;      /* first occurrence in the arena */
+} str_count_t;
+
+typedef struct {
+    const str_arena_t *arena;
+    str_count_t *slots; /* linear probing, capacity a power of two, <= 1/2 full */
+    size_t cap;
+    size_t distinct;
+    uint64_t total;
+} str_table_t;
+
+int str_table_init(str_table_t *t, const str_arena_t *arena, size_t expected);
+void str_table_free(str_table_t *t);
+
+/* Count one occurrence of ref; hash must be str_hash() of its bytes.
+   Returns 0, or -1 if the table could not grow. */
+int str_table_add(str_table_t *t, str_ref_t ref, uint64_t hash);
+
+/* Count of ref's string, 0 if it was never added */
+uint64_t str_table_get(const str_table_t *t, str_ref_t ref, uint64_t hash);
+
+/* The k most frequent entries, most frequent first (ties in strcmp
+   order), selected with a k-entry min-heap. Returns how many were written
+   to out (min(k, distinct)). */
+size_t str_table_top(const str_table_t *t, size_t k, str_count_t *out);
+
+/* ---- approximate counts in bounded memory ---- */
+
+typedef struct str_sketch str_sketch_t;
+
+typedef struct {
+    const char *s;      /* owned by the sketch */
+    uint32_t len;
+    uint64_t count;     /* Count-Min estimate: never below the true count */
+} str_hitter_t;
+
+/* A sketch using about memory bytes for its Count-Min counters that tracks
+   k heavy-hitter candidates. NULL if memory runs out. */
+str_sketch_t *str_sketch_create(size_t memory, size_t k);
+void str_sketch_free(str_sketch_t *sk);
+
+/* Count one occurrence of s[0, len). Returns 0 or -1 on ENOMEM. */
+int str_sketch_add(str_sketch_t *sk, const char *s, size_t len);
+
+uint64_t str_sketch_total(const str_sketch_t *sk);
+
+/* HyperLogLog estimate of the number of distinct strings (~1% error) */
+double str_sketch_distinct(const str_sketch_t *sk);
+
+/* Additive error bound of every estimate: total * e / width, exceeded with
+   probability at most e^-depth */
+uint64_t str_sketch_error(const str_sketch_t *sk);
+
+/* The tracked candidates, highest estimate first. Returns how many. */
+size_t str_sketch_top(const str_sketch_t *sk, str_hitter_t *out, size_t k);
+
+#endif
@@ -0,0 +1,91 @@
+/* strsearch.c
+   Literal and multi-literal search; see strsearch.h.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "strsearch.h"
+
+// Same scheme as kernels.c: 32-byte GCC vectors, one target_clones copy per
+// instruction set.
+#pragma GCC diagnostic ignored "-Wpsabi"   // vector helpers are static inline, no ABI exposure
+typedef uint8_t v32u8 __attribute__((vector_size(32)));
+typedef uint64_t v4u64 __attribute__((vector_size(32)));
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define SEARCH_KERNEL __attribute__((target_clones("arch=skylake-avx512", "avx2", "sse4.2", "default")))
+#else
+#define SEARCH_KERNEL
+#endif
+
+#define BYTES 32
+
+static inline v32u8 load_bytes(const char *p) {
+    v32u8 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+int str_search_init(str_search_t *s, const char *const *lits, int n) {
+    if (n < 1 || n > STR_SEARCH_MAX) return -1;
+    s->n = n;
+    s->maxlen = 0;
+    for (int k = 0; k < n; k++) {
+        s->lit[k] = lits[k];
+        s->len[k] = strlen(lits[k]);
+        if (s->len[k] == 0) return -1;
+        if (s->len[k] > s->maxlen) s->maxlen = s->len[k];
+    }
+    return 0;
+}
+
+// First literal matching in full at p, or -1
+static inline int match_at(const str_search_t *s, const char *buf, size_t n, size_t p) {
+    for (int k = 0; k < s->n; k++)
+        if (p + s->len[k] <= n && buf[p] == s->lit[k][0] && memcmp(buf + p, s->lit[k], s->len[k]) == 0)
+            return k;
+    return -1;
+}
+
+// A lane is a candidate when, for some literal, it holds the literal's first
+// byte and the byte len-1 further on is its last byte. In ordinary text the
+// two tests together leave few lanes, so memcmp runs on few positions.
+SEARCH_KERNEL
+static size_t search_kernel(const str_search_t *s, const char *buf, size_t n, size_t from, int *which) {
+    size_t i = from;
+    if (n - from >= s->maxlen - 1 + BYTES) {
+        size_t stop = n - (s->maxlen - 1) - BYTES;
+        for (; i <= stop; i += BYTES) {
+            v32u8 head = load_bytes(buf + i);
+            v32u8 hit = { 0 };
+            for (int k = 0; k < s->n; k++) {
+                v32u8 tail = load_bytes(buf + i + s->len[k] - 1);
+                hit |= (v32u8)((head == (uint8_t)s->lit[k][0]) & (tail == (uint8_t)s->lit[k][s->len[k] - 1]));
+            }
+            v4u64 w = (v4u64)hit;
+            if (!(w[0] | w[1] | w[2] | w[3])) continue;
+            for (int l = 0; l < BYTES; l++) {
+                if (!hit[l]) continue;
+                int k = match_at(s, buf, n, i + l);
+                if (k >= 0) {
+                    if (which) *which = k;
+                    return i + l;
+                }
+            }
+        }
+    }
+    for (; i < n; i++) {
+        int k = match_at(s, buf, n, i);
+        if (k >= 0) {
+            if (which) *which = k;
+            return i;
+        }
+    }
+    return STR_SEARCH_NONE;
+}
+
+size_t str_search_next(const str_search_t *s, const char *buf, size_t n, size_t from, int *which) {
+    if (from >= n) return STR_SEARCH_NONE;
+    return search_kernel(s, buf, n, from, which);
+}
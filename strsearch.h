@@ -0,0 +1,34 @@
+/* strsearch.h
+   Literal search for one or a few fixed strings at once. Candidate starts
+   are found 32 bytes at a time by comparing the first and last byte of
+   every literal against the buffer, and only those positions are checked
+   in full. Built for AVX-512, AVX2, SSE4.2 and baseline x86-64 like
+   kernels.c, with the best copy picked at load time.
+   Used by oaadigun_HW02.c; compile strsearch.c alongside it.
+*/
+
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <stddef.h>
+
+#define STR_SEARCH_MAX 16
+#define STR_SEARCH_NONE ((size_t)-1)
+
+typedef struct {
+    int n;
+    const char *lit[STR_SEARCH_MAX];    /* not copied: must outlive the search */
+    size_t len[STR_SEARCH_MAX];
+    size_t maxlen;
+} str_search_t;
+
+/* Search for lits[0, n); 1 <= n <= STR_SEARCH_MAX and no literal may be
+   empty. Returns 0, or -1 if the set is not valid. */
+int str_search_init(str_search_t *s, const char *const *lits, int n);
+
+/* Offset of the leftmost match starting in buf[from, n), or
+   STR_SEARCH_NONE. When several literals match there, *which (if not NULL)
+   is the first of them in lits order. */
+size_t str_search_next(const str_search_t *s, const char *buf, size_t n, size_t from, int *which);
+
+#endif
@@ -0,0 +1,255 @@
+/* strsort.c
+   String arena and multikey quicksort on 8-byte prefixes; see strsort.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "strsort.h"
+#include "intio.h"
+
+#define ARENA_PAD 8               // readable bytes kept after the last string
+#define MKQS_INSERTION 16         // insertion sort below this many strings
+#define PARALLEL_MIN (1 << 16)    // fewer strings are sorted on one thread
+#define NBUCKETS 65536            // top-level buckets: first two bytes
+
+// Sort item: the reference plus its 8 bytes at the current depth
+typedef struct {
+    uint64_t key;
+    uint64_t off;
+    uint32_t len;
+} sitem_t;
+
+int str_arena_init(str_arena_t *a, size_t cap) {
+    memset(a, 0, sizeof(*a));
+    a->data = calloc(cap + ARENA_PAD, 1);
+    if (!a->data) return -1;
+    a->cap = cap;
+    return 0;
+}
+
+void str_arena_free(str_arena_t *a) {
+    if (a->map) munmap(a->map, a->map_len);
+    else free(a->data);
+    memset(a, 0, sizeof(*a));
+}
+
+str_ref_t str_arena_add(str_arena_t *a, const char *s, size_t len) {
+    str_ref_t r = { 0, UINT32_MAX };
+    if (a->map || len >= UINT32_MAX) return r;
+    if (a->len + len > a->cap) {
+        size_t cap = a->cap ? a->cap : 4096;
+        while (cap < a->len + len) cap *= 2;
+        char *data = realloc(a->data, cap + ARENA_PAD);
+        if (!data) return r;
+        a->data = data;
+        a->cap = cap;
+    }
+    memcpy(a->data + a->len, s, len);
+    memset(a->data + a->len + len, 0, ARENA_PAD);
+    r.off = a->len;
+    r.len = (uint32_t)len;
+    a->len += len;
+    return r;
+}
+
+int str_arena_load(str_arena_t *a, const char *path) {
+    intio_buf_t buf;
+    memset(a, 0, sizeof(*a));
+    if (intio_load(path, 0, &buf) != 0) return -1;
+    if (buf.padded) {
+        // already followed by readable zeros: use it as is
+        a->data = buf.data;
+        a->len = a->cap = buf.len;
+        a->map = buf.map;
+        a->map_len = buf.map_len;
+        return 0;
+    }
+    // a mapping that ends on a page boundary: copy once to get the padding
+    if (str_arena_init(a, buf.len) != 0) {
+        intio_release(&buf);
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(a->data, buf.data, buf.len);
+    a->len = buf.len;
+    intio_release(&buf);
+    return 0;
+}
+
+size_t str_arena_split(const str_arena_t *a, size_t *pos, str_ref_t *refs, size_t max) {
+    const unsigned char *d = (const unsigned char *)a->data;
+    size_t p = *pos, n = 0;
+    while (n < max) {
+        while (p < a->len && d[p] <= ' ') p++;
+        if (p >= a->len) break;
+        size_t start = p;
+        while (p < a->len && d[p] > ' ') p++;
+        refs[n].off = start;
+        refs[n].len = (uint32_t)(p - start);
+        n++;
+    }
+    *pos = p;
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Multikey quicksort
+// ---------------------------------------------------------------------------
+
+// Bytes [depth, depth + 8) of the string as a big-endian word, zero past its
+// end, so comparing words compares the strings byte by byte.
+static inline uint64_t load_key(const char *base, uint64_t off, uint32_t len, size_t depth) {
+    if (depth >= len) return 0;
+    uint64_t w;
+    memcpy(&w, base + off + depth, 8);
+    w = __builtin_bswap64(w);
+    size_t rem = len - depth;
+    if (rem < 8) w &= ~0ull << (8 * (8 - rem));
+    return w;
+}
+
+static inline void swap_items(sitem_t *x, sitem_t *y) {
+    sitem_t t = *x;
+    *x = *y;
+    *y = t;
+}
+
+// Compare two items whose keys at depth are valid
+static int cmp_items(const char *base, const sitem_t *x, const sitem_t *y, size_t depth) {
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    if ((x->key & 0xff) == 0) return 0;  // both ended inside this word
+    size_t d = depth + 8;
+    size_t lx = x->len > d ? x->len - d : 0, ly = y->len > d ? y->len - d : 0;
+    int c = memcmp(base + x->off + d, base + y->off + d, lx < ly ? lx : ly);
+    if (c) return c;
+    return (lx > ly) - (lx < ly);
+}
+
+static void insertion_items(const char *base, sitem_t *a, size_t n, size_t depth) {
+    for (size_t i = 1; i < n; i++) {
+        sitem_t key = a[i];
+        size_t j = i;
+        while (j > 0 && cmp_items(base, &a[j - 1], &key, depth) > 0) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = key;
+    }
+}
+
+static void load_keys(const char *base, sitem_t *a, size_t n, size_t depth) {
+    for (size_t i = 0; i < n; i++) a[i].key = load_key(base, a[i].off, a[i].len, depth);
+}
+
+static uint64_t median3_key(uint64_t x, uint64_t y, uint64_t z) {
+    if (x < y) return y < z ? y : (x < z ? z : x);
+    return x < z ? x : (y < z ? z : y);
+}
+
+// Sort a[0, n) whose keys are loaded for depth
+static void mkqs(const char *base, sitem_t *a, size_t n, size_t depth) {
+    while (n > MKQS_INSERTION) {
+        uint64_t pivot = median3_key(a[0].key, a[n / 2].key, a[n - 1].key);
+
+        // three-way partition: [0, lt) < pivot, [lt, gt) == pivot, [gt, n) >
+        size_t lt = 0, i = 0, gt = n;
+        while (i < gt) {
+            if (a[i].key < pivot) swap_items(&a[lt++], &a[i++]);
+            else if (a[i].key > pivot) swap_items(&a[i], &a[--gt]);
+            else i++;
+        }
+
+        // equal words: done if the strings ended inside them, else go deeper
+        if ((pivot & 0xff) != 0 && gt - lt > 1) {
+            load_keys(base, a + lt, gt - lt, depth + 8);
+            mkqs(base, a + lt, gt - lt, depth + 8);
+        }
+
+        // recurse into the smaller outer part, loop on the larger
+        if (lt < n - gt) {
+            mkqs(base, a, lt, depth);
+            a += gt;
+            n -= gt;
+        } else {
+            mkqs(base, a + gt, n - gt, depth);
+            n = lt;
+        }
+    }
+    insertion_items(base, a, n, depth);
+}
+
+// ---------------------------------------------------------------------------
+// Parallel buckets
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const char *base;
+    sitem_t *items;
+    const size_t *start;    // bucket b is items[start[b], start[b + 1])
+} bucket_job_t;
+
+static void sort_buckets(void *arg, size_t first, size_t last, int tid) {
+    bucket_job_t *job = (bucket_job_t *)arg;
+    (void)tid;
+    for (size_t b = first; b < last; b++) {
+        size_t s = job->start[b], n = job->start[b + 1] - s;
+        // a zero second byte means every string here has at most one byte
+        if (n < 2 || (b & 0xff) == 0) continue;
+        load_keys(job->base, job->items + s, n, 2);
+        mkqs(job->base, job->items + s, n, 2);
+    }
+}
+
+int str_sort(const str_arena_t *a, str_ref_t *refs, size_t n, par_pool_t *pool) {
+    if (n < 2) return 0;
+    sitem_t *items = malloc(n * sizeof(sitem_t));
+    if (!items) return -1;
+
+    if (!pool || par_pool_size(pool) < 2 || n < PARALLEL_MIN) {
+        for (size_t i = 0; i < n; i++) {
+            items[i].off = refs[i].off;
+            items[i].len = refs[i].len;
+        }
+        load_keys(a->data, items, n, 0);
+        mkqs(a->data, items, n, 0);
+    } else {
+        size_t *start = calloc(NBUCKETS + 1, sizeof(size_t));
+        if (!start) {
+            free(items);
+            return -1;
+        }
+        // counting pass on the first two bytes, then scatter
+        for (size_t i = 0; i < n; i++)
+            start[load_key(a->data, refs[i].off, refs[i].len, 0) >> 48]++;
+        size_t sum = 0;
+        for (size_t b = 0; b <= NBUCKETS; b++) {
+            size_t t = start[b];
+            start[b] = sum;
+            sum += t;
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t b = load_key(a->data, refs[i].off, refs[i].len, 0) >> 48;
+            sitem_t *it = &items[start[b]++];
+            it->off = refs[i].off;
+            it->len = refs[i].len;
+        }
+        // the scatter advanced start[b] to the end of bucket b
+        memmove(start + 1, start, NBUCKETS * sizeof(size_t));
+        start[0] = 0;
+
+        bucket_job_t job = { a->data, items, start };
+        par_for(pool, NBUCKETS, 1, sort_buckets, &job);
+        free(start);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        refs[i].off = items[i].off;
+        refs[i].len = items[i].len;
+    }
+    free(items);
+    return 0;
+}
@@ -0,0 +1,59 @@
+/* strsort.h
+   String storage in one arena with an offset+length index, and a string
+   sort (multikey quicksort on cached 8-byte prefixes, parallel over the
+   top-level buckets) that works on that index.
+   Used by hwins.c; compile strsort.c, intio.c, parallel.c and trace.c alongside it.
+*/
+
+#ifndef STRSORT_H
+#define STRSORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parallel.h"
+
+/* Every string lives in data; at least 8 readable bytes always follow len
+   so 8-byte prefixes can be loaded without bounds checks. */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    void *map;          /* data is an mmap of the input file when non-NULL */
+    size_t map_len;
+} str_arena_t;
+
+typedef struct {
+    uint64_t off;       /* start of the string in the arena */
+    uint32_t len;       /* bytes, no terminator */
+} str_ref_t;
+
+int str_arena_init(str_arena_t *a, size_t cap);
+void str_arena_free(str_arena_t *a);
+
+/* Append s[0, len) and return its reference; .len is UINT32_MAX if the
+   arena could not grow. */
+str_ref_t str_arena_add(str_arena_t *a, const char *s, size_t len);
+
+/* Make the whole of path (NULL or "-" = stdin) the arena: a file is
+   mapped, a pipe read into one buffer. Returns 0 or -1 with errno set. */
+int str_arena_load(str_arena_t *a, const char *path);
+
+/* Index up to max whitespace-separated tokens of [*pos, a->len) into refs;
+   returns how many and advances *pos. */
+size_t str_arena_split(const str_arena_t *a, size_t *pos, str_ref_t *refs, size_t max);
+
+static inline const char *str_ptr(const str_arena_t *a, str_ref_t r) {
+    return a->data + r.off;
+}
+
+/* Sort refs by the bytes they reference (strcmp order). Strings are
+   compared eight bytes at a time as big-endian words cached next to each
+   reference, so most steps never touch the arena; ties move on to the next
+   eight bytes. With a pool of more than one thread and enough strings, the
+   refs are first scattered into 65536 buckets by their first two bytes and
+   the buckets are sorted concurrently through par_for(). pool may be NULL.
+   Returns 0, or -1 if scratch memory ran out (refs are then unchanged). */
+int str_sort(const str_arena_t *a, str_ref_t *refs, size_t n, par_pool_t *pool);
+
+#endif
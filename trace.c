@@ -0,0 +1,250 @@
+/* trace.c
+   Per-thread event rings and the Chrome trace writer; see trace.h.
+*/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+
+typedef struct {
+    uint64_t ts;          // raw clock: TSC ticks or nanoseconds
+    const char *name;
+    long long value;
+    char ph;
+} trace_event_t;
+
+// One per thread that has recorded an event. Only its thread writes it, so
+// the head is a plain counter published with a release store; the ring is
+// never freed, and the dump reads whatever the head covers.
+typedef struct trace_ring {
+    struct trace_ring *next;
+    int tid;
+    char name[32];
+    _Atomic uint64_t head;      // events ever recorded
+    trace_event_t ev[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+int trace_on;
+
+static _Atomic(trace_ring_t *) rings;     // every ring, pushed at creation
+static __thread trace_ring_t *my_ring;
+static char trace_path[PATH_MAX];
+static char process_name[64];
+static int use_tsc;
+static uint64_t clock0_raw;     // calibration point: raw clock and CLOCK_MONOTONIC ns
+static uint64_t clock0_ns;
+static int dumped;
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline uint64_t raw_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (use_tsc) return __builtin_ia32_rdtsc();
+#endif
+    return mono_ns();
+}
+
+// rdtsc only counts time when the TSC runs at a fixed rate through
+// frequency changes and sleep states, and agrees across cores
+static int tsc_usable(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f) return 0;
+    char line[4096];
+    int ok = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "flags", 5) != 0) continue;
+        ok = strstr(line, " constant_tsc") && strstr(line, " nonstop_tsc");
+        break;
+    }
+    fclose(f);
+    return ok;
+#else
+    return 0;
+#endif
+}
+
+static trace_ring_t *ring_new(void) {
+    // calloc hands out fresh zero pages, so only the part of the ring that
+    // is written ever becomes resident
+    trace_ring_t *r = calloc(1, sizeof(*r));
+    if (!r) return NULL;
+    r->tid = (int)syscall(SYS_gettid);
+    r->next = atomic_load_explicit(&rings, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&rings, &r->next, r, memory_order_release,
+                                                  memory_order_relaxed))
+        ;
+    my_ring = r;
+    return r;
+}
+
+void trace_event(char ph, const char *name, long long value) {
+    trace_ring_t *r = my_ring;
+    if (!r && !(r = ring_new())) return;
+    uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    trace_event_t *e = &r->ev[h & (TRACE_RING_EVENTS - 1)];
+    e->ts = raw_now();
+    e->name = name;
+    e->value = value;
+    e->ph = ph;
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+void trace_thread_name(const char *fmt, ...) {
+    if (!trace_on) return;
+    trace_ring_t *r = my_ring;
+    if (!r && !(r = ring_new())) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(r->name, sizeof(r->name), fmt, ap);
+    va_end(ap);
+}
+
+int trace_init(const char *name) {
+    const char *path = getenv("TRACE_FILE");
+    if (!path || !*path || trace_on) return trace_on;
+    if (strlen(path) >= sizeof(trace_path)) {
+        fprintf(stderr, "trace: TRACE_FILE path too long\n");
+        return 0;
+    }
+    strcpy(trace_path, path);
+    snprintf(process_name, sizeof(process_name), "%s", name);
+
+    int fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, "[\n", 2) != 2) {
+        perror("trace: TRACE_FILE");
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    close(fd);
+
+    const char *clk = getenv("TRACE_CLOCK");
+    if (clk && strcmp(clk, "mono") == 0) use_tsc = 0;
+    else if (clk && strcmp(clk, "tsc") == 0) use_tsc = 1;
+    else use_tsc = tsc_usable();
+#if !defined(__x86_64__) && !defined(__i386__)
+    use_tsc = 0;
+#endif
+    clock0_ns = mono_ns();
+    clock0_raw = raw_now();
+    trace_on = 1;
+    atexit(trace_dump);
+    return 1;
+}
+
+void trace_fork_child(const char *name) {
+    if (!trace_on) return;
+    // the parent's threads don't exist here and their events are the
+    // parent's to write; keep the rings (another thread may have been
+    // pushing one) but empty them
+    for (trace_ring_t *r = atomic_load(&rings); r; r = r->next) {
+        atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+        r->name[0] = '\0';
+    }
+    if (my_ring) my_ring->tid = (int)syscall(SYS_gettid);
+    snprintf(process_name, sizeof(process_name), "%s", name);
+    dumped = 0;
+}
+
+// Names come from the program's string literals, but quote them properly
+static void put_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", *s);
+        else fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static void put_metadata(FILE *f, const char *what, int pid, int tid, const char *name) {
+    fprintf(f, "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", what, pid, tid);
+    put_json_string(f, name);
+    fputs("}},\n", f);
+}
+
+void trace_dump(void) {
+    if (!trace_on || dumped) return;
+    dumped = 1;
+
+    // Calibrate the TSC over the whole run; a run too short for that gets
+    // padded to 10 ms (only when tracing)
+    double ns_per_tick = 1.0;
+    if (use_tsc) {
+        uint64_t ns1;
+        while ((ns1 = mono_ns()) - clock0_ns < 10000000ull)
+            ;
+        uint64_t raw1 = raw_now();
+        ns_per_tick = (double)(ns1 - clock0_ns) / (double)(raw1 - clock0_raw);
+    }
+
+    // Build the whole chunk in memory and append it with one write, so
+    // forked processes dumping at the same time don't interleave
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *f = open_memstream(&buf, &len);
+    if (!f) {
+        perror("trace: open_memstream");
+        return;
+    }
+    int pid = getpid();
+    put_metadata(f, "process_name", pid, 0, process_name);
+    for (trace_ring_t *r = atomic_load(&rings); r; r = r->next) {
+        uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (head == 0) continue;
+        if (r->name[0]) put_metadata(f, "thread_name", pid, r->tid, r->name);
+        uint64_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        if (first > 0)
+            fprintf(stderr, "trace: thread %d overwrote its %llu oldest events\n", r->tid,
+                    (unsigned long long)first);
+        for (uint64_t i = first; i < head; i++) {
+            const trace_event_t *e = &r->ev[i & (TRACE_RING_EVENTS - 1)];
+            double ns = (double)clock0_ns;
+            if (use_tsc) ns += (double)(int64_t)(e->ts - clock0_raw) * ns_per_tick;
+            else ns += (double)(int64_t)(e->ts - clock0_ns);
+            fputs("{\"name\":", f);
+            put_json_string(f, e->name);
+            fprintf(f, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d", e->ph, ns / 1000.0, pid, r->tid);
+            if (e->ph == 'C') fprintf(f, ",\"args\":{\"value\":%lld}", e->value);
+            else if (e->ph == 'i') fputs(",\"s\":\"t\"", f);
+            fputs("},\n", f);
+        }
+    }
+    if (fclose(f) != 0) {
+        perror("trace: open_memstream");
+        free(buf);
+        return;
+    }
+
+    int fd = open(trace_path, O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        perror("trace: TRACE_FILE");
+        free(buf);
+        return;
+    }
+    for (size_t off = 0; off < len;) {
+        ssize_t w = write(fd, buf + off, len - off);
+        if (w <= 0) {
+            perror("trace: write");
+            break;
+        }
+        off += (size_t)w;
+    }
+    close(fd);
+    free(buf);
+}
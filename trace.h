@@ -0,0 +1,56 @@
+/* trace.h
+   Low-overhead event tracing for the threaded programs. Spans (begin/end),
+   instants and counters are recorded into a ring buffer owned by the
+   calling thread, without locks; at exit every ring is written out in
+   Chrome's trace event format, for chrome://tracing or ui.perfetto.dev.
+   Tracing is off unless TRACE_FILE names the output file:
+       TRACE_FILE=hw4.json ./hw4 -s 2
+   TRACE_CLOCK=tsc|mono picks the timestamp source; the default is rdtsc
+   when the CPU's TSC is invariant, CLOCK_MONOTONIC otherwise. Either way
+   the file holds CLOCK_MONOTONIC microseconds, so processes line up.
+   While tracing is off an event costs one well-predicted branch, and
+   -DNO_TRACE removes the events altogether.
+   Forked processes append to the same file (JSON array form, which the
+   viewers accept without the closing bracket): call trace_fork_child() in
+   the child right after fork(), and trace_dump() before it calls _exit().
+   Compile trace.c alongside the program.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_RING_EVENTS (1 << 16)   /* per thread; older events are overwritten */
+
+extern int trace_on;
+
+/* Start tracing if TRACE_FILE is set: truncate the file and dump at exit.
+   process_name labels this process in the viewer. Returns 1 if tracing. */
+int trace_init(const char *process_name);
+
+/* Label the calling thread (printf-style) */
+void trace_thread_name(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/* In a child right after fork(): drop the events inherited from the parent */
+void trace_fork_child(const char *process_name);
+
+/* Append this process's events to the trace file. Runs at exit by itself;
+   call it before _exit(). Later calls do nothing. */
+void trace_dump(void);
+
+/* Record one event: ph is 'B' (begin), 'E' (end), 'i' (instant) or 'C'
+   (counter, with value). name is stored, not copied: use string literals. */
+void trace_event(char ph, const char *name, long long value);
+
+#ifndef NO_TRACE
+#define TRACE_EVENT_(ph, name, value) \
+    do { if (__builtin_expect(trace_on, 0)) trace_event((ph), (name), (value)); } while (0)
+#else
+#define TRACE_EVENT_(ph, name, value) do { } while (0)
+#endif
+
+#define TRACE_BEGIN(name) TRACE_EVENT_('B', name, 0)
+#define TRACE_END(name) TRACE_EVENT_('E', name, 0)
+#define TRACE_INSTANT(name) TRACE_EVENT_('i', name, 0)
+#define TRACE_COUNTER(name, value) TRACE_EVENT_('C', name, (long long)(value))
+
+#endif